@@ -154,6 +154,9 @@ class Character
         void setModAttribute(unsigned int id, double value)
         { mAttributes[id].modified = value; }
 
+        void removeAttribute(unsigned int id)
+        { mAttributes.erase(id); }
+
         int getSkillSize() const
         { return mExperience.size(); }
 
@@ -172,12 +175,18 @@ class Character
         void receiveExperience(int skill, int value)
         { mExperience[skill] += value; }
 
+        void removeExperience(int skill)
+        { mExperience.erase(skill); }
+
         /**
          * Get / Set a status effects
          */
         void applyStatusEffect(int id, int time)
         { mStatusEffects[id] = time; }
 
+        void clearStatusEffects()
+        { mStatusEffects.clear(); }
+
         int getStatusEffectSize() const
         { return mStatusEffects.size(); }
 
@@ -202,6 +211,9 @@ class Character
         void setKillCount(int monsterId, int kills)
         { mKillCount[monsterId] = kills; }
 
+        void removeKillCount(int monsterId)
+        { mKillCount.erase(monsterId); }
+
         /**
          * Get / Set specials
          */
@@ -266,9 +278,6 @@ class Character
 
     private:
 
-        Character(const Character &);
-        Character &operator=(const Character &);
-
         double getAttrBase(AttributeMap::const_iterator &it) const
         { return it->second.base; }
         double getAttrMod(AttributeMap::const_iterator &it) const
@@ -0,0 +1,330 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "account-server/databaseworker.h"
+
+#include <algorithm>
+#include <deque>
+#include <exception>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "account-server/storage.h"
+#include "common/configuration.h"
+#include "utils/logger.h"
+#include "utils/thread.h"
+#include "utils/timer.h"
+
+using namespace DatabaseWorker;
+
+struct QueuedJob
+{
+    QueuedJob(unsigned key, Job *job):
+        key(key), job(job), submitTime(utils::getMicroseconds())
+    {}
+
+    unsigned key;
+    Job *job;
+    uint64_t submitTime;
+};
+
+/**
+ * Tells whether a queued job has the given key.
+ */
+struct HasKey
+{
+    HasKey(unsigned key): key(key) {}
+
+    bool operator()(const QueuedJob &queued) const
+    { return queued.key == key; }
+
+    unsigned key;
+};
+
+/**
+ * A thread running the jobs of some of the keys, with its own connection.
+ */
+class Connection : public utils::Thread
+{
+    public:
+        Connection():
+            connected(false), ready(false)
+        {}
+
+        Storage storage;
+        std::deque< QueuedJob > queue;
+        utils::Condition workAvailable;
+        bool connected;
+        bool ready;                 /**< Tried to connect. */
+
+    protected:
+        void run();
+};
+
+static std::vector< Connection * > connections;
+static utils::Mutex mutex;          /**< Guards all the state below. */
+static utils::Condition jobDone;
+static utils::Condition connectionReady;
+static std::map< unsigned, unsigned > pendingJobs; /**< Queued by key. */
+static std::vector< Job * > completedJobs;
+static Statistics statistics;
+static bool quit = false;
+
+/**
+ * Runs a job, logging its errors.
+ */
+static void runJob(Job *job, Storage &storage)
+{
+    bool failed = true;
+    try
+    {
+        job->run(storage);
+        failed = false;
+    }
+    catch (const std::string &error)
+    {
+        LOG_ERROR("Database job failed: " << error);
+    }
+    catch (const std::exception &e)
+    {
+        LOG_ERROR("Database job failed: " << e.what());
+    }
+
+    if (failed)
+    {
+        utils::MutexLocker lock(&mutex);
+        ++statistics.failures;
+    }
+}
+
+void Connection::run()
+{
+    try
+    {
+        storage.connect();
+        connected = true;
+    }
+    catch (const std::string &error)
+    {
+        LOG_ERROR("Database worker could not connect: " << error);
+    }
+
+    mutex.lock();
+    ready = true;
+    connectionReady.broadcast();
+
+    while (connected)
+    {
+        while (queue.empty() && !quit)
+            workAvailable.wait(&mutex);
+
+        // Jobs left are run before quitting
+        if (queue.empty())
+            break;
+
+        const QueuedJob queued = queue.front();
+        queue.pop_front();
+
+        const uint64_t startTime = utils::getMicroseconds();
+        statistics.waitTimes.record(startTime - queued.submitTime);
+        mutex.unlock();
+
+        runJob(queued.job, storage);
+
+        const uint64_t runTime = utils::getMicroseconds() - startTime;
+        mutex.lock();
+        statistics.runTimes.record(runTime);
+        ++statistics.jobs;
+        --statistics.queued;
+
+        std::map< unsigned, unsigned >::iterator it =
+                pendingJobs.find(queued.key);
+        if (--it->second == 0)
+            pendingJobs.erase(it);
+
+        completedJobs.push_back(queued.job);
+        jobDone.broadcast();
+    }
+
+    mutex.unlock();
+
+    if (connected)
+        storage.close();
+}
+
+bool DatabaseWorker::initialize()
+{
+    const int threads = Configuration::getValue("db_workerThreads", 0);
+    quit = false;
+
+    for (int i = 0; i < threads; ++i)
+    {
+        Connection *connection = new Connection;
+        connections.push_back(connection);
+        if (!connection->start())
+        {
+            LOG_ERROR("Could not start a database worker thread.");
+            connection->ready = true;
+        }
+    }
+
+    bool connected = true;
+    {
+        utils::MutexLocker lock(&mutex);
+        for (unsigned i = 0; i < connections.size(); ++i)
+        {
+            while (!connections[i]->ready)
+                connectionReady.wait(&mutex);
+            connected = connected && connections[i]->connected;
+        }
+        statistics.threads = connections.size();
+    }
+
+    if (!connected)
+    {
+        deinitialize();
+        return false;
+    }
+
+    if (!connections.empty())
+    {
+        LOG_INFO("Running database jobs on " << connections.size()
+                 << " threads.");
+    }
+    return true;
+}
+
+void DatabaseWorker::deinitialize()
+{
+    {
+        utils::MutexLocker lock(&mutex);
+        quit = true;
+        for (unsigned i = 0; i < connections.size(); ++i)
+            connections[i]->workAvailable.signal();
+    }
+
+    for (unsigned i = 0; i < connections.size(); ++i)
+    {
+        connections[i]->join();
+        delete connections[i];
+    }
+    connections.clear();
+
+    for (unsigned i = 0; i < completedJobs.size(); ++i)
+        delete completedJobs[i];
+    completedJobs.clear();
+    statistics.threads = 0;
+}
+
+void DatabaseWorker::submit(unsigned key, Job *job)
+{
+    if (connections.empty())
+    {
+        const uint64_t startTime = utils::getMicroseconds();
+        runJob(job, *storage);
+        statistics.runTimes.record(utils::getMicroseconds() - startTime);
+        ++statistics.jobs;
+        completedJobs.push_back(job);
+        return;
+    }
+
+    Connection *connection = connections[key % connections.size()];
+
+    utils::MutexLocker lock(&mutex);
+    connection->queue.push_back(QueuedJob(key, job));
+    ++pendingJobs[key];
+    if (++statistics.queued > statistics.maxQueued)
+        statistics.maxQueued = statistics.queued;
+    connection->workAvailable.signal();
+}
+
+void DatabaseWorker::process()
+{
+    std::vector< Job * > jobs;
+    {
+        utils::MutexLocker lock(&mutex);
+        jobs.swap(completedJobs);
+    }
+
+    for (std::vector< Job * >::iterator i = jobs.begin(),
+         i_end = jobs.end(); i != i_end; ++i)
+    {
+        (*i)->complete();
+        delete *i;
+    }
+}
+
+bool DatabaseWorker::wait(unsigned key)
+{
+    if (connections.empty())
+        return false;
+
+    Connection *connection = connections[key % connections.size()];
+
+    utils::MutexLocker lock(&mutex);
+    if (pendingJobs.find(key) == pendingJobs.end())
+        return false;
+
+    // Run the jobs of the key before the unrelated ones, in their order
+    std::stable_partition(connection->queue.begin(), connection->queue.end(),
+                          HasKey(key));
+
+    do
+        jobDone.wait(&mutex);
+    while (pendingJobs.find(key) != pendingJobs.end());
+
+    return true;
+}
+
+Statistics DatabaseWorker::getStatistics()
+{
+    utils::MutexLocker lock(&mutex);
+    return statistics;
+}
+
+void DatabaseWorker::resetStatistics()
+{
+    utils::MutexLocker lock(&mutex);
+    statistics.maxQueued = statistics.queued;
+    statistics.waitTimes.reset();
+    statistics.runTimes.reset();
+}
+
+static void dumpTimes(std::ostream &os, const char *prefix,
+                      const utils::Histogram &times)
+{
+    os << ' ' << prefix << "p50_us=\"" << times.getPercentile(50) << "\" "
+       << prefix << "p99_us=\"" << times.getPercentile(99) << "\" "
+       << prefix << "max_us=\"" << times.getMax() << '"';
+}
+
+void DatabaseWorker::dumpStatistics(std::ostream &os)
+{
+    const Statistics s = getStatistics();
+    os << "<database threads=\"" << s.threads
+       << "\" queued=\"" << s.queued
+       << "\" maxqueued=\"" << s.maxQueued
+       << "\" jobs=\"" << s.jobs
+       << "\" failures=\"" << s.failures << '"';
+    dumpTimes(os, "wait_", s.waitTimes);
+    dumpTimes(os, "run_", s.runTimes);
+    os << " />\n";
+}
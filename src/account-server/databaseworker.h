@@ -0,0 +1,126 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef DATABASEWORKER_H
+#define DATABASEWORKER_H
+
+#include <iosfwd>
+
+#include "utils/histogram.h"
+
+class Storage;
+
+/**
+ * Runs storage operations away from the network loop, on threads that have
+ * their own connection to the database. Each job is given a key, usually
+ * the id of the character it is about, and the jobs of a key are run one
+ * after the other in the order they were submitted.
+ *
+ * Without threads, as configured by default, jobs are run right away on
+ * the storage of the network loop.
+ */
+namespace DatabaseWorker
+{
+    /**
+     * A storage operation. Its completion is called back from the network
+     * loop once it has run.
+     */
+    class Job
+    {
+        public:
+            virtual ~Job() {}
+
+            /**
+             * Performs the operation on the storage of a database thread.
+             * Errors thrown are logged.
+             */
+            virtual void run(Storage &storage) = 0;
+
+            /**
+             * Called from the network loop after the job has run.
+             */
+            virtual void complete() {}
+    };
+
+    struct Statistics
+    {
+        Statistics():
+            threads(0), queued(0), maxQueued(0), jobs(0), failures(0)
+        {}
+
+        unsigned threads;
+        unsigned queued;            /**< Jobs waiting or running. */
+        unsigned maxQueued;         /**< Most jobs queued at once. */
+        uint64_t jobs;              /**< Jobs run. */
+        uint64_t failures;          /**< Jobs that threw an error. */
+        utils::Histogram waitTimes; /**< Microseconds spent in the queue. */
+        utils::Histogram runTimes;  /**< Microseconds spent running. */
+    };
+
+    /**
+     * Connects the threads configured by the db_workerThreads option.
+     *
+     * @return false if a thread could not connect to the database.
+     */
+    bool initialize();
+
+    /**
+     * Runs the jobs left and stops the threads. Completions not called
+     * back yet are dropped.
+     */
+    void deinitialize();
+
+    /**
+     * Queues a job, of which ownership is taken.
+     */
+    void submit(unsigned key, Job *job);
+
+    /**
+     * Calls back the completions of the jobs that have run, and deletes the
+     * jobs. Called by the network loop.
+     */
+    void process();
+
+    /**
+     * Waits until the jobs submitted for a key have run, so that what they
+     * wrote can be read. They are moved ahead of the other jobs queued, so
+     * that only the job running is waited for besides them.
+     *
+     * @return whether there was any job to wait for.
+     */
+    bool wait(unsigned key);
+
+    /**
+     * Gets a copy of the statistics, gathered since the last reset.
+     */
+    Statistics getStatistics();
+
+    /**
+     * Resets the maximum queue length and the times.
+     */
+    void resetStatistics();
+
+    /**
+     * Writes the statistics as an XML element.
+     */
+    void dumpStatistics(std::ostream &);
+}
+
+#endif // DATABASEWORKER_H
@@ -24,6 +24,7 @@
 #endif
 
 #include "account-server/accounthandler.h"
+#include "account-server/databaseworker.h"
 #include "account-server/serverhandler.h"
 #include "account-server/storage.h"
 #include "chat-server/chatchannelmanager.h"
@@ -121,6 +122,13 @@ static void initialize()
         exit(EXIT_DB_EXCEPTION);
     }
 
+    if (!DatabaseWorker::initialize())
+    {
+        LOG_FATAL("Error starting the database worker.");
+        exit(EXIT_DB_EXCEPTION);
+    }
+    storage->setWaitForWorker(true);
+
     // --- Initialize the managers
     stringFilter = new utils::StringFilter;  // The slang's and double quotes filter.
     chatChannelManager = new ChatChannelManager;
@@ -172,10 +180,16 @@ static void deinitializeServer()
     delete postalManager;
     delete gBandwidth;
 
+    // Write what is left to the database
+    DatabaseWorker::deinitialize();
+
     // Get rid of persistent data storage
     delete storage;
 
     PHYSFS_deinit();
+
+    // Write the remaining log messages
+    Logger::deinitialize();
 }
 
 /**
@@ -195,6 +209,8 @@ static void dumpStatistics(std::string accountAddress, int accountClientPort,
     << "\" chatclientport=\"" << chatClientPort << "\" />\n";
     // Add game servers information
     GameServerHandler::dumpStatistics(os);
+    DatabaseWorker::dumpStatistics(os);
+    DatabaseWorker::resetStatistics();
     os << "</statistics>\n";
 }
 
@@ -384,6 +400,7 @@ int main(int argc, char *argv[])
         AccountClientHandler::process();
         GameServerHandler::process();
         chatHandler->process(50);
+        DatabaseWorker::process();
 
         if (statTimer.poll())
             dumpStatistics(accountHost, options.port, accountGamePort,
@@ -21,12 +21,15 @@
 #include <cassert>
 #include <sstream>
 #include <list>
+#include <map>
+#include <vector>
 
 #include "account-server/serverhandler.h"
 
 #include "account-server/accountclient.h"
 #include "account-server/accounthandler.h"
 #include "account-server/character.h"
+#include "account-server/databaseworker.h"
 #include "account-server/flooritem.h"
 #include "account-server/storage.h"
 #include "chat-server/chathandler.h"
@@ -43,30 +46,213 @@
 
 using namespace ManaServ;
 
+/**
+ * Times in microseconds, as measured by a game server.
+ */
+struct TimeStatistics
+{
+  TimeStatistics(): p50(0), p99(0), max(0) {}
+
+  int p50;
+  int p99;
+  int max;
+};
+
 struct MapStatistics
 {
   std::vector<int> players;
   unsigned short nbEntities;
   unsigned short nbMonsters;
+  TimeStatistics updateTimes;
+  TimeStatistics informTimes;
 };
 
 typedef std::map<unsigned short, MapStatistics> ServerStatistics;
+typedef std::vector< std::pair< std::string, TimeStatistics > > PhaseStatistics;
 
 /**
  * Stores address, maps, and statistics, of a connected game server.
  */
 struct GameServer: NetComputer
 {
-    GameServer(ENetPeer *peer): NetComputer(peer), port(0) {}
+    GameServer(ENetPeer *peer):
+        NetComputer(peer), port(0), binaryDoubles(false) {}
 
     std::string address;
     NetComputer *server;
     ServerStatistics maps;
+    PhaseStatistics phases;
     short port;
+    bool binaryDoubles;         /**< Agreed on when registering. */
 };
 
 static GameServer *getGameServerFromMap(int);
 
+/**
+ * Writes the data of a character, or the changes to it, as sent by a game
+ * server. When the write fails, the game server is asked for the whole data
+ * the next time, since it takes what it sent as stored.
+ */
+class UpdateCharacterJob : public DatabaseWorker::Job
+{
+    public:
+        UpdateCharacterJob(const MessageIn &msg, const GameServer *sender)
+            : mData(msg.getData(), msg.getData() + msg.getLength())
+            , mChanges(msg.getId() == GAMSG_PLAYER_CHANGES)
+            , mCharId(0)
+            , mMapId(sender->maps.empty() ? 0 : sender->maps.begin()->first)
+            , mFailed(true)
+        {}
+
+        void run(Storage &storage)
+        {
+            MessageIn msg(&mData[0], mData.size());
+            mCharId = msg.readInt32();
+            if (Character *ptr = storage.getCharacter(mCharId, NULL))
+            {
+                // Keep the stored state so that only changes get written
+                const Character persisted(*ptr);
+                if (mChanges)
+                    deserializeCharacterChanges(*ptr, msg);
+                else
+                    deserializeCharacterData(*ptr, msg);
+                if (storage.updateCharacter(ptr, &persisted))
+                {
+                    mFailed = false;
+                }
+                else
+                {
+                    LOG_ERROR("Failed to update character "
+                              << mCharId << '.');
+                }
+                delete ptr;
+            }
+            else
+            {
+                // There is nothing to write the data to
+                mFailed = false;
+                LOG_ERROR("Received data for non-existing character "
+                          << mCharId << '.');
+            }
+        }
+
+        void complete()
+        {
+            if (!mFailed || !mMapId)
+                return;
+
+            if (GameServer *s = getGameServerFromMap(mMapId))
+            {
+                MessageOut msg(AGMSG_PLAYER_DATA_REQUEST);
+                msg.writeInt32(mCharId);
+                s->send(msg);
+            }
+        }
+
+    private:
+        std::vector< char > mData;  /**< Copy of the message. */
+        bool mChanges;
+        int mCharId;
+        int mMapId;                 /**< A map of the sending game server. */
+        bool mFailed;               /**< Also when an error was thrown. */
+};
+
+/**
+ * Applies the changes to a character synchronized by a game server.
+ */
+class SyncCharacterJob : public DatabaseWorker::Job
+{
+    public:
+        SyncCharacterJob(int charId)
+            : mCharId(charId)
+        {}
+
+        void add(int type, int id, double first, double second)
+        {
+            Record record = { type, id, first, second };
+            mRecords.push_back(record);
+        }
+
+        void run(Storage &storage)
+        {
+            // It is safe to perform the following updates in a transaction
+            dal::PerformTransaction transaction(storage.database());
+
+            for (std::vector< Record >::const_iterator i = mRecords.begin(),
+                 i_end = mRecords.end(); i != i_end; ++i)
+            {
+                switch (i->type)
+                {
+                    case SYNC_CHARACTER_POINTS:
+                        storage.updateCharacterPoints(mCharId,
+                                                      (int) i->first,
+                                                      (int) i->second);
+                        break;
+                    case SYNC_CHARACTER_ATTRIBUTE:
+                        storage.updateAttribute(mCharId, i->id,
+                                                i->first, i->second);
+                        break;
+                    case SYNC_CHARACTER_SKILL:
+                        storage.updateExperience(mCharId, i->id,
+                                                 (int) i->first);
+                        break;
+                    case SYNC_ONLINE_STATUS:
+                        storage.setOnlineStatus(mCharId, i->first != 0);
+                        break;
+                }
+            }
+
+            transaction.commit();
+        }
+
+    private:
+        struct Record
+        {
+            int type;
+            int id;                 /**< Attribute or skill. */
+            double first;
+            double second;
+        };
+
+        int mCharId;
+        std::vector< Record > mRecords;
+};
+
+class SetQuestVarJob : public DatabaseWorker::Job
+{
+    public:
+        SetQuestVarJob(int charId, const std::string &name,
+                       const std::string &value)
+            : mCharId(charId), mName(name), mValue(value)
+        {}
+
+        void run(Storage &storage)
+        { storage.setQuestVar(mCharId, mName, mValue); }
+
+    private:
+        int mCharId;
+        std::string mName;
+        std::string mValue;
+};
+
+/**
+ * Changes the level of a character, after the data written before it.
+ */
+class SetPlayerLevelJob : public DatabaseWorker::Job
+{
+    public:
+        SetPlayerLevelJob(int charId, int level)
+            : mCharId(charId), mLevel(level)
+        {}
+
+        void run(Storage &storage)
+        { storage.setPlayerLevel(mCharId, mLevel); }
+
+    private:
+        int mCharId;
+        int mLevel;
+};
+
 /**
  * Manages communications with all the game servers.
  */
@@ -155,6 +341,7 @@ static void registerGameClient(GameServer *s, const std::string &token,
                                Character *ptr)
 {
     MessageOut msg(AGMSG_PLAYER_ENTER);
+    msg.setBinaryDoubles(s->binaryDoubles);
     msg.writeString(token, MAGIC_TOKEN_LENGTH);
     msg.writeInt32(ptr->getDatabaseID());
     msg.writeString(ptr->getName());
@@ -170,6 +357,13 @@ void GameServerHandler::registerClient(const std::string &token,
     registerGameClient(s, token, ptr);
 }
 
+static void readTimes(MessageIn &msg, TimeStatistics &times)
+{
+    times.p50 = msg.readInt32();
+    times.p99 = msg.readInt32();
+    times.max = msg.readInt32();
+}
+
 void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
 {
     GameServer *server = static_cast<GameServer *>(comp);
@@ -188,6 +382,11 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
             unsigned int dbversion = msg.readInt32();
             LOG_INFO("Game server uses itemsdatabase with version " << dbversion);
 
+            // The features of the link supported by both servers
+            const int features = msg.readInt8() &
+                    (LINK_BINARY_DOUBLES | LINK_CHARACTER_CHANGES);
+            server->binaryDoubles = features & LINK_BINARY_DOUBLES;
+
             LOG_DEBUG("AGMSG_REGISTER_RESPONSE");
             MessageOut outMsg(AGMSG_REGISTER_RESPONSE);
             if (dbversion == storage->getItemDatabaseVersion())
@@ -204,6 +403,7 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
             if (password == Configuration::getValue("net_password", "changeMe"))
             {
                 outMsg.writeInt16(PASSWORD_OK);
+                outMsg.writeInt8(features);
 
                 // transmit global world state variables
                 std::map<std::string, std::string> variables;
@@ -284,24 +484,11 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
         } break;
 
         case GAMSG_PLAYER_DATA:
+        case GAMSG_PLAYER_CHANGES:
         {
             LOG_DEBUG("GAMSG_PLAYER_DATA");
             int id = msg.readInt32();
-            if (Character *ptr = storage->getCharacter(id, NULL))
-            {
-                deserializeCharacterData(*ptr, msg);
-                if (!storage->updateCharacter(ptr))
-                {
-                    LOG_ERROR("Failed to update character "
-                              << id << '.');
-                }
-                delete ptr;
-            }
-            else
-            {
-                LOG_ERROR("Received data for non-existing character "
-                          << id << '.');
-            }
+            DatabaseWorker::submit(id, new UpdateCharacterJob(msg, server));
         } break;
 
         case GAMSG_PLAYER_SYNC:
@@ -378,7 +565,7 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
             int id = msg.readInt32();
             std::string name = msg.readString();
             std::string value = msg.readString();
-            storage->setQuestVar(id, name, value);
+            DatabaseWorker::submit(id, new SetQuestVarJob(id, name, value));
         } break;
 
         case GAMSG_SET_VAR_WORLD:
@@ -418,7 +605,7 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
         {
             int id = msg.readInt32();
             int level = msg.readInt16();
-            storage->setPlayerLevel(id, level);
+            DatabaseWorker::submit(id, new SetPlayerLevelJob(id, level));
         } break;
 
         case GAMSG_CHANGE_ACCOUNT_LEVEL:
@@ -436,6 +623,14 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
 
         case GAMSG_STATISTICS:
         {
+            server->phases.resize(msg.readInt8());
+            for (PhaseStatistics::iterator i = server->phases.begin(),
+                 i_end = server->phases.end(); i != i_end; ++i)
+            {
+                i->first = msg.readString();
+                readTimes(msg, i->second);
+            }
+
             while (msg.getUnreadLength())
             {
                 int mapId = msg.readInt16();
@@ -457,6 +652,8 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
                 {
                     m.players[j] = msg.readInt32();
                 }
+                readTimes(msg, m.updateTimes);
+                readTimes(msg, m.informTimes);
             }
         } break;
 
@@ -622,6 +819,14 @@ void ServerHandler::processMessage(NetComputer *comp, MessageIn &msg)
     }
 }
 
+static void dumpTimes(std::ostream &os, const char *prefix,
+                      const TimeStatistics &times)
+{
+    os << ' ' << prefix << "p50_us=\"" << times.p50 << '"'
+       << ' ' << prefix << "p99_us=\"" << times.p99 << '"'
+       << ' ' << prefix << "max_us=\"" << times.max << '"';
+}
+
 void GameServerHandler::dumpStatistics(std::ostream &os)
 {
     for (ServerHandler::NetComputers::const_iterator
@@ -635,12 +840,23 @@ void GameServerHandler::dumpStatistics(std::ostream &os)
         os << "<gameserver address=\"" << server->address << "\" port=\""
            << server->port << "\">\n";
 
+        for (PhaseStatistics::const_iterator j = server->phases.begin(),
+             j_end = server->phases.end(); j != j_end; ++j)
+        {
+            os << "<phase name=\"" << j->first << '"';
+            dumpTimes(os, "", j->second);
+            os << "/>\n";
+        }
+
         for (ServerStatistics::const_iterator j = server->maps.begin(),
              j_end = server->maps.end(); j != j_end; ++j)
         {
             const MapStatistics &m = j->second;
             os << "<map id=\"" << j->first << "\" nb_entities=\"" << m.nbEntities
-               << "\" nb_monsters=\"" << m.nbMonsters << "\">\n";
+               << "\" nb_monsters=\"" << m.nbMonsters << '"';
+            dumpTimes(os, "update_", m.updateTimes);
+            dumpTimes(os, "inform_", m.informTimes);
+            os << ">\n";
             for (std::vector< int >::const_iterator k = m.players.begin(),
                  k_end = m.players.end(); k != k_end; ++k)
             {
@@ -666,51 +882,57 @@ void GameServerHandler::sendPartyChange(Character *ptr, int partyId)
 
 void GameServerHandler::syncDatabase(MessageIn &msg)
 {
-    // It is safe to perform the following updates in a transaction
-    dal::PerformTransaction transaction(storage->database());
+    // The changes are written by character, in the order they came
+    std::map< int, SyncCharacterJob * > jobs;
 
     while (msg.getUnreadLength() > 0)
     {
         int msgType = msg.readInt8();
+        int charId = msg.readInt32();
+
+        SyncCharacterJob *&job = jobs[charId];
+        if (!job)
+            job = new SyncCharacterJob(charId);
+
         switch (msgType)
         {
             case SYNC_CHARACTER_POINTS:
             {
                 LOG_DEBUG("received SYNC_CHARACTER_POINTS");
-                int charId = msg.readInt32();
                 int charPoints = msg.readInt32();
                 int corrPoints = msg.readInt32();
-                storage->updateCharacterPoints(charId, charPoints, corrPoints);
+                job->add(msgType, 0, charPoints, corrPoints);
             } break;
 
             case SYNC_CHARACTER_ATTRIBUTE:
             {
                 LOG_DEBUG("received SYNC_CHARACTER_ATTRIBUTE");
-                int    charId = msg.readInt32();
                 int    attrId = msg.readInt32();
                 double base   = msg.readDouble();
                 double mod    = msg.readDouble();
-                storage->updateAttribute(charId, attrId, base, mod);
+                job->add(msgType, attrId, base, mod);
             } break;
 
             case SYNC_CHARACTER_SKILL:
             {
                 LOG_DEBUG("received SYNC_CHARACTER_SKILL");
-                int charId = msg.readInt32();
                 int skillId = msg.readInt8();
                 int skillValue = msg.readInt32();
-                storage->updateExperience(charId, skillId, skillValue);
+                job->add(msgType, skillId, skillValue, 0);
             } break;
 
             case SYNC_ONLINE_STATUS:
             {
                 LOG_DEBUG("received SYNC_ONLINE_STATUS");
-                int charId = msg.readInt32();
                 bool online = (msg.readInt8() == 1);
-                storage->setOnlineStatus(charId, online);
+                job->add(msgType, 0, online, 0);
             }
         }
     }
 
-    transaction.commit();
+    for (std::map< int, SyncCharacterJob * >::iterator i = jobs.begin(),
+         i_end = jobs.end(); i != i_end; ++i)
+    {
+        DatabaseWorker::submit(i->first, i->second);
+    }
 }
@@ -18,13 +18,16 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <time.h>
+#include <vector>
 
 #include "account-server/storage.h"
 
 #include "account-server/account.h"
 #include "account-server/character.h"
+#include "account-server/databaseworker.h"
 #include "account-server/flooritem.h"
 #include "chat-server/chatchannel.h"
 #include "chat-server/guild.h"
@@ -96,7 +99,8 @@ static const char *FLOOR_ITEMS_TBL_NAME         =   "mana_floor_items";
 
 Storage::Storage()
         : mDb(dal::DataProviderFactory::createDataProvider()),
-          mItemDbVersion(0)
+          mItemDbVersion(0),
+          mWaitForWorker(false)
 {
 }
 
@@ -158,16 +162,37 @@ void Storage::open()
     }
 }
 
+void Storage::connect()
+{
+    if (mDb->isConnected())
+        return;
+
+    try
+    {
+        mDb->connect();
+    }
+    catch (const dal::DbConnectionFailure& e)
+    {
+        utils::throwError("(DALStorage::connect) "
+                          "Unable to connect to the database: ", e);
+    }
+}
+
+bool Storage::waitForWorker(int charId) const
+{
+    return mWaitForWorker && DatabaseWorker::wait(charId);
+}
+
 void Storage::close()
 {
     mDb->disconnect();
 }
 
-Account *Storage::getAccountBySQL()
+Account *Storage::getAccountBySQL(dal::Statement &statement)
 {
     try
     {
-        const dal::RecordSet &accountInfo = mDb->processSql();
+        const dal::RecordSet &accountInfo = statement.execute();
 
         // If the account is not even in the database then
         // we have no choice but to return nothing.
@@ -205,38 +230,37 @@ Account *Storage::getAccountBySQL()
 
         // Load the characters associated with the account.
         std::ostringstream sql;
-        sql << "select id from " << CHARACTERS_TBL_NAME << " where user_id = '"
-            << id << "';";
-        const dal::RecordSet &charInfo = mDb->execSql(sql.str());
+        sql << "select * from " << CHARACTERS_TBL_NAME
+            << " where user_id = ?";
+        dal::Statement &charStatement = mDb->prepare(sql.str());
+        charStatement.bind(1, (int) id);
+        const dal::RecordSet &charInfo = charStatement.execute();
+
+        // Select them again after the jobs left for them have been run
+        bool waited = false;
+        for (unsigned k = 0; k < charInfo.rows(); ++k)
+            waited = waitForWorker(charInfo.getInt(k, 0)) || waited;
+        if (waited)
+            charStatement.execute();
 
         if (!charInfo.isEmpty())
         {
             int size = charInfo.rows();
             Characters characters;
+            CharactersById charactersById;
 
             LOG_DEBUG("Account "<< id << " has " << size
                       << " character(s) in database.");
 
-            // Two steps: it seems like multiple requests cannot be alive
-            // at the same time.
-            std::vector< unsigned > characterIDs;
-            for (int k = 0; k < size; ++k)
-                characterIDs.push_back(toUint(charInfo(k, 0)));
-
             for (int k = 0; k < size; ++k)
             {
-                if (Character *ptr = getCharacter(characterIDs[k], account))
-                {
-                    characters[ptr->getCharacterSlot()] = ptr;
-                }
-                else
-                {
-                    LOG_ERROR("Failed to get character " << characterIDs[k]
-                              << " for account " << id << '.');
-                }
+                Character *ptr = readCharacter(charInfo, k, account);
+                characters[ptr->getCharacterSlot()] = ptr;
+                charactersById[ptr->getDatabaseID()] = ptr;
             }
 
             account->setCharacters(characters);
+            loadCharacterData(charactersById);
         }
 
         return account;
@@ -321,273 +345,315 @@ void Storage::fixCharactersSlot(int accountId)
 
 Account *Storage::getAccount(const std::string &userName)
 {
-    std::ostringstream sql;
-    sql << "SELECT * FROM " << ACCOUNTS_TBL_NAME << " WHERE username = ?";
-    if (mDb->prepareSql(sql.str()))
+    try
+    {
+        std::ostringstream sql;
+        sql << "SELECT * FROM " << ACCOUNTS_TBL_NAME << " WHERE username = ?";
+        dal::Statement &statement = mDb->prepare(sql.str());
+        statement.bind(1, userName);
+        return getAccountBySQL(statement);
+    }
+    catch (const dal::DbSqlQueryExecFailure &e)
     {
-        mDb->bindValue(1, userName);
-        return getAccountBySQL();
+        utils::throwError("(DALStorage::getAccount #1) SQL query failure: ",
+                          e);
     }
     return 0;
 }
 
 Account *Storage::getAccount(int accountID)
 {
-    std::ostringstream sql;
-    sql << "SELECT * FROM " << ACCOUNTS_TBL_NAME << " WHERE id = ?";
-    if (mDb->prepareSql(sql.str()))
+    try
     {
-        mDb->bindValue(1, accountID);
-        return getAccountBySQL();
+        std::ostringstream sql;
+        sql << "SELECT * FROM " << ACCOUNTS_TBL_NAME << " WHERE id = ?";
+        dal::Statement &statement = mDb->prepare(sql.str());
+        statement.bind(1, accountID);
+        return getAccountBySQL(statement);
+    }
+    catch (const dal::DbSqlQueryExecFailure &e)
+    {
+        utils::throwError("(DALStorage::getAccount #2) SQL query failure: ",
+                          e);
     }
     return 0;
 }
 
-Character *Storage::getCharacterBySQL(Account *owner)
+Character *Storage::getCharacterBySQL(dal::Statement &statement,
+                                      Account *owner)
 {
     Character *character = 0;
 
-    // Specialize the string_to functor to convert
-    // a string to an unsigned int.
-    string_to< unsigned > toUint;
-    string_to< int > toInt;
-
     try
     {
-        const dal::RecordSet &charInfo = mDb->processSql();
+        const dal::RecordSet &charInfo = statement.execute();
 
         // If the character is not even in the database then
         // we have no choice but to return nothing.
         if (charInfo.isEmpty())
             return 0;
 
-        // Specialize the string_to functor to convert
-        // a string to an unsigned short.
-        string_to< unsigned short > toUshort;
-        string_to< double > toDouble;
-
-        character = new Character(charInfo(0, 2), toUint(charInfo(0, 0)));
-        character->setGender(toUshort(charInfo(0, 3)));
-        character->setHairStyle(toUshort(charInfo(0, 4)));
-        character->setHairColor(toUshort(charInfo(0, 5)));
-        character->setLevel(toUshort(charInfo(0, 6)));
-        character->setCharacterPoints(toUshort(charInfo(0, 7)));
-        character->setCorrectionPoints(toUshort(charInfo(0, 8)));
-        Point pos(toInt(charInfo(0, 9)), toInt(charInfo(0, 10)));
-        character->setPosition(pos);
-
-        int mapId = toUint(charInfo(0, 11));
-        if (mapId > 0)
-        {
-            character->setMapId(mapId);
-        }
-        else
+        // Select it again after the jobs left for it have been run. The
+        // records are those of the statement, and are replaced.
+        if (waitForWorker(charInfo.getInt(0, 0)))
         {
-            // Set character to default map and one of the default location
-            // Default map is to be 1, as not found return value will be 0.
-            character->setMapId(Configuration::getValue("char_defaultMap", 1));
+            statement.execute();
+            if (charInfo.isEmpty())
+                return 0;
         }
 
-        character->setCharacterSlot(toUint(charInfo(0, 12)));
+        character = readCharacter(charInfo, 0, owner);
+    }
+    catch (const dal::DbSqlQueryExecFailure &e)
+    {
+        utils::throwError("DALStorage::getCharacter #1) SQL query failure: ",
+                          e);
+    }
 
-        // Fill the account-related fields. Last step, as it may require a new
-        // SQL query.
-        if (owner)
-        {
-            character->setAccount(owner);
-        }
-        else
-        {
-            int id = toUint(charInfo(0, 1));
-            character->setAccountID(id);
-            std::ostringstream s;
-            s << "select level from " << ACCOUNTS_TBL_NAME
-              << " where id = '" << id << "';";
-            const dal::RecordSet &levelInfo = mDb->execSql(s.str());
-            character->setAccountLevel(toUint(levelInfo(0, 0)), true);
-        }
+    CharactersById characters;
+    characters[character->getDatabaseID()] = character;
+    loadCharacterData(characters);
+
+    return character;
+}
+
+Character *Storage::readCharacter(const dal::RecordSet &charInfo,
+                                  unsigned row, Account *owner)
+{
+    Character *character = new Character(charInfo(row, 2),
+                                         charInfo.getInt(row, 0));
+    character->setGender(charInfo.getInt(row, 3));
+    character->setHairStyle(charInfo.getInt(row, 4));
+    character->setHairColor(charInfo.getInt(row, 5));
+    character->setLevel(charInfo.getInt(row, 6));
+    character->setCharacterPoints(charInfo.getInt(row, 7));
+    character->setCorrectionPoints(charInfo.getInt(row, 8));
+    Point pos(charInfo.getInt(row, 9), charInfo.getInt(row, 10));
+    character->setPosition(pos);
 
+    int mapId = charInfo.getInt(row, 11);
+    if (mapId > 0)
+    {
+        character->setMapId(mapId);
+    }
+    else
+    {
+        // Set character to default map and one of the default location
+        // Default map is to be 1, as not found return value will be 0.
+        character->setMapId(Configuration::getValue("char_defaultMap", 1));
+    }
+
+    character->setCharacterSlot(charInfo.getInt(row, 12));
+
+    // Fill the account-related fields. Last step, as it may require a new
+    // SQL query.
+    if (owner)
+    {
+        character->setAccount(owner);
+    }
+    else
+    {
+        int id = charInfo.getInt(row, 1);
+        character->setAccountID(id);
         std::ostringstream s;
+        s << "select level from " << ACCOUNTS_TBL_NAME
+          << " where id = ?";
+        dal::Statement &levelStatement = mDb->prepare(s.str());
+        levelStatement.bind(1, id);
+        const dal::RecordSet &levelInfo = levelStatement.execute();
+        character->setAccountLevel(levelInfo.getInt(0, 0), true);
+    }
 
-        // Load attributes.
-        s << "SELECT attr_id, attr_base, attr_mod "
-          << "FROM " << CHAR_ATTR_TBL_NAME << " "
-          << "WHERE char_id = " << character->getDatabaseID();
+    return character;
+}
+
+/**
+ * Prepares a statement selecting the rows of a table owned by some
+ * characters, with their ids bound. The id of the owner is the first column
+ * selected. Since there is one placeholder for each character, the few
+ * statements needed stay cached.
+ */
+static dal::Statement &prepareForCharacters(
+        dal::DataProvider *db,
+        const std::map< int, Character * > &characters,
+        const char *columns, const char *table, const char *ownerColumn,
+        const char *order = 0)
+{
+    std::ostringstream sql;
+    sql << "SELECT " << ownerColumn << ", " << columns
+        << " FROM " << table << " WHERE " << ownerColumn << " IN (";
+    for (unsigned i = 0; i < characters.size(); ++i)
+        sql << (i ? ", ?" : "?");
+    sql << ")";
+    if (order)
+        sql << " ORDER BY " << order;
+
+    dal::Statement &statement = db->prepare(sql.str());
+    int place = 1;
+    for (std::map< int, Character * >::const_iterator it = characters.begin(),
+         it_end = characters.end(); it != it_end; ++it)
+    {
+        statement.bind(place++, it->first);
+    }
+    return statement;
+}
 
-        const dal::RecordSet &attrInfo = mDb->execSql(s.str());
-        if (!attrInfo.isEmpty())
+void Storage::loadCharacterData(const CharactersById &characters)
+{
+    try
+    {
+        // Load attributes.
+        dal::Statement &attrStatement =
+                prepareForCharacters(mDb, characters,
+                                     "attr_id, attr_base, attr_mod",
+                                     CHAR_ATTR_TBL_NAME, "char_id");
+        attrStatement.query();
+        while (attrStatement.next())
         {
-            const unsigned int nRows = attrInfo.rows();
-            for (unsigned int row = 0; row < nRows; ++row)
-            {
-                unsigned int id = toUint(attrInfo(row, 0));
-                character->setAttribute(id,    toDouble(attrInfo(row, 1)));
-                character->setModAttribute(id, toDouble(attrInfo(row, 2)));
-            }
+            Character *character =
+                    characters.find(attrStatement.getInt(0))->second;
+            unsigned int id = attrStatement.getInt(1);
+            character->setAttribute(id,    attrStatement.getDouble(2));
+            character->setModAttribute(id, attrStatement.getDouble(3));
         }
 
-        s.clear();
-        s.str("");
-
         // Load skills.
-        s << "SELECT skill_id, skill_exp "
-          << "FROM " << CHAR_SKILLS_TBL_NAME
-          << " WHERE char_id = " << character->getDatabaseID();
-
-        const dal::RecordSet &skillInfo = mDb->execSql(s.str());
-        if (!skillInfo.isEmpty())
+        dal::Statement &skillStatement =
+                prepareForCharacters(mDb, characters, "skill_id, skill_exp",
+                                     CHAR_SKILLS_TBL_NAME, "char_id");
+        skillStatement.query();
+        while (skillStatement.next())
         {
-            const unsigned int nRows = skillInfo.rows();
-            for (unsigned int row = 0; row < nRows; ++row)
-            {
-                unsigned int id = toUint(skillInfo(row, 0));
-                character->setExperience(id, toInt(skillInfo(row, 1)));
-            }
+            Character *character =
+                    characters.find(skillStatement.getInt(0))->second;
+            character->setExperience(skillStatement.getInt(1),
+                                     skillStatement.getInt(2));
         }
 
-        s.clear();
-        s.str("");
-
         // Load the status effects
-        s << "select status_id, status_time FROM "
-          << CHAR_STATUS_EFFECTS_TBL_NAME
-          << " WHERE char_id = " << character->getDatabaseID();
-        const dal::RecordSet &statusInfo = mDb->execSql(s.str());
-        if (!statusInfo.isEmpty())
+        dal::Statement &statusStatement =
+                prepareForCharacters(mDb, characters,
+                                     "status_id, status_time",
+                                     CHAR_STATUS_EFFECTS_TBL_NAME, "char_id");
+        statusStatement.query();
+        while (statusStatement.next())
         {
-            const unsigned int nRows = statusInfo.rows();
-            for (unsigned int row = 0; row < nRows; row++)
-            {
-                character->applyStatusEffect(
-                    toUint(statusInfo(row, 0)), // Status Id
-                    toUint(statusInfo(row, 1))); // Time
-            }
+            Character *character =
+                    characters.find(statusStatement.getInt(0))->second;
+            character->applyStatusEffect(
+                statusStatement.getInt(1),  // Status Id
+                statusStatement.getInt(2)); // Time
         }
 
         // Load the kill stats
-        s.clear();
-        s.str("");
-        s << "select monster_id, kills FROM " << CHAR_KILL_COUNT_TBL_NAME
-          << " WHERE char_id = " << character->getDatabaseID();
-        const dal::RecordSet &killsInfo = mDb->execSql(s.str());
-        if (!killsInfo.isEmpty())
+        dal::Statement &killsStatement =
+                prepareForCharacters(mDb, characters, "monster_id, kills",
+                                     CHAR_KILL_COUNT_TBL_NAME, "char_id");
+        killsStatement.query();
+        while (killsStatement.next())
         {
-            const unsigned int nRows = killsInfo.rows();
-            for (unsigned int row = 0; row < nRows; row++)
-            {
-                character->setKillCount(
-                    toUint(killsInfo(row, 0)), // MonsterID
-                    toUint(killsInfo(row, 1))); // Kills
-            }
+            Character *character =
+                    characters.find(killsStatement.getInt(0))->second;
+            character->setKillCount(
+                killsStatement.getInt(1),   // MonsterID
+                killsStatement.getInt(2));  // Kills
         }
 
         // Load the special status
-        s.clear();
-        s.str("");
-        s << "SELECT special_id, special_current_mana FROM "
-          << CHAR_SPECIALS_TBL_NAME
-          << " WHERE char_id = " << character->getDatabaseID();
-        const dal::RecordSet &specialsInfo = mDb->execSql(s.str());
-        if (!specialsInfo.isEmpty())
+        dal::Statement &specialsStatement =
+                prepareForCharacters(mDb, characters,
+                                     "special_id, special_current_mana",
+                                     CHAR_SPECIALS_TBL_NAME, "char_id");
+        specialsStatement.query();
+        while (specialsStatement.next())
+        {
+            Character *character =
+                    characters.find(specialsStatement.getInt(0))->second;
+            character->giveSpecial(specialsStatement.getInt(1),
+                                   specialsStatement.getInt(2));
+        }
+
+        // Load the equipment and the inventories
+        std::map< int, EquipData > equipData;
+        std::map< int, InventoryData > inventoryData;
+
+        dal::Statement &equipStatement =
+                prepareForCharacters(mDb, characters,
+                                     "slot_type, item_id, item_instance",
+                                     CHAR_EQUIPS_TBL_NAME, "owner_id",
+                                     "slot_type desc");
+        equipStatement.query();
+        EquipmentItem equipItem;
+        while (equipStatement.next())
+        {
+            equipItem.itemId = equipStatement.getInt(2);
+            equipItem.itemInstance = equipStatement.getInt(3);
+            equipData[equipStatement.getInt(0)].insert(
+                    std::pair<unsigned int, EquipmentItem>(
+                        equipStatement.getInt(1), equipItem));
+        }
+
+        dal::Statement &itemStatement =
+                prepareForCharacters(mDb, characters, "slot, class_id, amount",
+                                     INVENTORIES_TBL_NAME, "owner_id");
+        itemStatement.query();
+        while (itemStatement.next())
+        {
+            InventoryItem item;
+            unsigned short slot = itemStatement.getInt(1);
+            item.itemId   = itemStatement.getInt(2);
+            item.amount   = itemStatement.getInt(3);
+            inventoryData[itemStatement.getInt(0)][slot] = item;
+        }
+
+        for (CharactersById::const_iterator it = characters.begin(),
+             it_end = characters.end(); it != it_end; ++it)
         {
-            const unsigned int nRows = specialsInfo.rows();
-            for (unsigned int row = 0; row < nRows; row++)
-            {
-                character->giveSpecial(toUint(specialsInfo(row, 0)),
-                                       toUint(specialsInfo(row, 1)));
-            }
+            Possessions &poss = it->second->getPossessions();
+            poss.setEquipment(equipData[it->first]);
+            poss.setInventory(inventoryData[it->first]);
         }
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
-        utils::throwError("DALStorage::getCharacter #1) SQL query failure: ",
-                          e);
+        utils::throwError("(DALStorage::loadCharacterData) "
+                          "SQL query failure: ", e);
     }
+}
 
-    Possessions &poss = character->getPossessions();
-
+Character *Storage::getCharacter(int id, Account *owner)
+{
     try
     {
         std::ostringstream sql;
-        sql << " select slot_type, item_id, item_instance from "
-            << CHAR_EQUIPS_TBL_NAME
-            << " where owner_id = '"
-            << character->getDatabaseID() << "' order by slot_type desc;";
-
-        EquipData equipData;
-        const dal::RecordSet &equipInfo = mDb->execSql(sql.str());
-        if (!equipInfo.isEmpty())
-        {
-            EquipmentItem equipItem;
-            for (int k = 0, size = equipInfo.rows(); k < size; ++k)
-            {
-                equipItem.itemId = toUint(equipInfo(k, 1));
-                equipItem.itemInstance = toUint(equipInfo(k, 2));
-                equipData.insert(std::pair<unsigned int, EquipmentItem>(
-                                     toUint(equipInfo(k, 0)),
-                                     equipItem));
-            }
-        }
-        poss.setEquipment(equipData);
+        sql << "SELECT * FROM " << CHARACTERS_TBL_NAME << " WHERE id = ?";
+        dal::Statement &statement = mDb->prepare(sql.str());
+        statement.bind(1, id);
+        return getCharacterBySQL(statement, owner);
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
-        utils::throwError("DALStorage::getCharacter #2) SQL query failure: ",
+        utils::throwError("(DALStorage::getCharacter #4) SQL query failure: ",
                           e);
     }
+    return 0;
+}
 
+Character *Storage::getCharacter(const std::string &name)
+{
     try
     {
         std::ostringstream sql;
-        sql << " select * from " << INVENTORIES_TBL_NAME
-            << " where owner_id = '"
-            << character->getDatabaseID() << "' order by slot asc;";
-
-        InventoryData inventoryData;
-        const dal::RecordSet &itemInfo = mDb->execSql(sql.str());
-        if (!itemInfo.isEmpty())
-        {
-            for (int k = 0, size = itemInfo.rows(); k < size; ++k)
-            {
-                InventoryItem item;
-                unsigned short slot = toUint(itemInfo(k, 2));
-                item.itemId   = toUint(itemInfo(k, 3));
-                item.amount   = toUint(itemInfo(k, 4));
-                inventoryData[slot] = item;
-            }
-        }
-        poss.setInventory(inventoryData);
+        sql << "SELECT * FROM " << CHARACTERS_TBL_NAME << " WHERE name = ?";
+        dal::Statement &statement = mDb->prepare(sql.str());
+        statement.bind(1, name);
+        return getCharacterBySQL(statement, 0);
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
-        utils::throwError("DALStorage::getCharacter #3) SQL query failure: ",
+        utils::throwError("(DALStorage::getCharacter #5) SQL query failure: ",
                           e);
     }
-
-    return character;
-}
-
-Character *Storage::getCharacter(int id, Account *owner)
-{
-    std::ostringstream sql;
-    sql << "SELECT * FROM " << CHARACTERS_TBL_NAME << " WHERE id = ?";
-    if (mDb->prepareSql(sql.str()))
-    {
-        mDb->bindValue(1, id);
-        return getCharacterBySQL(owner);
-    }
-    return 0;
-}
-
-Character *Storage::getCharacter(const std::string &name)
-{
-    std::ostringstream sql;
-    sql << "SELECT * FROM " << CHARACTERS_TBL_NAME << " WHERE name = ?";
-    if (mDb->prepareSql(sql.str()))
-    {
-        mDb->bindValue(1, name);
-        return getCharacterBySQL(0);
-    }
     return 0;
 }
 
@@ -716,30 +782,195 @@ bool Storage::doesCharacterNameExist(const std::string& name)
     return true;
 }
 
-bool Storage::updateCharacter(Character *character)
+/** Most rows written by a single insert statement. */
+static const size_t MAX_ROWS_PER_INSERT = 100;
+
+static bool sameValue(int a, int b)
+{ return a == b; }
+
+static bool sameValue(const AttributeValue &a, const AttributeValue &b)
+{ return a.base == b.base && a.modified == b.modified; }
+
+static bool sameValue(const SpecialValue &a, const SpecialValue &b)
+{ return a.currentMana == b.currentMana; }
+
+static bool sameValue(const InventoryItem &a, const InventoryItem &b)
+{ return a.itemId == b.itemId && a.amount == b.amount; }
+
+static bool sameValue(const EquipmentItem &a, const EquipmentItem &b)
+{ return a.itemId == b.itemId && a.itemInstance == b.itemInstance; }
+
+static void writeValue(std::ostream &sql, int value)
+{ sql << value; }
+
+static void writeValue(std::ostream &sql, const AttributeValue &value)
+{ sql << value.base << ", " << value.modified; }
+
+static void writeValue(std::ostream &sql, const SpecialValue &value)
+{ sql << value.currentMana; }
+
+static void writeValue(std::ostream &sql, const InventoryItem &value)
+{ sql << value.itemId << ", " << value.amount; }
+
+static void writeValue(std::ostream &sql, const EquipmentItem &value)
+{ sql << value.itemId << ", " << value.itemInstance; }
+
+/**
+ * Inserts rows of a character table, as few statements as possible.
+ */
+template< class Iterator >
+static void insertRows(dal::DataProvider *db, const char *table,
+                       const char *columns, int ownerId,
+                       const std::vector< Iterator > &rows)
+{
+    std::ostringstream sql;
+    for (size_t first = 0; first < rows.size();
+         first += MAX_ROWS_PER_INSERT)
+    {
+        const size_t last = std::min(first + MAX_ROWS_PER_INSERT,
+                                     rows.size());
+        sql.str("");
+        sql << "INSERT INTO " << table << " (" << columns << ") VALUES ";
+        for (size_t i = first; i < last; ++i)
+        {
+            if (i > first)
+                sql << ", ";
+            sql << "(" << ownerId << ", " << rows[i]->first << ", ";
+            writeValue(sql, rows[i]->second);
+            sql << ")";
+        }
+        db->execSql(sql.str());
+    }
+}
+
+/**
+ * Writes the rows of a character table that differ from the persisted ones.
+ * The rows that are gone or changed are deleted in one statement, then the
+ * changed and new ones are inserted together. Without persisted rows, all the
+ * rows of the character are replaced.
+ *
+ * @param columns The owner, key and value columns, in this order.
+ */
+template< class Map >
+static void updateRows(dal::DataProvider *db, const char *table,
+                       const char *columns, const char *ownerColumn,
+                       const char *keyColumn, int ownerId,
+                       const Map &rows, const Map *persisted)
+{
+    typedef typename Map::const_iterator Iterator;
+    std::vector< typename Map::key_type > staleKeys;
+    std::vector< Iterator > newRows;
+
+    for (Iterator it = rows.begin(), it_end = rows.end(); it != it_end; ++it)
+    {
+        if (persisted)
+        {
+            Iterator old = persisted->find(it->first);
+            if (old != persisted->end() && sameValue(old->second, it->second))
+                continue;
+            if (old != persisted->end())
+                staleKeys.push_back(it->first);
+        }
+        newRows.push_back(it);
+    }
+
+    std::ostringstream sql;
+    sql << "DELETE FROM " << table << " WHERE " << ownerColumn << " = "
+        << ownerId;
+
+    if (persisted)
+    {
+        for (Iterator it = persisted->begin(), it_end = persisted->end();
+             it != it_end; ++it)
+        {
+            if (rows.find(it->first) == rows.end())
+                staleKeys.push_back(it->first);
+        }
+
+        if (staleKeys.empty())
+        {
+            insertRows(db, table, columns, ownerId, newRows);
+            return;
+        }
+
+        sql << " AND " << keyColumn << " IN (";
+        for (size_t i = 0; i < staleKeys.size(); ++i)
+        {
+            if (i > 0)
+                sql << ", ";
+            sql << staleKeys[i];
+        }
+        sql << ")";
+    }
+
+    db->execSql(sql.str());
+    insertRows(db, table, columns, ownerId, newRows);
+}
+
+/**
+ * Tells whether the row of the characters table would be unchanged.
+ */
+static bool sameCharacterRow(const Character &a, const Character &b)
+{
+    return a.getGender() == b.getGender()
+        && a.getHairStyle() == b.getHairStyle()
+        && a.getHairColor() == b.getHairColor()
+        && a.getLevel() == b.getLevel()
+        && a.getCharacterPoints() == b.getCharacterPoints()
+        && a.getCorrectionPoints() == b.getCorrectionPoints()
+        && a.getPosition() == b.getPosition()
+        && a.getMapId() == b.getMapId()
+        && a.getCharacterSlot() == b.getCharacterSlot();
+}
+
+/**
+ * Tells whether two characters have the same equipment, slot by slot.
+ */
+static bool sameEquipment(const EquipData &a, const EquipData &b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (EquipData::const_iterator i = a.begin(), j = b.begin(),
+         i_end = a.end(); i != i_end; ++i, ++j)
+    {
+        if (i->first != j->first || !sameValue(i->second, j->second))
+            return false;
+    }
+    return true;
+}
+
+bool Storage::updateCharacter(Character *character,
+                              const Character *persisted)
 {
     dal::PerformTransaction transaction(mDb);
+    const int id = character->getDatabaseID();
 
     try
     {
         // Update the database Character data (see CharacterData for details)
-        std::ostringstream sqlUpdateCharacterInfo;
-        sqlUpdateCharacterInfo
-            << "update "        << CHARACTERS_TBL_NAME << " "
-            << "set "
-            << "gender = '"     << character->getGender() << "', "
-            << "hair_style = '" << character->getHairStyle() << "', "
-            << "hair_color = '" << character->getHairColor() << "', "
-            << "level = '"      << character->getLevel() << "', "
-            << "char_pts = '"   << character->getCharacterPoints() << "', "
-            << "correct_pts = '"<< character->getCorrectionPoints() << "', "
-            << "x = '"          << character->getPosition().x << "', "
-            << "y = '"          << character->getPosition().y << "', "
-            << "map_id = '"     << character->getMapId() << "', "
-            << "slot = '"     << character->getCharacterSlot() << "' "
-            << "where id = '"   << character->getDatabaseID() << "';";
-
-        mDb->execSql(sqlUpdateCharacterInfo.str());
+        if (!persisted || !sameCharacterRow(*character, *persisted))
+        {
+            std::ostringstream sql;
+            sql << "update " << CHARACTERS_TBL_NAME << " set "
+                << "gender = ?, hair_style = ?, hair_color = ?, level = ?, "
+                << "char_pts = ?, correct_pts = ?, x = ?, y = ?, map_id = ?, "
+                << "slot = ? where id = ?";
+
+            dal::Statement &statement = mDb->prepare(sql.str());
+            statement.bind(1, character->getGender());
+            statement.bind(2, character->getHairStyle());
+            statement.bind(3, character->getHairColor());
+            statement.bind(4, character->getLevel());
+            statement.bind(5, character->getCharacterPoints());
+            statement.bind(6, character->getCorrectionPoints());
+            statement.bind(7, character->getPosition().x);
+            statement.bind(8, character->getPosition().y);
+            statement.bind(9, character->getMapId());
+            statement.bind(10, (int) character->getCharacterSlot());
+            statement.bind(11, id);
+            statement.execute();
+        }
     }
     catch (const dal::DbSqlQueryExecFailure& e)
     {
@@ -750,10 +981,10 @@ bool Storage::updateCharacter(Character *character)
     // Character attributes.
     try
     {
-        for (AttributeMap::const_iterator it = character->mAttributes.begin(),
-             it_end = character->mAttributes.end(); it != it_end; ++it)
-            updateAttribute(character->getDatabaseID(), it->first,
-                            it->second.base, it->second.modified);
+        updateRows(mDb, CHAR_ATTR_TBL_NAME,
+                   "char_id, attr_id, attr_base, attr_mod",
+                   "char_id", "attr_id", id, character->mAttributes,
+                   persisted ? &persisted->mAttributes : 0);
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
@@ -764,13 +995,10 @@ bool Storage::updateCharacter(Character *character)
     // Character's skills
     try
     {
-        std::map<int, int>::const_iterator skill_it;
-        for (skill_it = character->mExperience.begin();
-             skill_it != character->mExperience.end(); skill_it++)
-        {
-            updateExperience(character->getDatabaseID(),
-                             skill_it->first, skill_it->second);
-        }
+        updateRows(mDb, CHAR_SKILLS_TBL_NAME,
+                   "char_id, skill_id, skill_exp",
+                   "char_id", "skill_id", id, character->mExperience,
+                   persisted ? &persisted->mExperience : 0);
     }
     catch (const dal::DbSqlQueryExecFailure& e)
     {
@@ -781,13 +1009,10 @@ bool Storage::updateCharacter(Character *character)
     // Character's kill count
     try
     {
-        std::map<int, int>::const_iterator kill_it;
-        for (kill_it = character->getKillCountBegin();
-             kill_it != character->getKillCountEnd(); kill_it++)
-        {
-            updateKillCount(character->getDatabaseID(),
-                            kill_it->first, kill_it->second);
-        }
+        updateRows(mDb, CHAR_KILL_COUNT_TBL_NAME,
+                   "char_id, monster_id, kills",
+                   "char_id", "monster_id", id, character->mKillCount,
+                   persisted ? &persisted->mKillCount : 0);
     }
     catch (const dal::DbSqlQueryExecFailure& e)
     {
@@ -798,51 +1023,40 @@ bool Storage::updateCharacter(Character *character)
     //  Character's special actions
     try
     {
-        // Out with the old
-        std::ostringstream deleteSql("");
-        std::ostringstream insertSql;
-        deleteSql   << "DELETE FROM " << CHAR_SPECIALS_TBL_NAME
-                    << " WHERE char_id='"
-                    << character->getDatabaseID() << "';";
-        mDb->execSql(deleteSql.str());
-        // In with the new
-        SpecialMap::const_iterator special_it, special_it_end;
-        for (special_it = character->getSpecialBegin(),
-             special_it_end = character->getSpecialEnd();
-             special_it != special_it_end; ++special_it)
-        {
-            insertSql.str("");
-            insertSql   << "INSERT INTO " << CHAR_SPECIALS_TBL_NAME
-                        << " (char_id, special_id, special_current_mana)"
-                        << " VALUES ("
-                        << " '" << character->getDatabaseID() << "',"
-                        << " '" << special_it->first << "',"
-                        << " '" << special_it->second.currentMana
-                        << "');";
-            mDb->execSql(insertSql.str());
-        }
+        updateRows(mDb, CHAR_SPECIALS_TBL_NAME,
+                   "char_id, special_id, special_current_mana",
+                   "char_id", "special_id", id, character->mSpecials,
+                   persisted ? &persisted->mSpecials : 0);
     }
     catch (const dal::DbSqlQueryExecFailure& e)
     {
         utils::throwError("(DALStorage::updateCharacter #5) "
-                          "SQL query failure: ", e);;
+                          "SQL query failure: ", e);
     }
 
-    // Character's inventory
-    // Delete the old inventory and equipment table first
+    // Character's equipment, replaced as a whole since slots may hold
+    // several rows
     try
     {
-        std::ostringstream sqlDeleteCharacterEquipment;
-        sqlDeleteCharacterEquipment
-            << "delete from " << CHAR_EQUIPS_TBL_NAME
-            << " where owner_id = '" << character->getDatabaseID() << "';";
-        mDb->execSql(sqlDeleteCharacterEquipment.str());
+        const EquipData &equipData = character->getPossessions().getEquipment();
+        if (!persisted ||
+            !sameEquipment(equipData,
+                           persisted->getPossessions().getEquipment()))
+        {
+            std::ostringstream sql;
+            sql << "delete from " << CHAR_EQUIPS_TBL_NAME
+                << " where owner_id = " << id << ";";
+            mDb->execSql(sql.str());
 
-        std::ostringstream sqlDeleteCharacterInventory;
-        sqlDeleteCharacterInventory
-            << "delete from " << INVENTORIES_TBL_NAME
-            << " where owner_id = '" << character->getDatabaseID() << "';";
-        mDb->execSql(sqlDeleteCharacterInventory.str());
+            std::vector< EquipData::const_iterator > rows;
+            for (EquipData::const_iterator it = equipData.begin(),
+                 it_end = equipData.end(); it != it_end; ++it)
+                rows.push_back(it);
+
+            insertRows(mDb, CHAR_EQUIPS_TBL_NAME,
+                       "owner_id, slot_type, item_id, item_instance",
+                       id, rows);
+        }
     }
     catch (const dal::DbSqlQueryExecFailure& e)
     {
@@ -850,47 +1064,16 @@ bool Storage::updateCharacter(Character *character)
                           "SQL query failure: ", e);
     }
 
-    // Insert the new inventory data
+    // Character's inventory
     try
     {
-        std::ostringstream sql;
-
-        sql << "insert into " << CHAR_EQUIPS_TBL_NAME
-            << " (owner_id, slot_type, item_id, item_instance) values ("
-            << character->getDatabaseID() << ", ";
-        std::string base = sql.str();
-
-        const Possessions &poss = character->getPossessions();
-        const EquipData &equipData = poss.getEquipment();
-        for (EquipData::const_iterator it = equipData.begin(),
-             it_end = equipData.end(); it != it_end; ++it)
-        {
-                sql.str("");
-                sql << base << it->first << ", " << it->second.itemId
-                    << ", " << it->second.itemInstance << ");";
-                mDb->execSql(sql.str());
-        }
-
-        sql.str("");
-
-        sql << "insert into " << INVENTORIES_TBL_NAME
-            << " (owner_id, slot, class_id, amount) values ("
-            << character->getDatabaseID() << ", ";
-        base = sql.str();
-
-        const InventoryData &inventoryData = poss.getInventory();
-        for (InventoryData::const_iterator j = inventoryData.begin(),
-             j_end = inventoryData.end(); j != j_end; ++j)
-        {
-            sql.str("");
-            unsigned short slot = j->first;
-            unsigned int itemId = j->second.itemId;
-            unsigned int amount = j->second.amount;
-            assert(itemId);
-            sql << base << slot << ", " << itemId << ", " << amount << ");";
-            mDb->execSql(sql.str());
-        }
-
+        const InventoryData &inventoryData =
+                character->getPossessions().getInventory();
+        updateRows(mDb, INVENTORIES_TBL_NAME,
+                   "owner_id, slot, class_id, amount",
+                   "owner_id", "slot", id, inventoryData,
+                   persisted ? &persisted->getPossessions().getInventory()
+                             : 0);
     }
     catch (const dal::DbSqlQueryExecFailure& e)
     {
@@ -898,38 +1081,19 @@ bool Storage::updateCharacter(Character *character)
                           "SQL query failure: ", e);
     }
 
-
     // Update char status effects
     try
     {
-        // Delete the old status effects first
-        std::ostringstream sql;
-
-        sql << "delete from " << CHAR_STATUS_EFFECTS_TBL_NAME
-            << " where char_id = '" << character->getDatabaseID() << "';";
-
-         mDb->execSql(sql.str());
+        updateRows(mDb, CHAR_STATUS_EFFECTS_TBL_NAME,
+                   "char_id, status_id, status_time",
+                   "char_id", "status_id", id, character->mStatusEffects,
+                   persisted ? &persisted->mStatusEffects : 0);
     }
     catch (const dal::DbSqlQueryExecFailure& e)
     {
         utils::throwError("(DALStorage::updateCharacter #8) "
                           "SQL query failure: ", e);
     }
-    try
-    {
-        std::map<int, int>::const_iterator status_it;
-        for (status_it = character->getStatusEffectBegin();
-             status_it != character->getStatusEffectEnd(); status_it++)
-        {
-            insertStatusEffect(character->getDatabaseID(),
-                               status_it->first, status_it->second);
-        }
-    }
-    catch (const dal::DbSqlQueryExecFailure& e)
-    {
-        utils::throwError("(DALStorage::updateCharacter #9) "
-                          "SQL query failure: ", e);
-    }
 
     transaction.commit();
     return true;
@@ -990,6 +1154,20 @@ void Storage::flush(Account *account)
 
     try
     {
+        // Let the jobs left for the characters of the account run before
+        // the transaction is begun, as they would wait for its lock.
+        if (mWaitForWorker)
+        {
+            std::ostringstream sql;
+            sql << "select id from " << CHARACTERS_TBL_NAME
+                << " where user_id = ?";
+            Statement &statement = mDb->prepare(sql.str());
+            statement.bind(1, (int) account->getID());
+            const RecordSet &charInfo = statement.execute();
+            for (unsigned k = 0; k < charInfo.rows(); ++k)
+                waitForWorker(charInfo.getInt(k, 0));
+        }
+
         PerformTransaction transaction(mDb);
 
         // Update the account
@@ -1159,9 +1337,12 @@ void Storage::updateLastLogin(const Account *account)
     {
         std::ostringstream sql;
         sql << "UPDATE " << ACCOUNTS_TBL_NAME
-            << "   SET lastlogin = '" << account->getLastLogin() << "'"
-            << " WHERE id = '" << account->getID() << "';";
-        mDb->execSql(sql.str());
+            << "   SET lastlogin = ?"
+            << " WHERE id = ?";
+        dal::Statement &statement = mDb->prepare(sql.str());
+        statement.bind(1, (int64_t) account->getLastLogin());
+        statement.bind(2, account->getID());
+        statement.execute();
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
@@ -1177,11 +1358,14 @@ void Storage::updateCharacterPoints(int charId,
     {
         std::ostringstream sql;
         sql << "UPDATE " << CHARACTERS_TBL_NAME
-            << " SET char_pts = " << charPoints << ", "
-            << " correct_pts = " << corrPoints
-            << " WHERE id = " << charId;
+            << " SET char_pts = ?, correct_pts = ?"
+            << " WHERE id = ?";
 
-        mDb->execSql(sql.str());
+        dal::Statement &statement = mDb->prepare(sql.str());
+        statement.bind(1, charPoints);
+        statement.bind(2, corrPoints);
+        statement.bind(3, charId);
+        statement.execute();
     }
     catch (dal::DbSqlQueryExecFailure &e)
     {
@@ -1200,33 +1384,36 @@ void Storage::updateExperience(int charId, int skillId, int skillValue)
         if (skillValue == 0)
         {
             sql << "DELETE FROM " << CHAR_SKILLS_TBL_NAME
-                << " WHERE char_id = " << charId
-                << " AND skill_id = " << skillId;
-            mDb->execSql(sql.str());
+                << " WHERE char_id = ? AND skill_id = ?";
+            dal::Statement &statement = mDb->prepare(sql.str());
+            statement.bind(1, charId);
+            statement.bind(2, skillId);
+            statement.execute();
             return;
         }
 
         // Try to update the skill
-        sql.clear();
-        sql.str("");
         sql << "UPDATE " << CHAR_SKILLS_TBL_NAME
-            << " SET skill_exp = " << skillValue
-            << " WHERE char_id = " << charId
-            << " AND skill_id = " << skillId;
-        mDb->execSql(sql.str());
+            << " SET skill_exp = ? WHERE char_id = ? AND skill_id = ?";
+        dal::Statement &update = mDb->prepare(sql.str());
+        update.bind(1, skillValue);
+        update.bind(2, charId);
+        update.bind(3, skillId);
+        update.execute();
 
         // Check if the update has modified a row
-        if (mDb->getModifiedRows() > 0)
+        if (update.getModifiedRows() > 0)
             return;
 
         sql.clear();
         sql.str("");
         sql << "INSERT INTO " << CHAR_SKILLS_TBL_NAME << " "
-            << "(char_id, skill_id, skill_exp) VALUES ( "
-            << charId << ", "
-            << skillId << ", "
-            << skillValue << ")";
-        mDb->execSql(sql.str());
+            << "(char_id, skill_id, skill_exp) VALUES (?, ?, ?)";
+        dal::Statement &insert = mDb->prepare(sql.str());
+        insert.bind(1, charId);
+        insert.bind(2, skillId);
+        insert.bind(3, skillValue);
+        insert.execute();
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
@@ -1242,14 +1429,17 @@ void Storage::updateAttribute(int charId, unsigned int attrId,
     {
         std::ostringstream sql;
         sql << "UPDATE " << CHAR_ATTR_TBL_NAME
-            << " SET attr_base = '" << base << "', "
-            << "attr_mod = '" << mod << "' "
-            << "WHERE char_id = '" << charId << "' "
-            << "AND attr_id = '" << attrId << "';";
-        mDb->execSql(sql.str());
+            << " SET attr_base = ?, attr_mod = ?"
+            << " WHERE char_id = ? AND attr_id = ?";
+        dal::Statement &update = mDb->prepare(sql.str());
+        update.bind(1, base);
+        update.bind(2, mod);
+        update.bind(3, charId);
+        update.bind(4, (int) attrId);
+        update.execute();
 
         // If this has modified a row, we're done, it updated sucessfully.
-        if (mDb->getModifiedRows() > 0)
+        if (update.getModifiedRows() > 0)
             return;
 
         // If it did not change anything,
@@ -1257,10 +1447,13 @@ void Storage::updateAttribute(int charId, unsigned int attrId,
         sql.clear();
         sql.str("");
         sql << "INSERT INTO " << CHAR_ATTR_TBL_NAME
-            << " (char_id, attr_id, attr_base, attr_mod) VALUES ( "
-            << charId << ", " << attrId << ", " << base << ", "
-            << mod << ")";
-        mDb->execSql(sql.str());
+            << " (char_id, attr_id, attr_base, attr_mod) VALUES (?, ?, ?, ?)";
+        dal::Statement &insert = mDb->prepare(sql.str());
+        insert.bind(1, charId);
+        insert.bind(2, (int) attrId);
+        insert.bind(3, base);
+        insert.bind(4, mod);
+        insert.execute();
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
@@ -1276,23 +1469,26 @@ void Storage::updateKillCount(int charId, int monsterId, int kills)
         // Try to update the kill count
         std::ostringstream sql;
         sql << "UPDATE " << CHAR_KILL_COUNT_TBL_NAME
-            << " SET kills = " << kills
-            << " WHERE char_id = " << charId
-            << " AND monster_id = " << monsterId;
-        mDb->execSql(sql.str());
+            << " SET kills = ? WHERE char_id = ? AND monster_id = ?";
+        dal::Statement &update = mDb->prepare(sql.str());
+        update.bind(1, kills);
+        update.bind(2, charId);
+        update.bind(3, monsterId);
+        update.execute();
 
         // Check if the update has modified a row
-        if (mDb->getModifiedRows() > 0)
+        if (update.getModifiedRows() > 0)
             return;
 
         sql.clear();
         sql.str("");
         sql << "INSERT INTO " << CHAR_KILL_COUNT_TBL_NAME << " "
-            << "(char_id, monster_id, kills) VALUES ( "
-            << charId << ", "
-            << monsterId << ", "
-            << kills << ")";
-        mDb->execSql(sql.str());
+            << "(char_id, monster_id, kills) VALUES (?, ?, ?)";
+        dal::Statement &insert = mDb->prepare(sql.str());
+        insert.bind(1, charId);
+        insert.bind(2, monsterId);
+        insert.bind(3, kills);
+        insert.execute();
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
@@ -1308,11 +1504,12 @@ void Storage::insertStatusEffect(int charId, int statusId, int time)
         std::ostringstream sql;
 
         sql << "insert into " << CHAR_STATUS_EFFECTS_TBL_NAME
-            << " (char_id, status_id, status_time) VALUES ( "
-            << charId << ", "
-            << statusId << ", "
-            << time << ")";
-        mDb->execSql(sql.str());
+            << " (char_id, status_id, status_time) VALUES (?, ?, ?)";
+        dal::Statement &statement = mDb->prepare(sql.str());
+        statement.bind(1, charId);
+        statement.bind(2, statusId);
+        statement.bind(3, time);
+        statement.execute();
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
@@ -1470,20 +1667,18 @@ std::list<FloorItem> Storage::getFloorItemsFromMap(int mapId)
     try
     {
         std::ostringstream sql;
-        sql << "SELECT * FROM " << FLOOR_ITEMS_TBL_NAME
-        << " WHERE map_id = " << mapId;
+        sql << "SELECT item_id, amount, pos_x, pos_y FROM "
+            << FLOOR_ITEMS_TBL_NAME << " WHERE map_id = ?";
 
-        string_to< unsigned > toUint;
-        const dal::RecordSet &itemInfo = mDb->execSql(sql.str());
-        if (!itemInfo.isEmpty())
+        dal::Statement &statement = mDb->prepare(sql.str());
+        statement.bind(1, mapId);
+        statement.query();
+        while (statement.next())
         {
-            for (int k = 0, size = itemInfo.rows(); k < size; ++k)
-            {
-                floorItems.push_back(FloorItem(toUint(itemInfo(k, 2)),
-                                                toUint(itemInfo(k, 3)),
-                                                toUint(itemInfo(k, 4)),
-                                                toUint(itemInfo(k, 5))));
-            }
+            floorItems.push_back(FloorItem(statement.getInt(0),
+                                           statement.getInt(1),
+                                           statement.getInt(2),
+                                           statement.getInt(3)));
         }
     }
     catch (const dal::DbSqlQueryExecFailure &e)
@@ -1517,43 +1712,41 @@ std::map<int, Guild*> Storage::getGuildList()
 {
     std::map<int, Guild*> guilds;
     std::stringstream sql;
-    string_to<short> toShort;
 
 
     // Get the guilds stored in the db.
     try
     {
-        sql << "select id, name from " << GUILDS_TBL_NAME << ";";
-        const dal::RecordSet& guildInfo = mDb->execSql(sql.str());
-
-        // Check that at least 1 guild was returned
-        if (guildInfo.isEmpty())
-            return guilds;
+        sql << "select id, name from " << GUILDS_TBL_NAME;
+        dal::Statement &guildStatement = mDb->prepare(sql.str());
+        guildStatement.query();
 
         // Loop through every row in the table and assign it to a guild
-        for (unsigned int i = 0; i < guildInfo.rows(); ++i)
+        while (guildStatement.next())
         {
-            Guild* guild = new Guild(guildInfo(i,1));
-            guild->setId(toShort(guildInfo(i,0)));
+            Guild* guild = new Guild(guildStatement.getString(1));
+            guild->setId((short) guildStatement.getInt(0));
             guilds[guild->getId()] = guild;
         }
-        string_to< unsigned > toUint;
+
+        std::ostringstream memberSql;
+        memberSql << "select member_id, rights from "
+                  << GUILD_MEMBERS_TBL_NAME << " where guild_id = ?";
 
         // Add the members to the guilds.
         for (std::map<int, Guild*>::iterator it = guilds.begin();
              it != guilds.end(); ++it)
         {
-            std::ostringstream memberSql;
-            memberSql << "select member_id, rights from "
-                      << GUILD_MEMBERS_TBL_NAME
-                      << " where guild_id = '" << it->second->getId() << "';";
-            const dal::RecordSet& memberInfo = mDb->execSql(memberSql.str());
+            dal::Statement &memberStatement = mDb->prepare(memberSql.str());
+            memberStatement.bind(1, it->second->getId());
+            memberStatement.query();
 
             std::list<std::pair<int, int> > members;
-            for (unsigned int j = 0; j < memberInfo.rows(); ++j)
+            while (memberStatement.next())
             {
-                members.push_back(std::pair<int, int>(toUint(memberInfo(j, 0)),
-                                                     toUint(memberInfo(j, 1))));
+                members.push_back(std::pair<int, int>(
+                                      memberStatement.getInt(0),
+                                      memberStatement.getInt(1)));
             }
 
             std::list<std::pair<int, int> >::const_iterator i, i_end;
@@ -1578,25 +1771,20 @@ std::map<int, Guild*> Storage::getGuildList()
 
 std::string Storage::getQuestVar(int id, const std::string &name)
 {
+    waitForWorker(id);
+
     try
     {
         std::ostringstream query;
         query << "select value from " << QUESTS_TBL_NAME
                 << " WHERE owner_id = ? AND name = ?";
-        if (mDb->prepareSql(query.str()))
-        {
-            mDb->bindValue(1, id);
-            mDb->bindValue(2, name);
-            const dal::RecordSet &info = mDb->processSql();
+        dal::Statement &statement = mDb->prepare(query.str());
+        statement.bind(1, id);
+        statement.bind(2, name);
+        const dal::RecordSet &info = statement.execute();
 
-            if (!info.isEmpty())
-                return info(0, 0);
-        }
-        else
-        {
-            utils::throwError("(DALStorage:getQuestVar) "
-                              "SQL query preparation failure.");
-        }
+        if (!info.isEmpty())
+            return info(0, 0);
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
@@ -1622,21 +1810,14 @@ std::string Storage::getWorldStateVar(const std::string &name, int mapId)
 
         //query << ";"; <-- No ';' at the end of prepared statements.
 
-        if (mDb->prepareSql(query.str()))
-        {
-            mDb->bindValue(1, name);
-            if (mapId >= 0)
-                mDb->bindValue(2, mapId);
-            const dal::RecordSet &info = mDb->processSql();
+        dal::Statement &statement = mDb->prepare(query.str());
+        statement.bind(1, name);
+        if (mapId >= 0)
+            statement.bind(2, mapId);
+        const dal::RecordSet &info = statement.execute();
 
-            if (!info.isEmpty())
-                return info(0, 0);
-        }
-        else
-        {
-            utils::throwError("(DALStorage:getWorldStateVar) "
-                              "SQL query preparation failure.");
-        }
+        if (!info.isEmpty())
+            return info(0, 0);
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
@@ -1708,34 +1889,41 @@ void Storage::setWorldStateVar(const std::string &name,
         {
             std::ostringstream deleteStateVar;
             deleteStateVar << "DELETE FROM " << WORLD_STATES_TBL_NAME
-                           << " WHERE state_name = '" << name << "'"
-                           << " AND map_id = '" << mapId << "';";
-            mDb->execSql(deleteStateVar.str());
+                           << " WHERE state_name = ? AND map_id = ?";
+            dal::Statement &statement = mDb->prepare(deleteStateVar.str());
+            statement.bind(1, name);
+            statement.bind(2, mapId);
+            statement.execute();
             return;
         }
 
         // Try to update the variable in the database
         std::ostringstream updateStateVar;
         updateStateVar << "UPDATE " << WORLD_STATES_TBL_NAME
-                       << "   SET value = '" << value << "', "
-                       << "       moddate = '" << time(0) << "' "
-                       << " WHERE state_name = '" << name << "'"
-                       << " AND map_id = '" << mapId << "';";
-        mDb->execSql(updateStateVar.str());
+                       << "   SET value = ?, moddate = ?"
+                       << " WHERE state_name = ? AND map_id = ?";
+        dal::Statement &update = mDb->prepare(updateStateVar.str());
+        update.bind(1, value);
+        update.bind(2, (int64_t) time(0));
+        update.bind(3, name);
+        update.bind(4, mapId);
+        update.execute();
 
         // If we updated a row, were finished here
-        if (mDb->getModifiedRows() > 0)
+        if (update.getModifiedRows() > 0)
             return;
 
         // Otherwise we have to add the new variable
         std::ostringstream insertStateVar;
         insertStateVar << "INSERT INTO " << WORLD_STATES_TBL_NAME
-                       << " (state_name, map_id, value , moddate) VALUES ("
-                       << "'" << name << "', "
-                       << "'" << mapId << "', "
-                       << "'" << value << "', "
-                       << "'" << time(0) << "');";
-        mDb->execSql(insertStateVar.str());
+                       << " (state_name, map_id, value , moddate)"
+                       << " VALUES (?, ?, ?, ?)";
+        dal::Statement &insert = mDb->prepare(insertStateVar.str());
+        insert.bind(1, name);
+        insert.bind(2, mapId);
+        insert.bind(3, value);
+        insert.bind(4, (int64_t) time(0));
+        insert.execute();
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
@@ -1751,18 +1939,23 @@ void Storage::setQuestVar(int id, const std::string &name,
     {
         std::ostringstream query1;
         query1 << "delete from " << QUESTS_TBL_NAME
-               << " where owner_id = '" << id << "' and name = '"
-               << name << "';";
-        mDb->execSql(query1.str());
+               << " where owner_id = ? and name = ?";
+        dal::Statement &remove = mDb->prepare(query1.str());
+        remove.bind(1, id);
+        remove.bind(2, name);
+        remove.execute();
 
         if (value.empty())
             return;
 
         std::ostringstream query2;
         query2 << "insert into " << QUESTS_TBL_NAME
-               << " (owner_id, name, value) values ('"
-               << id << "', '" << name << "', '" << value << "');";
-        mDb->execSql(query2.str());
+               << " (owner_id, name, value) values (?, ?, ?)";
+        dal::Statement &insert = mDb->prepare(query2.str());
+        insert.bind(1, id);
+        insert.bind(2, name);
+        insert.bind(3, value);
+        insert.execute();
     }
     catch (const dal::DbSqlQueryExecFailure &e)
     {
@@ -1802,6 +1995,8 @@ void Storage::banCharacter(int id, int duration)
 
 void Storage::delCharacter(int charId) const
 {
+    waitForWorker(charId);
+
     try
     {
         dal::PerformTransaction transaction(mDb);
@@ -2192,8 +2387,10 @@ void Storage::setOnlineStatus(int charId, bool online)
             // First we try to update the online status. this prevents errors
             // in case we get the online status twice
             sql << "SELECT COUNT(*) FROM " << ONLINE_USERS_TBL_NAME
-                << " WHERE char_id = " << charId;
-            const std::string res = mDb->execSql(sql.str())(0, 0);
+                << " WHERE char_id = ?";
+            dal::Statement &count = mDb->prepare(sql.str());
+            count.bind(1, charId);
+            const std::string res = count.execute()(0, 0);
 
             if (res != "0")
                 return;
@@ -2201,14 +2398,19 @@ void Storage::setOnlineStatus(int charId, bool online)
             sql.clear();
             sql.str("");
             sql << "INSERT INTO " << ONLINE_USERS_TBL_NAME
-                << " VALUES (" << charId << ", " << time(0) << ")";
-            mDb->execSql(sql.str());
+                << " VALUES (?, ?)";
+            dal::Statement &insert = mDb->prepare(sql.str());
+            insert.bind(1, charId);
+            insert.bind(2, (int64_t) time(0));
+            insert.execute();
         }
         else
         {
             sql << "DELETE FROM " << ONLINE_USERS_TBL_NAME
-                << " WHERE char_id = " << charId;
-            mDb->execSql(sql.str());
+                << " WHERE char_id = ?";
+            dal::Statement &remove = mDb->prepare(sql.str());
+            remove.bind(1, charId);
+            remove.execute();
         }
 
 
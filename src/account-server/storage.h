@@ -52,11 +52,25 @@ class Storage
          */
         void open();
 
+        /**
+         * Connect to a database that was already opened, as done by the
+         * database worker threads.
+         */
+        void connect();
+
         /**
          * Disconnect from the database.
          */
         void close();
 
+        /**
+         * Sets whether reads of a character wait for the jobs left for it
+         * on the database worker threads. Only for the storage of the
+         * network loop.
+         */
+        void setWaitForWorker(bool wait)
+        { mWaitForWorker = wait; }
+
         /**
          * Get an account by user name.
          *
@@ -235,10 +249,12 @@ class Storage
          * received from a game server.
          *
          * @param ptr Character to store values in the database.
+         * @param persisted The character as currently stored, if known. Only
+         *                  what differs from it is written then.
          *
          * @return true on success
          */
-        bool updateCharacter(Character *ptr);
+        bool updateCharacter(Character *ptr, const Character *persisted = 0);
 
         /**
          * Save changes of a skill to the database permanently.
@@ -475,18 +491,45 @@ class Storage
         /**
          * Gets an account from a prepared SQL statement
          *
+         * @param statement the statement selecting the account, with its
+         *                  values bound.
+         *
          * @return the account found
          */
-        Account *getAccountBySQL();
+        Account *getAccountBySQL(dal::Statement &statement);
 
         /**
          * Gets a character from a prepared SQL statement
          *
+         * @param statement the statement selecting the character, with its
+         *                  values bound.
          * @param owner the account the character is in.
          *
          * @return the character found by the query.
          */
-        Character *getCharacterBySQL(Account *owner);
+        Character *getCharacterBySQL(dal::Statement &statement,
+                                     Account *owner);
+
+        typedef std::map< int, Character * > CharactersById;
+
+        /**
+         * Creates a character from a row of the characters table, without
+         * the data of the other tables.
+         *
+         * @param owner the account the character is in, or NULL to only
+         *              load the account level.
+         */
+        Character *readCharacter(const dal::RecordSet &charInfo,
+                                 unsigned row, Account *owner);
+
+        /**
+         * Loads the attributes, skills, status effects, kills, specials,
+         * equipment and inventory of some characters, with one query for
+         * each table.
+         *
+         * @param characters the characters, by database id.
+         */
+        void loadCharacterData(const CharactersById &characters);
 
         /**
          * Fix improper character slots
@@ -507,8 +550,17 @@ class Storage
          */
         void syncDatabase();
 
+        /**
+         * Waits for the database worker to run the jobs left for a
+         * character, when enabled.
+         *
+         * @return whether there were jobs to wait for.
+         */
+        bool waitForWorker(int charId) const;
+
         dal::DataProvider *mDb;         /**< the data provider */
         unsigned int mItemDbVersion;    /**< Version of the item database. */
+        bool mWaitForWorker;
 };
 
 extern Storage *storage;
@@ -31,6 +31,7 @@
 #include "chat-server/chathandler.h"
 #include "common/manaserv_protocol.h"
 #include "common/transaction.h"
+#include "net/broadcast.h"
 #include "net/connectionhandler.h"
 #include "net/messagein.h"
 #include "net/messageout.h"
@@ -646,11 +647,12 @@ void ChatHandler::warnUsersAboutPlayerEventInChat(ChatChannel *channel,
 void ChatHandler::sendInChannel(ChatChannel *channel, MessageOut &msg)
 {
     const ChatChannel::ChannelUsers &users = channel->getUserList();
+    Broadcast broadcast(msg);
 
     for (ChatChannel::ChannelUsers::const_iterator
          i = users.begin(), i_end = users.end(); i != i_end; ++i)
     {
-        (*i)->send(msg);
+        broadcast.send(*i);
     }
 }
 
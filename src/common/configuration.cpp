@@ -19,9 +19,11 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cmath>
 #include <map>
 #include <set>
+#include <vector>
 #include <libxml/xmlreader.h>
 
 #include "common/configuration.h"
@@ -37,6 +39,31 @@ static std::map< std::string, std::string > options;
 /**< Location of config file. */
 static std::string configPath;
 static std::set<std::string> processedFiles;
+static bool initialized = false;
+
+typedef std::multimap< std::string, Configuration::Listener * > Listeners;
+static Listeners listeners;
+
+/**
+ * Options resolved into plain fields. Kept in a function so that options
+ * can be static objects constructed before this file's statics.
+ */
+static std::vector< Configuration::ResolvedOption * > &resolvedOptions()
+{
+    static std::vector< Configuration::ResolvedOption * > resolved;
+    return resolved;
+}
+
+static void refreshResolvedOptions()
+{
+    std::vector< Configuration::ResolvedOption * > &resolved =
+            resolvedOptions();
+    for (std::vector< Configuration::ResolvedOption * >::iterator
+         i = resolved.begin(), i_end = resolved.end(); i != i_end; ++i)
+    {
+        (*i)->refresh();
+    }
+}
 
 static bool readFile(const std::string &fileName)
 {
@@ -92,6 +119,8 @@ bool Configuration::initialize(const std::string &fileName)
         configPath = fileName;
 
     const bool success = readFile(configPath);
+    initialized = true;
+    refreshResolvedOptions();
 
     LOG_INFO("Using config file: " << configPath);
 
@@ -101,6 +130,87 @@ bool Configuration::initialize(const std::string &fileName)
 void Configuration::deinitialize()
 {
     processedFiles.clear();
+    initialized = false;
+}
+
+bool Configuration::isInitialized()
+{
+    return initialized;
+}
+
+bool Configuration::reload()
+{
+    std::map< std::string, std::string > previous;
+    previous.swap(options);
+    processedFiles.clear();
+
+    if (!readFile(configPath))
+    {
+        LOG_WARN("Could not reload config file " << configPath
+                 << ", keeping the current options.");
+        options.swap(previous);
+        return false;
+    }
+
+    refreshResolvedOptions();
+    LOG_INFO("Reloaded config file: " << configPath);
+
+    // Copy the listeners, as they may remove themselves when notified
+    std::vector< std::pair< std::string, Listener * > > changed;
+    for (Listeners::iterator i = listeners.begin(), i_end = listeners.end();
+         i != i_end; ++i)
+    {
+        std::map< std::string, std::string >::iterator before =
+                previous.find(i->first);
+        std::map< std::string, std::string >::iterator after =
+                options.find(i->first);
+
+        const bool hadValue = before != previous.end();
+        const bool hasValue = after != options.end();
+        if (hadValue != hasValue ||
+            (hasValue && before->second != after->second))
+        {
+            changed.push_back(*i);
+        }
+    }
+
+    for (std::vector< std::pair< std::string, Listener * > >::iterator
+         i = changed.begin(), i_end = changed.end(); i != i_end; ++i)
+    {
+        i->second->optionChanged(i->first);
+    }
+
+    return true;
+}
+
+void Configuration::addListener(const std::string &key, Listener *listener)
+{
+    listeners.insert(std::make_pair(key, listener));
+}
+
+void Configuration::removeListener(Listener *listener)
+{
+    Listeners::iterator i = listeners.begin();
+    while (i != listeners.end())
+    {
+        if (i->second == listener)
+            listeners.erase(i++);
+        else
+            ++i;
+    }
+}
+
+Configuration::ResolvedOption::ResolvedOption(const std::string &key):
+    mKey(key)
+{
+    resolvedOptions().push_back(this);
+}
+
+Configuration::ResolvedOption::~ResolvedOption()
+{
+    std::vector< ResolvedOption * > &resolved = resolvedOptions();
+    resolved.erase(std::remove(resolved.begin(), resolved.end(), this),
+                   resolved.end());
 }
 
 std::string Configuration::getValue(const std::string &key,
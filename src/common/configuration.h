@@ -57,6 +57,112 @@ namespace Configuration
      * @param deflt default value.
      */
     bool getBoolValue(const std::string &key, bool deflt);
+
+    /**
+     * Reads the configuration file again. Resolved options are updated and
+     * the listeners of the options that changed are notified.
+     *
+     * @return whether the configuration file could be read. When not, the
+     *         previous options are kept.
+     */
+    bool reload();
+
+    /**
+     * Tells whether the configuration was read by initialize().
+     */
+    bool isInitialized();
+
+    /**
+     * Gets notified about options changing when the configuration is
+     * reloaded.
+     */
+    class Listener
+    {
+        public:
+            virtual ~Listener() {}
+
+            /**
+             * Called once the value of an option the listener was added for
+             * has changed.
+             */
+            virtual void optionChanged(const std::string &key) = 0;
+    };
+
+    void addListener(const std::string &key, Listener *listener);
+
+    void removeListener(Listener *listener);
+
+    /**
+     * An option of which the key is only looked up when the configuration is
+     * (re)loaded, see Option.
+     */
+    class ResolvedOption
+    {
+        public:
+            ResolvedOption(const std::string &key);
+
+            virtual ~ResolvedOption();
+
+            const std::string &getKey() const
+            { return mKey; }
+
+            /**
+             * Reads the current value of the option.
+             */
+            virtual void refresh() = 0;
+
+        private:
+            ResolvedOption(const ResolvedOption &);
+            ResolvedOption &operator=(const ResolvedOption &);
+
+            std::string mKey;
+    };
+
+    inline int readOption(const std::string &key, int deflt)
+    { return getValue(key, deflt); }
+
+    inline bool readOption(const std::string &key, bool deflt)
+    { return getBoolValue(key, deflt); }
+
+    inline std::string readOption(const std::string &key,
+                                  const std::string &deflt)
+    { return getValue(key, deflt); }
+
+    /**
+     * An option kept in a plain field of the given type, for use in code
+     * running often. It is meant to be a static object:
+     *
+     *   static Configuration::Option< int > visualRange("game_visualRange",
+     *                                                    448);
+     */
+    template< typename T >
+    class Option : public ResolvedOption
+    {
+        public:
+            Option(const std::string &key, const T &deflt)
+                : ResolvedOption(key),
+                  mDefault(deflt),
+                  mValue(deflt)
+            {
+                // Static options may be constructed before the configuration
+                // is read, in which case they are resolved by initialize()
+                if (isInitialized())
+                    refresh();
+            }
+
+            const T &get() const
+            { return mValue; }
+
+            operator const T &() const
+            { return mValue; }
+
+            void refresh()
+            { mValue = readOption(getKey(), mDefault); }
+
+        private:
+            T mDefault;
+            T mValue;
+    };
 }
 
 #ifndef DEFAULT_SERVER_PORT
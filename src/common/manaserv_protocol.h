@@ -45,6 +45,16 @@ enum ValueType {
     Double
 };
 
+/**
+ * Markers of the binary encodings of a double, written in place of the
+ * length of its text, which never reaches them.
+ */
+enum {
+    DOUBLE_FIXED_POINT = 0xFE,  // D value * DOUBLE_FIXED_POINT_SCALE
+    DOUBLE_IEEE754     = 0xFF,  // D high word, D low word of the bits
+    DOUBLE_FIXED_POINT_SCALE = 1000
+};
+
 /**
  * Enumerated type for communicated messages:
  *
@@ -93,8 +103,8 @@ enum {
     PAMSG_PASSWORD_CHANGE          = 0x0034, // S old password, S new password
     APMSG_PASSWORD_CHANGE_RESPONSE = 0x0035, // B error
 
-    PGMSG_CONNECT                  = 0x0050, // B*32 token
-    GPMSG_CONNECT_RESPONSE         = 0x0051, // B error
+    PGMSG_CONNECT                  = 0x0050, // B*32 token, [B capabilities]
+    GPMSG_CONNECT_RESPONSE         = 0x0051, // B error, [B capabilities]
     PCMSG_CONNECT                  = 0x0053, // B*32 token
     CPMSG_CONNECT_RESPONSE         = 0x0054, // B error
 
@@ -106,6 +116,8 @@ enum {
     PAMSG_RECONNECT                = 0x0065, // B*32 token
     APMSG_RECONNECT_RESPONSE       = 0x0066, // B error
 
+    XXMSG_BUNDLE                   = 0x0070, // { W length, B*length message }*
+
     // Game
     GPMSG_PLAYER_MAP_CHANGE        = 0x0100, // S filename, W x, W y
     GPMSG_PLAYER_SERVER_CHANGE     = 0x0101, // B*32 token, S game address, W game port
@@ -221,6 +233,7 @@ enum {
     CPMSG_PARTY_QUIT_RESPONSE           = 0x03AB, // B error
     CPMSG_PARTY_NEW_MEMBER              = 0x03B0, // S name, S inviter
     CPMSG_PARTY_MEMBER_LEFT             = 0x03B1, // D character id
+    GPMSG_PARTY_MEMBER_HEALTH           = 0x03B2, // D character id, W hp, W max hp
 
     // Chat
     CPMSG_ERROR                    = 0x0401, // B error
@@ -248,11 +261,13 @@ enum {
     PCMSG_KICK_USER                   = 0x0466, // W channel id, S name
 
     // Inter-server
-    GAMSG_REGISTER              = 0x0500, // S address, W port, S password, D items db revision, { W map id }*
-    AGMSG_REGISTER_RESPONSE     = 0x0501, // W item version, W password response, { S globalvar_key, S globalvar_value }
+    GAMSG_REGISTER              = 0x0500, // S address, W port, S password, D items db revision, B link features, { W map id }*
+    AGMSG_REGISTER_RESPONSE     = 0x0501, // W item version, W password response, B link features, { S globalvar_key, S globalvar_value }
     AGMSG_ACTIVE_MAP            = 0x0502, // W map id, W Number of mapvar_key mapvar_value sent, { S mapvar_key, S mapvar_value }, W Number of map items, { D item Id, W amount, W posX, W posY }
     AGMSG_PLAYER_ENTER          = 0x0510, // B*32 token, D id, S name, serialised character data
     GAMSG_PLAYER_DATA           = 0x0520, // D id, serialised character data
+    GAMSG_PLAYER_CHANGES        = 0x0521, // D id, serialised character changes
+    AGMSG_PLAYER_DATA_REQUEST   = 0x0522, // D id
     GAMSG_REDIRECT              = 0x0530, // D id
     AGMSG_REDIRECT_RESPONSE     = 0x0531, // D id, B*32 token, S game address, W game port
     GAMSG_PLAYER_RECONNECT      = 0x0532, // D id, B*32 token
@@ -269,7 +284,7 @@ enum {
     GAMSG_BAN_PLAYER            = 0x0550, // D id, W duration
     GAMSG_CHANGE_PLAYER_LEVEL   = 0x0555, // D id, W level
     GAMSG_CHANGE_ACCOUNT_LEVEL  = 0x0556, // D id, W level
-    GAMSG_STATISTICS            = 0x0560, // { W map id, W entity nb, W monster nb, W player nb, { D character id }* }*
+    GAMSG_STATISTICS            = 0x0560, // B phase nb, { S phase name, D p50 us, D p99 us, D max us }*, { W map id, W entity nb, W monster nb, W player nb, { D character id }*, D update p50 us, D update p99 us, D update max us, D inform p50 us, D inform p99 us, D inform max us }*
     CGMSG_CHANGED_PARTY         = 0x0590, // D character id, D party id
     GCMSG_REQUEST_POST          = 0x05A0, // D character id
     CGMSG_POST_RESPONSE         = 0x05A1, // D receiver id, { S sender name, S letter, W num attachments { W attachment item id, W quantity } }
@@ -302,6 +317,13 @@ enum {
     ERRMSG_ALREADY_MEMBER               // is already member of guild/party
 };
 
+// used in GAMSG_REGISTER for the features of the link supported by the game
+// server, and in AGMSG_REGISTER_RESPONSE for those accepted
+enum {
+    LINK_BINARY_DOUBLES   = 0x01,       // doubles may be written in binary
+    LINK_CHARACTER_CHANGES = 0x02       // GAMSG_PLAYER_CHANGES is understood
+};
+
 // used in AGMSG_REGISTER_RESPONSE to show state of item db
 enum {
     DATA_VERSION_OK       = 0x00,
@@ -322,6 +344,12 @@ enum {
     SYNC_ONLINE_STATUS       = 0x04        // D charId, B 0 = offline, 1 = online
 };
 
+// Optional protocol features, requested in PGMSG_CONNECT and confirmed in
+// GPMSG_CONNECT_RESPONSE.
+enum {
+    CAPABILITY_BUNDLE = 0x01            // messages may arrive in XXMSG_BUNDLE
+};
+
 // Login specific return values
 enum {
     LOGIN_INVALID_VERSION = 0x40,       // the user is using an incompatible protocol
@@ -20,6 +20,11 @@
 
 #include "dataprovider.h"
 
+#include <algorithm>
+
+#include "dalexcept.h"
+
+#include "common/configuration.h"
 #include "utils/logger.h"
 
 namespace dal
@@ -57,13 +62,18 @@ void PerformTransaction::commit()
 DataProvider::DataProvider()
     throw()
         : mIsConnected(false),
-          mRecordSet()
+          mRecordSet(),
+          mStatementCacheSize(std::max(
+              Configuration::getValue("db_statementCacheSize", 64), 16)),
+          mStatement(0)
 {
 }
 
 DataProvider::~DataProvider()
     throw()
 {
+    // Statements are dropped by the data providers when disconnecting, while
+    // they can still be finalized.
 }
 
 /**
@@ -88,4 +98,91 @@ std::string DataProvider::getDbName() const
     return mDbName;
 }
 
+Statement &DataProvider::prepare(const std::string &sql)
+{
+    if (!mIsConnected)
+        throw std::runtime_error("not connected to database");
+
+    std::map< std::string, Statements::iterator >::iterator it =
+            mStatementsBySql.find(sql);
+    if (it != mStatementsBySql.end())
+    {
+        // Move it to the front, as the most recently used
+        mStatements.splice(mStatements.begin(), mStatements, it->second);
+        return *mStatements.front();
+    }
+
+    LOG_DEBUG("Preparing SQL statement: " << sql);
+    Statement *statement = createStatement(sql);
+    mStatements.push_front(statement);
+    mStatementsBySql[sql] = mStatements.begin();
+
+    if (mStatements.size() > mStatementCacheSize)
+    {
+        Statement *oldest = mStatements.back();
+        mStatements.pop_back();
+        mStatementsBySql.erase(oldest->getSql());
+        if (mStatement == oldest)
+            mStatement = 0;
+        delete oldest;
+    }
+
+    return *statement;
+}
+
+void DataProvider::clearStatements()
+{
+    for (Statements::iterator it = mStatements.begin(),
+         it_end = mStatements.end(); it != it_end; ++it)
+    {
+        delete *it;
+    }
+    mStatements.clear();
+    mStatementsBySql.clear();
+    mStatement = 0;
+}
+
+bool DataProvider::prepareSql(const std::string &sql)
+{
+    mStatement = 0;
+    if (!mIsConnected)
+        return false;
+
+    try
+    {
+        mStatement = &prepare(sql);
+    }
+    catch (const DbSqlQueryExecFailure &e)
+    {
+        LOG_ERROR("Failed to prepare SQL statement: " << sql << "\n"
+                  << e.what());
+        return false;
+    }
+    return true;
+}
+
+const RecordSet &DataProvider::processSql()
+{
+    if (!mStatement)
+        throw std::runtime_error("no SQL statement prepared");
+
+    return mStatement->execute();
+}
+
+void DataProvider::bindValue(int place, const std::string &value)
+{
+    if (mStatement)
+        mStatement->bind(place, value);
+    else
+        LOG_ERROR("DataProvider::bindValue: No SQL statement prepared!");
+}
+
+void DataProvider::bindValue(int place, int value)
+{
+    if (mStatement)
+        mStatement->bind(place, value);
+    else
+        LOG_ERROR("DataProvider::bindValue: No SQL statement prepared!");
+}
+
 } // namespace dal
@@ -22,10 +22,13 @@
 #define DATA_PROVIDER_H
 
 
+#include <list>
+#include <map>
 #include <string>
 #include <stdexcept>
 
 #include "recordset.h"
+#include "statement.h"
 
 namespace dal
 {
@@ -177,37 +180,77 @@ class DataProvider
          */
         virtual unsigned getLastId() const = 0;
 
+        /**
+         * Gets a prepared statement for a SQL query, with '?' marking its
+         * parameters.
+         *
+         * Statements are cached by their SQL text, so that a query is only
+         * parsed and planned once by the database. Once the cache holds
+         * db_statementCacheSize statements, the least recently used one is
+         * dropped: a statement stays valid until that many other statements
+         * were asked for since it was last.
+         *
+         * @exception DbSqlQueryExecFailure if the statement could not be
+         *            prepared.
+         * @exception std::runtime_error if trying to query a closed database.
+         */
+        Statement &prepare(const std::string &sql);
+
         /**
          * Prepare SQL statement
+         *
+         * @deprecated Use prepare instead, which allows several live
+         *             statements.
          */
-        virtual bool prepareSql(const std::string &sql) = 0;
+        bool prepareSql(const std::string &sql);
 
         /**
          * Process SQL statement
          * SQL statement needs to be prepared and parameters binded before
          * calling this function
          */
-        virtual const RecordSet& processSql() = 0;
+        const RecordSet& processSql();
 
         /**
          * Bind Value (String)
          * @param place - which parameter to bind to
          * @param value - the string to bind
          */
-        virtual void bindValue(int place, const std::string &value) = 0;
+        void bindValue(int place, const std::string &value);
 
         /**
          * Bind Value (Integer)
          * @param place - which parameter to bind to
          * @param value - the integer to bind
          */
-        virtual void bindValue(int place, int value) = 0;
+        void bindValue(int place, int value);
 
     protected:
+        /**
+         * Prepares a new statement on the connection.
+         *
+         * @exception DbSqlQueryExecFailure if unsuccessful preparation.
+         */
+        virtual Statement *createStatement(const std::string &sql) = 0;
+
+        /**
+         * Drops all the cached statements. Needs to be called before
+         * closing the connection.
+         */
+        void clearStatements();
+
         std::string mDbName;  /**< the database name */
         bool mIsConnected;    /**< the connection status */
         std::string mSql;     /**< cache the last SQL query */
         RecordSet mRecordSet; /**< cache the result of the last SQL query */
+
+    private:
+        typedef std::list< Statement * > Statements;
+
+        Statements mStatements;         /**< Most recently used first. */
+        std::map< std::string, Statements::iterator > mStatementsBySql;
+        unsigned mStatementCacheSize;
+        Statement *mStatement;          /**< Used by processSql. */
 };
 
 
@@ -22,9 +22,267 @@
 
 #include "dalexcept.h"
 
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
 namespace dal
 {
 
+/**
+ * A statement prepared on a MySQL connection. The bound values are kept by
+ * the statement, where the bind structures point to.
+ */
+class MySqlStatement : public Statement
+{
+    public:
+        MySqlStatement(const std::string &sql, MYSQL_STMT *stmt);
+
+        ~MySqlStatement()
+        { mysql_stmt_close(mStmt); }
+
+        void bind(int place, int value)
+        { bind(place, (int64_t) value); }
+
+        void bind(int place, int64_t value)
+        {
+            Parameter &parameter = getParameter(place, MYSQL_TYPE_LONGLONG);
+            parameter.integer = value;
+            mBinds[place - 1].buffer = &parameter.integer;
+        }
+
+        void bind(int place, double value)
+        {
+            Parameter &parameter = getParameter(place, MYSQL_TYPE_DOUBLE);
+            parameter.real = value;
+            mBinds[place - 1].buffer = &parameter.real;
+        }
+
+        void bind(int place, const std::string &value)
+        { bindData(place, MYSQL_TYPE_STRING, value.data(), value.size()); }
+
+        void bindBlob(int place, const void *data, unsigned size)
+        { bindData(place, MYSQL_TYPE_BLOB, data, size); }
+
+        void bindNull(int place)
+        { getParameter(place, MYSQL_TYPE_NULL); }
+
+        void query();
+        bool next();
+
+        bool isNull(int col) const
+        { return mResults.at(col).isNull; }
+
+        int64_t getInt64(int col) const
+        { return strtoll(getValue(col), 0, 10); }
+
+        double getDouble(int col) const
+        { return strtod(getValue(col), 0); }
+
+        std::string getString(int col) const;
+
+    private:
+        struct Parameter
+        {
+            long long integer;
+            double real;
+            std::string data;
+            unsigned long length;
+        };
+
+        Parameter &getParameter(int place, enum_field_types type);
+
+        void bindData(int place, enum_field_types type,
+                      const void *data, unsigned size);
+
+        void fail(const char *what)
+        {
+            std::string msg(mysql_stmt_error(mStmt));
+            LOG_ERROR("MySqlStatement::execute " << what << ": " << msg);
+            throw DbSqlQueryExecFailure(msg);
+        }
+
+        /**
+         * The buffer a column of the results is fetched into, as text.
+         */
+        struct Result
+        {
+            std::vector< char > buffer;
+            unsigned long length;
+            my_bool isNull;
+        };
+
+        const char *getValue(int col) const;
+
+        void freeResult();
+
+        MYSQL_STMT *mStmt;
+        std::vector< MYSQL_BIND > mBinds;
+        std::vector< Parameter > mParameters;
+        std::vector< MYSQL_BIND > mResultBinds;
+        std::vector< Result > mResults;
+        bool mFetching;             /**< A result is stored. */
+};
+
+MySqlStatement::MySqlStatement(const std::string &sql, MYSQL_STMT *stmt)
+    : Statement(sql)
+    , mStmt(stmt)
+    , mBinds(mysql_stmt_param_count(stmt))
+    , mParameters(mBinds.size())
+    , mFetching(false)
+{
+    if (!mBinds.empty())
+        memset(&mBinds[0], 0, mBinds.size() * sizeof(MYSQL_BIND));
+    for (unsigned i = 0; i < mBinds.size(); ++i)
+        mBinds[i].buffer_type = MYSQL_TYPE_NULL;
+
+    // Have the length of the longest value of each column computed, so that
+    // result buffers are large enough
+    my_bool updateMaxLength = 1;
+    mysql_stmt_attr_set(mStmt, STMT_ATTR_UPDATE_MAX_LENGTH, &updateMaxLength);
+}
+
+MySqlStatement::Parameter &MySqlStatement::getParameter(int place,
+                                                        enum_field_types type)
+{
+    if (place < 1 || place > (int) mBinds.size())
+        throw DbSqlQueryExecFailure("bind index out of range");
+
+    MYSQL_BIND &bind = mBinds[place - 1];
+    memset(&bind, 0, sizeof(MYSQL_BIND));
+    bind.buffer_type = type;
+    return mParameters[place - 1];
+}
+
+void MySqlStatement::bindData(int place, enum_field_types type,
+                              const void *data, unsigned size)
+{
+    Parameter &parameter = getParameter(place, type);
+    parameter.data.assign(static_cast< const char * >(data), size);
+    parameter.length = size;
+
+    MYSQL_BIND &bind = mBinds[place - 1];
+    bind.buffer = (void *) parameter.data.data();
+    bind.buffer_length = size;
+    bind.length = &parameter.length;
+}
+
+void MySqlStatement::freeResult()
+{
+    if (mFetching)
+    {
+        mysql_stmt_free_result(mStmt);
+        mFetching = false;
+    }
+}
+
+void MySqlStatement::query()
+{
+    freeResult();
+    mRecordSet.clear();
+    mModifiedRows = 0;
+
+    if (!mBinds.empty() && mysql_stmt_bind_param(mStmt, &mBinds[0]))
+        fail("bind params failed");
+
+    if (mysql_stmt_execute(mStmt))
+        fail("execute failed");
+
+    const unsigned nFields = mysql_stmt_field_count(mStmt);
+    if (nFields == 0)
+    {
+        mRecordSet.setColumnHeaders(Row());
+        mModifiedRows = mysql_stmt_affected_rows(mStmt);
+        return;
+    }
+
+    if (mysql_stmt_store_result(mStmt))
+        fail("store result failed");
+    mFetching = true;
+
+    MYSQL_RES *res = mysql_stmt_result_metadata(mStmt);
+    MYSQL_FIELD *fields = mysql_fetch_fields(res);
+
+    Row fieldNames;
+    mResultBinds.resize(nFields);
+    mResults.resize(nFields);
+    memset(&mResultBinds[0], 0, nFields * sizeof(MYSQL_BIND));
+
+    for (unsigned i = 0; i < nFields; ++i)
+    {
+        fieldNames.push_back(fields[i].name);
+
+        // Longer values are fetched again by getString(). The extra byte
+        // keeps values terminated for the conversions to numbers.
+        Result &result = mResults[i];
+        result.buffer.resize(std::max< unsigned long >(fields[i].max_length,
+                                                       32) + 1);
+        mResultBinds[i].buffer_type = MYSQL_TYPE_STRING;
+        mResultBinds[i].buffer = &result.buffer[0];
+        mResultBinds[i].buffer_length = result.buffer.size() - 1;
+        mResultBinds[i].length = &result.length;
+        mResultBinds[i].is_null = &result.isNull;
+    }
+    mysql_free_result(res);
+    mRecordSet.setColumnHeaders(fieldNames);
+
+    if (mysql_stmt_bind_result(mStmt, &mResultBinds[0]))
+    {
+        freeResult();
+        fail("bind result failed");
+    }
+}
+
+bool MySqlStatement::next()
+{
+    if (!mFetching)
+        return false;
+
+    const int status = mysql_stmt_fetch(mStmt);
+    if (status == 0 || status == MYSQL_DATA_TRUNCATED)
+    {
+        for (unsigned i = 0; i < mResults.size(); ++i)
+        {
+            Result &result = mResults[i];
+            const unsigned long size = result.buffer.size() - 1;
+            result.buffer[std::min(result.length, size)] = '\0';
+        }
+        return true;
+    }
+
+    freeResult();
+    if (status == 1)
+        fail("fetch failed");
+
+    return false;
+}
+
+const char *MySqlStatement::getValue(int col) const
+{
+    const Result &result = mResults.at(col);
+    return result.isNull ? "" : &result.buffer[0];
+}
+
+std::string MySqlStatement::getString(int col) const
+{
+    const Result &result = mResults.at(col);
+    if (result.isNull)
+        return std::string();
+
+    if (result.length < result.buffer.size())
+        return std::string(&result.buffer[0], result.length);
+
+    std::string value(result.length, '\0');
+    MYSQL_BIND bind;
+    memset(&bind, 0, sizeof(MYSQL_BIND));
+    bind.buffer_type = MYSQL_TYPE_STRING;
+    bind.buffer = &value[0];
+    bind.buffer_length = value.size();
+    mysql_stmt_fetch_column(mStmt, &bind, col, 0);
+    return value;
+}
+
 const std::string  MySqlDataProvider::CFGPARAM_MYSQL_HOST ="mysql_hostname";
 const std::string  MySqlDataProvider::CFGPARAM_MYSQL_PORT ="mysql_port";
 const std::string  MySqlDataProvider::CFGPARAM_MYSQL_DB   ="mysql_database";
@@ -40,8 +298,6 @@ const std::string  MySqlDataProvider::CFGPARAM_MYSQL_PWD_DEF  = "mana";
 MySqlDataProvider::MySqlDataProvider()
     throw()
         : mDb(0),
-          mStmt(0),
-          mBind(0),
           mInTransaction(false)
 {
 }
@@ -120,9 +376,6 @@ void MySqlDataProvider::connect()
     // Save the Db Name.
     mDbName = dbName;
 
-    // Initialize statement structure
-    mStmt = mysql_stmt_init(mDb);
-
     mIsConnected = true;
     LOG_INFO("Connection to mySQL was sucessfull.");
 }
@@ -194,19 +447,16 @@ void MySqlDataProvider::disconnect()
     if (!mIsConnected)
         return;
 
+    // Close the statements while the connection is still open.
+    clearStatements();
+
     // mysql_close() closes the connection and deallocates the connection
     // handle allocated by mysql_init().
     mysql_close(mDb);
 
-    // Clean possible statement.
-    mysql_stmt_close(mStmt);
-
     // deinitialize the MySQL client library.
     mysql_library_end();
 
-    // Clean potential active binds
-    cleanBinds();
-
     mDb = 0;
     mIsConnected = false;
 }
@@ -356,164 +606,22 @@ unsigned MySqlDataProvider::getLastId() const
     return (unsigned) lastId;
 }
 
-bool MySqlDataProvider::prepareSql(const std::string &sql)
+Statement *MySqlDataProvider::createStatement(const std::string &sql)
 {
-    if (!mIsConnected)
-        return false;
-
-    LOG_DEBUG("MySqlDataProvider::prepareSql Preparing SQL statement: " << sql);
-
-    cleanBinds();
-
-    if (mysql_stmt_prepare(mStmt, sql.c_str(), sql.size()) != 0)
-        return false;
-
-    // Allocate bind memory now that the prepared state is done.
-    mBind = new MYSQL_BIND[(int)mysql_stmt_param_count(mStmt)];
-
-    return true;
-}
-
-const RecordSet &MySqlDataProvider::processSql()
-{
-    if (!mIsConnected)
-        throw std::runtime_error("not connected to database");
-
-    // Since we'll have to return something in all cases,
-    // we clear the result member first.
-    mRecordSet.clear();
-
-    if (!mBind)
-    {
-        LOG_ERROR("MySqlDataProvider::processSql: "
-                  "No bind done before processing.");
-        return mRecordSet;
-    }
-
-    if (mysql_stmt_bind_param(mStmt, mBind))
-    {
-        LOG_ERROR("MySqlDataProvider::processSql Bind params failed: "
-                  << mysql_stmt_error(mStmt));
-        return mRecordSet;
-    }
-
-    if (mysql_stmt_field_count(mStmt) > 0)
-    {
-        MYSQL_BIND* resultBind;
-        MYSQL_RES* res;
-
-        if (mysql_stmt_execute(mStmt))
-        {
-            LOG_ERROR("MySqlDataProvider::processSql Execute failed: "
-                      << mysql_stmt_error(mStmt));
-        }
-
-        res = mysql_stmt_result_metadata(mStmt);
-
-        // set the field names.
-        unsigned int nFields = mysql_num_fields(res);
-        MYSQL_FIELD* fields = mysql_fetch_fields(res);
-        Row fieldNames;
-
-        resultBind = new MYSQL_BIND[mysql_num_fields(res)];
-
-        unsigned int i = 0;
-        for (i = 0; i < mysql_num_fields(res); ++i)
-        {
-            resultBind[i].buffer_type = MYSQL_TYPE_STRING;
-            resultBind[i].buffer = (void*) new char[255];
-            resultBind[i].buffer_length = 255;
-            resultBind[i].is_null = new my_bool;
-            resultBind[i].length = new unsigned long;
-            resultBind[i].error = new my_bool;
-        }
-
-        if (mysql_stmt_bind_result(mStmt, resultBind))
-        {
-            LOG_ERROR("MySqlDataProvider::processSql Bind result failed: "
-                      << mysql_stmt_error(mStmt));
-        }
-
-        for (i = 0; i < nFields; ++i)
-            fieldNames.push_back(fields[i].name);
-
-        mRecordSet.setColumnHeaders(fieldNames);
-
-        // store the result of the query.
-        if (mysql_stmt_store_result(mStmt))
-            throw DbSqlQueryExecFailure(mysql_stmt_error(mStmt));
-
-        // populate the RecordSet.
-        while (!mysql_stmt_fetch(mStmt))
-        {
-            Row r;
-
-            for (i = 0; i < nFields; ++i)
-                r.push_back(static_cast<char *>(resultBind[i].buffer));
-
-            mRecordSet.add(r);
-        }
+    MYSQL_STMT *stmt = mysql_stmt_init(mDb);
+    if (!stmt)
+        throw DbSqlQueryExecFailure(mysql_error(mDb));
 
-        delete[] resultBind;
-    }
-    else
+    if (mysql_stmt_prepare(stmt, sql.c_str(), sql.size()) != 0)
     {
-        if (mysql_stmt_execute(mStmt))
-        {
-            LOG_ERROR("MySqlDataProvider::processSql Execute failed: "
-                      << mysql_stmt_error(mStmt));
-        }
+        std::string msg(mysql_stmt_error(stmt));
+        LOG_ERROR("MySqlDataProvider::createStatement: " << sql << "\n"
+                  << msg);
+        mysql_stmt_close(stmt);
+        throw DbSqlQueryExecFailure(msg);
     }
 
-    // Free memory
-    mysql_stmt_free_result(mStmt);
-
-    return mRecordSet;
-}
-
-void MySqlDataProvider::bindValue(int place, const std::string &value)
-{
-    unsigned long* size = new unsigned long;
-    *size = value.size();
-    MYSQL_BIND* bind = new MYSQL_BIND;
-    bind->buffer_type= MYSQL_TYPE_STRING;
-    bind->buffer= (void*) value.c_str();
-    bind->buffer_length= value.size();
-    bind->length = size;
-    bind->is_null = 0;
-
-    bindValue(place, bind);
-}
-
-void MySqlDataProvider::bindValue(int place, int value)
-{
-    MYSQL_BIND* bind = new MYSQL_BIND;
-    bind->buffer_type= MYSQL_TYPE_LONG;
-    bind->buffer= &value;
-    bind->is_null = 0;
-
-    bindValue(place, bind);
-}
-
-void MySqlDataProvider::bindValue(int place, MYSQL_BIND* bind)
-{
-    if (!mBind)
-        LOG_ERROR("MySqlDataProvider::bindValue: "
-                  "Attempted to use an unprepared bind!");
-    else if (place > 0 && place <= (int)mysql_stmt_param_count(mStmt))
-        mBind[place - 1] = *bind;
-    else
-        LOG_ERROR("MySqlDataProvider::bindValue: "
-                  "Attempted bind index out of range");
-}
-
-void MySqlDataProvider::cleanBinds()
-{
-    if (mBind)
-    {
-        delete[] mBind;
-        mBind = 0;
-    }
+    return new MySqlStatement(sql, stmt);
 }
 
 } // namespace dal
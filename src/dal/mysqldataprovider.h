@@ -141,43 +141,13 @@ class MySqlDataProvider: public DataProvider
          */
         unsigned getLastId() const;
 
+    protected:
         /**
-         * Prepare SQL statement
+         * Prepares a new statement on the connection.
          */
-        bool prepareSql(const std::string &sql);
-
-        /**
-         * Process SQL statement
-         * SQL statement needs to be prepared and parameters binded before
-         * calling this function
-         */
-        const RecordSet& processSql() ;
-
-        /**
-         * Bind Value (String)
-         * @param place - which parameter to bind to
-         * @param value - the string to bind
-         */
-        void bindValue(int place, const std::string &value);
-
-        /**
-         * Bind Value (Integer)
-         * @param place - which parameter to bind to
-         * @param value - the integer to bind
-         */
-        void bindValue(int place, int value);
+        Statement *createStatement(const std::string &sql);
 
     private:
-        /**
-         * Bind Value (MYSQL_BIND*)
-         * @param place - which parameter to bind to
-         * @param value - the MySQL bind structure itself
-         */
-        void bindValue(int place, MYSQL_BIND* bind);
-
-        /** Clean potential binds */
-        void cleanBinds();
-
         /** defines the name of the hostname config parameter */
         static const std::string CFGPARAM_MYSQL_HOST;
         /** defines the name of the server port config parameter */
@@ -203,10 +173,6 @@ class MySqlDataProvider: public DataProvider
 
         /** The handle to the database connection */
         MYSQL *mDb;
-        /** The prepared statement to process */
-        MYSQL_STMT *mStmt;
-        /** The Bind structure used in prepared statement */
-        MYSQL_BIND* mBind;
         /** Tells whether we're in the middle of a transaction */
         bool mInTransaction;
 };
@@ -21,12 +21,170 @@
 #include "pqdataprovider.h"
 #include "dalexcept.h"
 
+#include <cstdlib>
+#include <limits>
+#include <sstream>
+#include <vector>
+
 namespace dal
 {
 
+/**
+ * A statement prepared on a PostgreSQL connection. Values are sent as text,
+ * except for blobs which are sent as binary.
+ */
+class PqStatement : public Statement
+{
+    public:
+        PqStatement(const std::string &sql, PGconn *db,
+                    const std::string &name, int parameterCount)
+            : Statement(sql)
+            , mDb(db)
+            , mName(name)
+            , mValues(parameterCount)
+            , mLengths(parameterCount)
+            , mFormats(parameterCount)
+            , mIsNull(parameterCount, true)
+            , mResult(0)
+            , mRow(0)
+        {}
+
+        ~PqStatement()
+        {
+            PQclear(mResult);
+            PQclear(PQexec(mDb, ("DEALLOCATE " + mName).c_str()));
+        }
+
+        void bind(int place, int value)
+        { bindNumber(place, value); }
+
+        void bind(int place, int64_t value)
+        { bindNumber(place, value); }
+
+        void bind(int place, double value)
+        { bindNumber(place, value); }
+
+        void bind(int place, const std::string &value)
+        { bindData(place, value.data(), value.size(), 0); }
+
+        void bindBlob(int place, const void *data, unsigned size)
+        { bindData(place, static_cast< const char * >(data), size, 1); }
+
+        void bindNull(int place)
+        {
+            checkPlace(place);
+            mIsNull[place - 1] = true;
+        }
+
+        void query();
+        bool next();
+
+        bool isNull(int col) const
+        { return PQgetisnull(mResult, mRow, col); }
+
+        int64_t getInt64(int col) const
+        { return strtoll(PQgetvalue(mResult, mRow, col), 0, 10); }
+
+        double getDouble(int col) const
+        { return strtod(PQgetvalue(mResult, mRow, col), 0); }
+
+        std::string getString(int col) const
+        {
+            return std::string(PQgetvalue(mResult, mRow, col),
+                               PQgetlength(mResult, mRow, col));
+        }
+
+    private:
+        void checkPlace(int place) const
+        {
+            if (place < 1 || place > (int) mValues.size())
+                throw DbSqlQueryExecFailure("bind index out of range");
+        }
+
+        template< class T >
+        void bindNumber(int place, T value)
+        {
+            std::ostringstream s;
+            s.precision(std::numeric_limits< double >::digits10 + 2);
+            s << value;
+            const std::string text = s.str();
+            bindData(place, text.data(), text.size(), 0);
+        }
+
+        void bindData(int place, const char *data, unsigned size, int format)
+        {
+            checkPlace(place);
+            mValues[place - 1].assign(data, size);
+            mLengths[place - 1] = size;
+            mFormats[place - 1] = format;
+            mIsNull[place - 1] = false;
+        }
+
+        PGconn *mDb;
+        std::string mName;
+        std::vector< std::string > mValues;
+        std::vector< int > mLengths;
+        std::vector< int > mFormats;
+        std::vector< bool > mIsNull;
+
+        PGresult *mResult;          /**< Rows read by next(). */
+        int mRow;
+};
+
+void PqStatement::query()
+{
+    PQclear(mResult);
+    mResult = 0;
+    mRecordSet.clear();
+    mModifiedRows = 0;
+
+    const int nParams = mValues.size();
+    std::vector< const char * > values(nParams);
+    for (int i = 0; i < nParams; ++i)
+        values[i] = mIsNull[i] ? 0 : mValues[i].data();
+
+    PGresult *res = PQexecPrepared(mDb, mName.c_str(), nParams,
+                                   nParams ? &values[0] : 0,
+                                   nParams ? &mLengths[0] : 0,
+                                   nParams ? &mFormats[0] : 0,
+                                   0);
+
+    const ExecStatusType status = PQresultStatus(res);
+    if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK)
+    {
+        std::string msg(PQerrorMessage(mDb));
+        PQclear(res);
+        throw DbSqlQueryExecFailure(msg);
+    }
+
+    const int nFields = PQnfields(res);
+    Row fieldNames;
+    for (int i = 0; i < nFields; ++i)
+        fieldNames.push_back(PQfname(res, i));
+    mRecordSet.setColumnHeaders(fieldNames);
+
+    mModifiedRows = atoi(PQcmdTuples(res));
+    mResult = res;
+    mRow = -1;
+}
+
+bool PqStatement::next()
+{
+    if (!mResult)
+        return false;
+
+    if (++mRow < PQntuples(mResult))
+        return true;
+
+    PQclear(mResult);
+    mResult = 0;
+    return false;
+}
+
 PqDataProvider::PqDataProvider()
     throw()
         : mDb(0)
+        , mStatementCount(0)
 {
 }
 
@@ -135,6 +293,9 @@ void PqDataProvider::disconnect()
     if (!mIsConnected)
         return;
 
+    // Deallocate the statements while the connection is still open.
+    clearStatements();
+
     // finish up with Postgre.
     PQfinish(mDb);
 
@@ -142,4 +303,46 @@ void PqDataProvider::disconnect()
     mIsConnected = false;
 }
 
+Statement *PqDataProvider::createStatement(const std::string &sql)
+{
+    // Number the parameters, leaving quoted text alone
+    std::ostringstream query;
+    int parameterCount = 0;
+    char quote = 0;
+    for (std::string::const_iterator it = sql.begin(), it_end = sql.end();
+         it != it_end; ++it)
+    {
+        if (quote)
+        {
+            if (*it == quote)
+                quote = 0;
+        }
+        else if (*it == '\'' || *it == '"')
+        {
+            quote = *it;
+        }
+        else if (*it == '?')
+        {
+            query << '$' << ++parameterCount;
+            continue;
+        }
+        query << *it;
+    }
+
+    std::ostringstream name;
+    name << "mana_statement_" << ++mStatementCount;
+
+    PGresult *res = PQprepare(mDb, name.str().c_str(), query.str().c_str(),
+                              parameterCount, 0);
+    if (PQresultStatus(res) != PGRES_COMMAND_OK)
+    {
+        std::string msg(PQerrorMessage(mDb));
+        PQclear(res);
+        throw DbSqlQueryExecFailure(msg);
+    }
+    PQclear(res);
+
+    return new PqStatement(sql, mDb, name.str(), parameterCount);
+}
+
 } // namespace dal
@@ -83,8 +83,16 @@ class PqDataProvider: public DataProvider
          */
         void disconnect();
 
+    protected:
+        /**
+         * Prepares a new statement on the connection. The '?' marking the
+         * parameters are turned into the $1, $2, ... used by PostgreSQL.
+         */
+        Statement *createStatement(const std::string &sql);
+
     private:
         PGconn *mDb; /**<  Database connection handle */
+        unsigned mStatementCount; /**< Used to name the statements. */
 };
 
 
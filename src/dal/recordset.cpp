@@ -18,7 +18,7 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#include <algorithm>
+#include <cstdlib>
 #include <sstream>
 #include <stdexcept>
 
@@ -45,6 +45,7 @@ RecordSet::~RecordSet()
 void RecordSet::clear()
 {
     mHeaders.clear();
+    mColumnIndexes.clear();
     mRows.clear();
 }
 
@@ -86,6 +87,16 @@ void RecordSet::setColumnHeaders(const Row &headers)
     }
 
     mHeaders = headers;
+
+    // Like a search through the headers, the first of a name is used
+    for (unsigned int i = 0; i < mHeaders.size(); ++i)
+        mColumnIndexes.insert(std::make_pair(mHeaders[i], i));
+}
+
+int RecordSet::getColumn(const std::string &name) const
+{
+    ColumnIndexes::const_iterator it = mColumnIndexes.find(name);
+    return it != mColumnIndexes.end() ? (int) it->second : -1;
 }
 
 /**
@@ -136,26 +147,27 @@ const std::string &RecordSet::operator()(const unsigned int row,
         throw std::out_of_range(os.str());
     }
 
-    Row::const_iterator it = std::find(mHeaders.begin(),
-                                       mHeaders.end(),
-                                       name);
-    if (it == mHeaders.end()) {
+    const int col = getColumn(name);
+    if (col < 0) {
         std::ostringstream os;
         os << "field " << name << " does not exist." << std::ends;
 
         throw std::invalid_argument(os.str());
     }
 
-    // find the field index.
-    const unsigned int nCols = mHeaders.size();
-    unsigned int i;
-    for (i = 0; i < nCols; ++i) {
-        if (mHeaders[i] == name) {
-            break;
-        }
-    }
+    return mRows[row][col];
+}
+
+int64_t RecordSet::getInt64(const unsigned int row,
+                            const unsigned int col) const
+{
+    return strtoll((*this)(row, col).c_str(), 0, 10);
+}
 
-    return mRows[row][i];
+double RecordSet::getDouble(const unsigned int row,
+                            const unsigned int col) const
+{
+    return strtod((*this)(row, col).c_str(), 0);
 }
 
 std::ostream &operator<<(std::ostream &out, const RecordSet &rhs)
@@ -22,8 +22,12 @@
 #define RECORDSET_H
 
 #include <iostream>
+#include <map>
+#include <string>
 #include <vector>
 
+#include <stdint.h>
+
 namespace dal
 {
 
@@ -37,7 +41,8 @@ typedef std::vector<std::string> Row;
  * A RecordSet to store the result of a SQL query.
  *
  * Limitations:
- *     - the field values are stored and returned as string,
+ *     - the field values are stored as string, the typed accessors
+ *       convert them when called,
  *     - no information about the field data types are stored.
  *     - not thread-safe.
  */
@@ -76,6 +81,15 @@ class RecordSet
          */
         unsigned int cols() const;
 
+        /**
+         * Get the index of a column.
+         *
+         * @param name the field name.
+         *
+         * @return the column index, or -1 if there is no such column.
+         */
+        int getColumn(const std::string &name) const;
+
         /**
          * Set the column headers.
          *
@@ -122,7 +136,7 @@ class RecordSet
         /**
          * Operator()
          * Get the value of a particular field of a particular row
-         * by field name (slower than by field index).
+         * by field name (slower than by field index, see getColumn()).
          *
          * @param row the row index.
          * @param name the field name.
@@ -138,6 +152,20 @@ class RecordSet
                    const std::string &name) const;
 
 
+        /**
+         * Get the value of a field converted to a number, without copying
+         * it. Empty and NULL values give 0.
+         *
+         * @exception std::out_of_range if row or col are out of range.
+         */
+        int getInt(unsigned int row, unsigned int col) const
+        { return (int) getInt64(row, col); }
+
+        int64_t getInt64(unsigned int row, unsigned int col) const;
+
+        double getDouble(unsigned int row, unsigned int col) const;
+
+
         /**
          * Operator<<
          * Append the stringified RecordSet to the output stream.
@@ -165,6 +193,8 @@ class RecordSet
 
     private:
         Row mHeaders; /**< a list of field names */
+        typedef std::map<std::string, unsigned int> ColumnIndexes;
+        ColumnIndexes mColumnIndexes; /**< field indexes by name */
         typedef std::vector<Row> Rows;
         Rows mRows;   /**< a list of records */
 };
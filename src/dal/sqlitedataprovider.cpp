@@ -37,6 +37,118 @@ typedef sqlite_int64 sqlite3_int64;
 namespace dal
 {
 
+/**
+ * A statement prepared on a SQLite connection.
+ */
+class SqLiteStatement : public Statement
+{
+    public:
+        SqLiteStatement(const std::string &sql, sqlite3 *db,
+                        sqlite3_stmt *stmt)
+            : Statement(sql)
+            , mDb(db)
+            , mStmt(stmt)
+            , mStepping(false)
+        {}
+
+        ~SqLiteStatement()
+        { sqlite3_finalize(mStmt); }
+
+        void bind(int place, int value)
+        { check(sqlite3_bind_int(mStmt, place, value)); }
+
+        void bind(int place, int64_t value)
+        { check(sqlite3_bind_int64(mStmt, place, value)); }
+
+        void bind(int place, double value)
+        { check(sqlite3_bind_double(mStmt, place, value)); }
+
+        void bind(int place, const std::string &value)
+        {
+            check(sqlite3_bind_text(mStmt, place, value.c_str(), value.size(),
+                                    SQLITE_TRANSIENT));
+        }
+
+        void bindBlob(int place, const void *data, unsigned size)
+        {
+            check(sqlite3_bind_blob(mStmt, place, data, size,
+                                    SQLITE_TRANSIENT));
+        }
+
+        void bindNull(int place)
+        { check(sqlite3_bind_null(mStmt, place)); }
+
+        void query();
+        bool next();
+
+        bool isNull(int col) const
+        { return sqlite3_column_type(mStmt, col) == SQLITE_NULL; }
+
+        int64_t getInt64(int col) const
+        { return sqlite3_column_int64(mStmt, col); }
+
+        double getDouble(int col) const
+        { return sqlite3_column_double(mStmt, col); }
+
+        std::string getString(int col) const
+        {
+            const char *txt = (const char *) sqlite3_column_text(mStmt, col);
+            return txt ? std::string(txt, sqlite3_column_bytes(mStmt, col))
+                       : std::string();
+        }
+
+    private:
+        void check(int errCode)
+        {
+            if (errCode != SQLITE_OK)
+                throw DbSqlQueryExecFailure(sqlite3_errmsg(mDb));
+        }
+
+        sqlite3 *mDb;
+        sqlite3_stmt *mStmt;
+        bool mStepping;             /**< Rows are left to be read. */
+};
+
+void SqLiteStatement::query()
+{
+    // Stops any previous reading, keeping the values bound
+    sqlite3_reset(mStmt);
+    mRecordSet.clear();
+    mModifiedRows = 0;
+
+    Row fieldNames;
+    for (int col = 0, totalCols = sqlite3_column_count(mStmt);
+         col < totalCols; ++col)
+    {
+        fieldNames.push_back(sqlite3_column_name(mStmt, col));
+    }
+    mRecordSet.setColumnHeaders(fieldNames);
+    mStepping = true;
+}
+
+bool SqLiteStatement::next()
+{
+    if (!mStepping)
+        return false;
+
+    const int errCode = sqlite3_step(mStmt);
+    if (errCode == SQLITE_ROW)
+        return true;
+
+    // Resetting reports the error of the step
+    mStepping = false;
+    sqlite3_reset(mStmt);
+    if (errCode != SQLITE_DONE)
+    {
+        std::string msg(sqlite3_errmsg(mDb));
+        LOG_ERROR("Error in SQL: " << mSql << "\n" << msg);
+        throw DbSqlQueryExecFailure(msg);
+    }
+
+    mModifiedRows = sqlite3_changes(mDb);
+    return false;
+}
+
 const std::string SqLiteDataProvider::CFGPARAM_SQLITE_DB     = "sqlite_database";
 const std::string SqLiteDataProvider::CFGPARAM_SQLITE_DB_DEF = "mana.db";
 
@@ -130,56 +242,56 @@ const RecordSet &SqLiteDataProvider::execSql(const std::string& sql,
     // otherwise just return the recordset from cache.
     if (refresh || (sql != mSql))
     {
-        char** result;
-        int nRows;
-        int nCols;
-        char* errMsg;
-
         mRecordSet.clear();
 
-        int errCode = sqlite3_get_table(
-                          mDb,          // an open database
-                          sql.c_str(),  // SQL to be executed
-                          &result,      // result of the query
-                          &nRows,       // number of result rows
-                          &nCols,       // number of result columns
-                          &errMsg       // error msg
-                      );
-
-        if (errCode != SQLITE_OK)
-        {
-            std::string msg(sqlite3_errmsg(mDb));
-
-            LOG_ERROR("Error in SQL: " << sql << "\n" << msg);
-
-            // free memory
-            sqlite3_free_table(result);
-            sqlite3_free(errMsg);
-
-            throw DbSqlQueryExecFailure(msg);
-        }
-
-        // the first row of result[] contains the field names.
-        Row fieldNames;
-        for (int col = 0; col < nCols; ++col)
-            fieldNames.push_back(result[col]);
-
-        mRecordSet.setColumnHeaders(fieldNames);
-
-        // populate the RecordSet
-        for (int row = 0; row < nRows; ++row)
+        // Run each statement of the query, gathering the rows selected
+        const char *tail = sql.c_str();
+        while (*tail)
         {
-            Row r;
-
-            for (int col = 0; col < nCols; ++col)
-                r.push_back(result[nCols + (row * nCols) + col]);
-
-            mRecordSet.add(r);
+            sqlite3_stmt *stmt = 0;
+            int errCode = sqlite3_prepare_v2(mDb, tail, -1, &stmt, &tail);
+
+            // Only whitespace or comments were left
+            if (errCode == SQLITE_OK && !stmt)
+                break;
+
+            if (errCode == SQLITE_OK)
+            {
+                const int nCols = sqlite3_column_count(stmt);
+                if (nCols > 0 && mRecordSet.cols() == 0)
+                {
+                    Row fieldNames;
+                    for (int col = 0; col < nCols; ++col)
+                        fieldNames.push_back(sqlite3_column_name(stmt, col));
+                    mRecordSet.setColumnHeaders(fieldNames);
+                }
+
+                while ((errCode = sqlite3_step(stmt)) == SQLITE_ROW)
+                {
+                    Row r;
+                    for (int col = 0; col < nCols; ++col)
+                    {
+                        const char *txt =
+                                (const char *) sqlite3_column_text(stmt, col);
+                        r.push_back(txt ? std::string(
+                                        txt, sqlite3_column_bytes(stmt, col))
+                                        : std::string());
+                    }
+                    mRecordSet.add(r);
+                }
+            }
+
+            if (errCode != SQLITE_OK && errCode != SQLITE_DONE)
+            {
+                std::string msg(sqlite3_errmsg(mDb));
+                sqlite3_finalize(stmt);
+
+                LOG_ERROR("Error in SQL: " << sql << "\n" << msg);
+                throw DbSqlQueryExecFailure(msg);
+            }
+
+            sqlite3_finalize(stmt);
         }
-
-        // free memory
-        sqlite3_free_table(result);
-        sqlite3_free(errMsg);
     }
 
     return mRecordSet;
@@ -193,6 +305,9 @@ void SqLiteDataProvider::disconnect()
     if (!isConnected())
         return;
 
+    // Statements need to be finalized for the connection to be closed.
+    clearStatements();
+
     // sqlite3_close() closes the connection and deallocates the connection
     // handle.
     if (sqlite3_close(mDb) != SQLITE_OK)
@@ -351,62 +466,18 @@ unsigned SqLiteDataProvider::getLastId() const
     return (unsigned) lastId;
 }
 
-bool SqLiteDataProvider::prepareSql(const std::string &sql)
+Statement *SqLiteDataProvider::createStatement(const std::string &sql)
 {
-    if (!mIsConnected)
-        return false;
-
-    LOG_DEBUG("Preparing SQL statement: "<<sql);
-
-    mRecordSet.clear();
-
+    sqlite3_stmt *stmt;
     if (sqlite3_prepare_v2(mDb, sql.c_str(), sql.size(),
-            &mStmt, NULL) != SQLITE_OK)
-        return false;
-
-    return true;
-}
-
-const RecordSet &SqLiteDataProvider::processSql()
-{
-    if (!mIsConnected)
-        throw std::runtime_error("not connected to database");
-
-    int totalCols = sqlite3_column_count(mStmt);
-
-    // ensure we set column headers before adding a row
-    Row fieldNames;
-    for (int col = 0; col < totalCols; ++col)
+                           &stmt, NULL) != SQLITE_OK)
     {
-        fieldNames.push_back(sqlite3_column_name(mStmt, col));
-    }
-    mRecordSet.setColumnHeaders(fieldNames);
-
-    while (sqlite3_step(mStmt) == SQLITE_ROW)
-    {
-        Row r;
-        for (int col = 0; col < totalCols; ++col)
-        {
-            const unsigned char *txt = sqlite3_column_text(mStmt, col);
-            r.push_back(txt ? (char*)txt : std::string());
-
-        }
-        mRecordSet.add(r);
+        std::string msg(sqlite3_errmsg(mDb));
+        LOG_ERROR("Error in SQL: " << sql << "\n" << msg);
+        throw DbSqlQueryExecFailure(msg);
     }
 
-    sqlite3_finalize(mStmt);
-
-    return mRecordSet;
-}
-
-void SqLiteDataProvider::bindValue(int place, const std::string &value)
-{
-    sqlite3_bind_text(mStmt, place, value.c_str(), value.size(), SQLITE_STATIC);
-}
-
-void SqLiteDataProvider::bindValue(int place, int value)
-{
-    sqlite3_bind_int(mStmt, place, value);
+    return new SqLiteStatement(sql, mDb, stmt);
 }
 
 } // namespace dal
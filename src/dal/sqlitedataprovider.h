@@ -125,31 +125,11 @@ class SqLiteDataProvider: public DataProvider
          */
         unsigned getLastId() const;
 
+    protected:
         /**
-         * Prepare SQL statement
+         * Prepares a new statement on the connection.
          */
-        bool prepareSql(const std::string &sql);
-
-        /**
-         * Process SQL statement
-         * SQL statement needs to be prepared and parameters binded before
-         * calling this function
-         */
-        const RecordSet& processSql();
-
-        /**
-         * Bind Value (String)
-         * @param place - which parameter to bind to
-         * @param value - the string to bind
-         */
-        void bindValue(int place, const std::string &value);
-
-        /**
-         * Bind Value (Integer)
-         * @param place - which parameter to bind to
-         * @param value - the integer to bind
-         */
-        void bindValue(int place, int value);
+        Statement *createStatement(const std::string &sql);
 
     private:
         /** defines the name of the database config parameter */
@@ -158,7 +138,6 @@ class SqLiteDataProvider: public DataProvider
         static const std::string CFGPARAM_SQLITE_DB_DEF;
 
         sqlite3 *mDb; /**< the handle to the database connection */
-        sqlite3_stmt *mStmt; /**< the prepared statement to process */
 };
 
 
@@ -0,0 +1,42 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "dal/statement.h"
+
+namespace dal
+{
+
+const RecordSet &Statement::execute()
+{
+    query();
+
+    const int nCols = mRecordSet.cols();
+    Row row(nCols);
+    while (next())
+    {
+        for (int col = 0; col < nCols; ++col)
+            row[col] = getString(col);
+        mRecordSet.add(row);
+    }
+
+    return mRecordSet;
+}
+
+} // namespace dal
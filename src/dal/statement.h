@@ -0,0 +1,148 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef STATEMENT_H
+#define STATEMENT_H
+
+#include <string>
+#include <stdint.h>
+
+#include "recordset.h"
+
+namespace dal
+{
+
+/**
+ * A prepared SQL statement, made and owned by a data provider.
+ *
+ * The parameters are marked by '?' in the SQL text and bound by place,
+ * starting at 1. Values stay bound until they are replaced, so a statement
+ * can be executed again after changing only some of them. Values are copied
+ * when bound.
+ *
+ * Since the overloads for integers are distinct, unsigned and other integer
+ * types need to be cast to int or int64_t when bound.
+ *
+ * The selected rows can either be gathered as strings in a record set by
+ * execute(), or read one at a time with query() and next(), in which case
+ * the values are read from the driver in their type.
+ */
+class Statement
+{
+    public:
+        Statement(const std::string &sql)
+            : mSql(sql)
+            , mModifiedRows(0)
+        {}
+
+        virtual ~Statement()
+        {}
+
+        /**
+         * Gets the SQL text the statement was prepared from.
+         */
+        const std::string &getSql() const
+        { return mSql; }
+
+        /**
+         * Binds values to a parameter.
+         *
+         * @exception DbSqlQueryExecFailure if the place is out of range.
+         */
+        virtual void bind(int place, int value) = 0;
+        virtual void bind(int place, int64_t value) = 0;
+        virtual void bind(int place, double value) = 0;
+        virtual void bind(int place, const std::string &value) = 0;
+
+        /**
+         * Binds binary data to a parameter.
+         */
+        virtual void bindBlob(int place, const void *data,
+                              unsigned size) = 0;
+
+        /**
+         * Binds NULL to a parameter.
+         */
+        virtual void bindNull(int place) = 0;
+
+        /**
+         * Executes the statement with the values bound.
+         *
+         * @return the records selected, valid until the statement is executed
+         *         again or dropped by its data provider.
+         *
+         * @exception DbSqlQueryExecFailure if unsuccessful execution.
+         */
+        const RecordSet &execute();
+
+        /**
+         * Executes the statement to read the selected rows with next(). The
+         * rows are not kept, the record set only gets the column headers.
+         * Reading stops when the statement is executed again.
+         *
+         * @exception DbSqlQueryExecFailure if unsuccessful execution.
+         */
+        virtual void query() = 0;
+
+        /**
+         * Moves to the next row selected by query().
+         *
+         * @return false once there are no more rows.
+         *
+         * @exception DbSqlQueryExecFailure if unsuccessful execution.
+         */
+        virtual bool next() = 0;
+
+        /**
+         * Gets the index of a column of the rows read, or -1.
+         */
+        int getColumn(const std::string &name) const
+        { return mRecordSet.getColumn(name); }
+
+        /**
+         * Gets the values of the current row. NULL values give 0 or an
+         * empty string.
+         */
+        virtual bool isNull(int col) const = 0;
+        int getInt(int col) const
+        { return (int) getInt64(col); }
+        virtual int64_t getInt64(int col) const = 0;
+        virtual double getDouble(int col) const = 0;
+        virtual std::string getString(int col) const = 0;
+
+        /**
+         * Returns the number of rows changed by the last execution.
+         */
+        unsigned getModifiedRows() const
+        { return mModifiedRows; }
+
+    protected:
+        std::string mSql;
+        RecordSet mRecordSet;    /**< Result of the last execution. */
+        unsigned mModifiedRows;
+
+    private:
+        Statement(const Statement &);
+        Statement &operator=(const Statement &);
+};
+
+} // namespace dal
+
+#endif // STATEMENT_H
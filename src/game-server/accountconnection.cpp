@@ -31,6 +31,7 @@
 #include "game-server/postman.h"
 #include "game-server/quest.h"
 #include "game-server/state.h"
+#include "game-server/tickprofiler.h"
 #include "net/messagein.h"
 #include "serialize/characterdata.h"
 #include "utils/logger.h"
@@ -45,7 +46,11 @@ const int SYNC_BUFFER_LIMIT = 20;
 
 AccountConnection::AccountConnection():
     mSyncBuffer(0),
-    mSyncMessages(0)
+    mSyncMessages(0),
+    mDeferSync(false),
+    mBinaryDoubles(false),
+    mCharacterChanges(false),
+    mRegistrations(0)
 {
 }
 
@@ -90,6 +95,7 @@ bool AccountConnection::start(int gameServerPort)
     msg.writeInt16(gameServerPort);
     msg.writeString(password);
     msg.writeInt32(itemManager->getDatabaseVersion());
+    msg.writeInt8(LINK_BINARY_DOUBLES | LINK_CHARACTER_CHANGES);
     const MapManager::Maps &m = MapManager::getMaps();
     for (MapManager::Maps::const_iterator i = m.begin(), i_end = m.end();
             i != i_end; ++i)
@@ -98,19 +104,42 @@ bool AccountConnection::start(int gameServerPort)
     }
     send(msg);
 
+    // Doubles are written as text until the account server accepts binary
+    mBinaryDoubles = false;
+    mCharacterChanges = false;
+
     // initialize sync buffer
     if (!mSyncBuffer)
         mSyncBuffer = new MessageOut(GAMSG_PLAYER_SYNC);
+    mSyncBuffer->setBinaryDoubles(false);
 
     return true;
 }
 
 void AccountConnection::sendCharacterData(Character *p)
 {
+    StoredCharacterData &stored = p->getStoredData();
+    if (mCharacterChanges && stored.registration == mRegistrations)
+    {
+        MessageOut msg(GAMSG_PLAYER_CHANGES);
+        msg.setBinaryDoubles(mBinaryDoubles);
+        msg.writeInt32(p->getDatabaseID());
+        serializeCharacterChanges(*p, stored, msg);
+        send(msg);
+        return;
+    }
+
     MessageOut msg(GAMSG_PLAYER_DATA);
+    msg.setBinaryDoubles(mBinaryDoubles);
     msg.writeInt32(p->getDatabaseID());
     serializeCharacterData(*p, msg);
     send(msg);
+
+    if (mCharacterChanges)
+    {
+        rememberCharacterData(*p, stored);
+        stored.registration = mRegistrations;
+    }
 }
 
 void AccountConnection::processMessage(MessageIn &msg)
@@ -141,6 +170,16 @@ void AccountConnection::processMessage(MessageIn &msg)
                 exit(EXIT_BAD_CONFIG_PARAMETER);
             }
 
+            // Each double says how it is encoded, so the values already
+            // in the sync buffer can stay as text
+            const int features = msg.readInt8();
+            mBinaryDoubles = features & LINK_BINARY_DOUBLES;
+            mSyncBuffer->setBinaryDoubles(mBinaryDoubles);
+
+            // Changes are only sent for what was stored since registering
+            mCharacterChanges = features & LINK_CHARACTER_CHANGES;
+            ++mRegistrations;
+
             // read world state variables
             while (msg.getUnreadLength())
             {
@@ -158,9 +197,18 @@ void AccountConnection::processMessage(MessageIn &msg)
         {
             std::string token = msg.readString(MAGIC_TOKEN_LENGTH);
             Character *ptr = new Character(msg);
+            ptr->getStoredData().registration = mRegistrations;
             gameHandler->addPendingCharacter(token, ptr);
         } break;
 
+        case AGMSG_PLAYER_DATA_REQUEST:
+        {
+            // Storing the data failed, so it is all sent the next time
+            int id = msg.readInt32();
+            if (Character *ch = gameHandler->getCharacterByDatabaseIdSlow(id))
+                ch->getStoredData().registration = 0;
+        } break;
+
         case AGMSG_ACTIVE_MAP:
         {
             int mapId = msg.readInt16();
@@ -340,9 +388,28 @@ void AccountConnection::banCharacter(Character *ch, int duration)
     send(msg);
 }
 
+/**
+ * Writes the median, 99th percentile and maximum of times in microseconds.
+ */
+static void writeTimes(MessageOut &msg, const utils::Histogram &times)
+{
+    msg.writeInt32(times.getPercentile(50));
+    msg.writeInt32(times.getPercentile(99));
+    msg.writeInt32(times.getMax());
+}
+
 void AccountConnection::sendStatistics()
 {
     MessageOut msg(GAMSG_STATISTICS);
+
+    msg.writeInt8(TickProfiler::NB_PHASES);
+    for (int i = 0; i < TickProfiler::NB_PHASES; ++i)
+    {
+        TickProfiler::Phase phase = static_cast< TickProfiler::Phase >(i);
+        msg.writeString(TickProfiler::getPhaseName(phase));
+        writeTimes(msg, TickProfiler::getHistogram(phase));
+    }
+
     const MapManager::Maps &maps = MapManager::getMaps();
     for (MapManager::Maps::const_iterator i = maps.begin(),
          i_end = maps.end(); i != i_end; ++i)
@@ -379,6 +446,9 @@ void AccountConnection::sendStatistics()
         {
             msg.writeInt32(*j);
         }
+
+        writeTimes(msg, m->getTimes().update);
+        writeTimes(msg, m->getTimes().inform);
     }
     send(msg);
 }
@@ -423,7 +493,8 @@ void AccountConnection::changeAccountLevel(Character *c, int level)
 
 void AccountConnection::syncChanges(bool force)
 {
-    if (mSyncMessages == 0)
+    utils::MutexLocker lock(&mSyncMutex);
+    if (mSyncMessages == 0 || mDeferSync)
         return;
 
     // send buffer if:
@@ -442,6 +513,7 @@ void AccountConnection::syncChanges(bool force)
         delete mSyncBuffer;
 
         mSyncBuffer = new MessageOut(GAMSG_PLAYER_SYNC);
+        mSyncBuffer->setBinaryDoubles(mBinaryDoubles);
         mSyncMessages = 0;
     }
     else
@@ -453,43 +525,55 @@ void AccountConnection::syncChanges(bool force)
 void AccountConnection::updateCharacterPoints(int charId, int charPoints,
                                               int corrPoints)
 {
-    ++mSyncMessages;
-    mSyncBuffer->writeInt8(SYNC_CHARACTER_POINTS);
-    mSyncBuffer->writeInt32(charId);
-    mSyncBuffer->writeInt32(charPoints);
-    mSyncBuffer->writeInt32(corrPoints);
+    {
+        utils::MutexLocker lock(&mSyncMutex);
+        ++mSyncMessages;
+        mSyncBuffer->writeInt8(SYNC_CHARACTER_POINTS);
+        mSyncBuffer->writeInt32(charId);
+        mSyncBuffer->writeInt32(charPoints);
+        mSyncBuffer->writeInt32(corrPoints);
+    }
     syncChanges();
 }
 
 void AccountConnection::updateAttributes(int charId, int attrId, double base,
                               double mod)
 {
-    ++mSyncMessages;
-    mSyncBuffer->writeInt8(SYNC_CHARACTER_ATTRIBUTE);
-    mSyncBuffer->writeInt32(charId);
-    mSyncBuffer->writeInt32(attrId);
-    mSyncBuffer->writeDouble(base);
-    mSyncBuffer->writeDouble(mod);
+    {
+        utils::MutexLocker lock(&mSyncMutex);
+        ++mSyncMessages;
+        mSyncBuffer->writeInt8(SYNC_CHARACTER_ATTRIBUTE);
+        mSyncBuffer->writeInt32(charId);
+        mSyncBuffer->writeInt32(attrId);
+        mSyncBuffer->writeDouble(base);
+        mSyncBuffer->writeDouble(mod);
+    }
     syncChanges();
 }
 
 void AccountConnection::updateExperience(int charId, int skillId,
                                          int skillValue)
 {
-    ++mSyncMessages;
-    mSyncBuffer->writeInt8(SYNC_CHARACTER_SKILL);
-    mSyncBuffer->writeInt32(charId);
-    mSyncBuffer->writeInt8(skillId);
-    mSyncBuffer->writeInt32(skillValue);
+    {
+        utils::MutexLocker lock(&mSyncMutex);
+        ++mSyncMessages;
+        mSyncBuffer->writeInt8(SYNC_CHARACTER_SKILL);
+        mSyncBuffer->writeInt32(charId);
+        mSyncBuffer->writeInt8(skillId);
+        mSyncBuffer->writeInt32(skillValue);
+    }
     syncChanges();
 }
 
 void AccountConnection::updateOnlineStatus(int charId, bool online)
 {
-    ++mSyncMessages;
-    mSyncBuffer->writeInt8(SYNC_ONLINE_STATUS);
-    mSyncBuffer->writeInt32(charId);
-    mSyncBuffer->writeInt8(online ? 1 : 0);
+    {
+        utils::MutexLocker lock(&mSyncMutex);
+        ++mSyncMessages;
+        mSyncBuffer->writeInt8(SYNC_ONLINE_STATUS);
+        mSyncBuffer->writeInt32(charId);
+        mSyncBuffer->writeInt8(online ? 1 : 0);
+    }
     syncChanges();
 }
 
@@ -23,6 +23,7 @@
 
 #include "net/messageout.h"
 #include "net/connection.h"
+#include "utils/thread.h"
 
 class Character;
 class MapComposite;
@@ -43,7 +44,10 @@ class AccountConnection : public Connection
         bool start(int gameServerPort);
 
         /**
-         * Sends data of a given character.
+         * Sends data of a given character. Only what changed since it was
+         * last stored is sent, unless the account server may not have the
+         * stored data, i.e. before it accepted changes or after reconnecting
+         * to it.
          */
         void sendCharacterData(Character *);
 
@@ -120,6 +124,15 @@ class AccountConnection : public Connection
          */
         void syncChanges(bool force = false);
 
+        /**
+         * When enabled, the changes are only added to the sync buffer, and
+         * sent by the next call to syncChanges() once disabled. This allows
+         * the characters of different maps to be updated from several
+         * threads at once.
+         */
+        void setDeferSync(bool defer)
+        { mDeferSync = defer; }
+
         /**
          * Write a modification message about character points to the sync
          * buffer.
@@ -188,6 +201,11 @@ class AccountConnection : public Connection
     private:
         MessageOut* mSyncBuffer;     /**< Message buffer to store sync data. */
         int mSyncMessages;           /**< Number of messages in the sync buffer. */
+        utils::Mutex mSyncMutex;     /**< Guards the sync buffer. */
+        bool mDeferSync;
+        bool mBinaryDoubles;         /**< Accepted by the account server. */
+        bool mCharacterChanges;      /**< Accepted by the account server. */
+        unsigned mRegistrations;     /**< Times registered with the account server. */
 };
 
 extern AccountConnection *accountHandler;
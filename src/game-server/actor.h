@@ -52,6 +52,7 @@ class Actor : public Entity
             mMoveTime(0),
             mUpdateFlags(0),
             mPublicID(65535),
+            mZoneIndex(0),
             mSize(0),
             mWalkMask(0)
         {}
@@ -115,6 +116,16 @@ class Actor : public Entity
         bool isPublicIdValid() const
         { return (mPublicID > 0 && mPublicID != 65535); }
 
+        /**
+         * Gets the index of the map zone the actor is listed in. Since zones
+         * overlap, it can not be deduced from the position.
+         */
+        unsigned getZoneIndex() const
+        { return mZoneIndex; }
+
+        void setZoneIndex(unsigned index)
+        { mZoneIndex = index; }
+
         void setWalkMask(unsigned char mask)
         { mWalkMask = mask; }
 
@@ -145,6 +156,8 @@ class Actor : public Entity
         /** Actor ID sent to clients (unique with respect to the map). */
         unsigned short mPublicID;
 
+        unsigned mZoneIndex;        /**< Map zone the actor is listed in. */
+
         Point mPos;                 /**< Coordinates. */
         unsigned char mSize;        /**< Radius of bounding circle. */
 
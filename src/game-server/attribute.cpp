@@ -21,7 +21,9 @@
 #include "attribute.h"
 #include "game-server/being.h"
 #include "utils/logger.h"
+#include <algorithm>
 #include <cassert>
+#include <stdexcept>
 
 AttributeModifiersEffect::AttributeModifiersEffect(StackableType stackableType,
                                                    ModifierEffectType effectType) :
@@ -40,14 +42,7 @@ AttributeModifiersEffect::AttributeModifiersEffect(StackableType stackableType,
               << " and stackableType " << stackableType << ".");
 }
 
-AttributeModifiersEffect::~AttributeModifiersEffect()
-{
-    // ?
-    /*mStates.clear();*/
-    LOG_WARN("DELETION of attribute effect!");
-}
-
-bool AttributeModifiersEffect::add(unsigned short duration,
+bool AttributeModifiersEffect::add(int expiry,
                                    double value,
                                    double prevLayerValue,
                                    int level)
@@ -56,7 +51,7 @@ bool AttributeModifiersEffect::add(unsigned short duration,
               " with a previous layer value of " << prevLayerValue << ". "
               "Current mod at this layer: " << mMod << ".");
     bool ret = false;
-    mStates.push_back(new AttributeModifierState(duration, value, level));
+    mStates.push_back(AttributeModifierState(expiry, value, level));
     switch (mStackableType) {
     case Stackable:
         switch (mEffectType) {
@@ -127,10 +122,10 @@ bool AttributeModifiersEffect::add(unsigned short duration,
     return ret;
 }
 
-bool durationCompare(const AttributeModifierState *lhs,
-                     const AttributeModifierState *rhs)
+bool durationCompare(const AttributeModifierState &lhs,
+                     const AttributeModifierState &rhs)
 {
-    return lhs->mDuration < rhs->mDuration;
+    return lhs.mExpiry < rhs.mExpiry;
 }
 
 bool AttributeModifiersEffect::remove(double value, unsigned int id,
@@ -139,21 +134,20 @@ bool AttributeModifiersEffect::remove(double value, unsigned int id,
     /* We need to find and check this entry exists, and erase the entry
        from the list too. */
     if (!fullCheck)
-        mStates.sort(durationCompare); /* Search only through those with a duration of 0. */
+        std::stable_sort(mStates.begin(), mStates.end(), durationCompare); /* Search only through those with a duration of 0. */
     bool ret = false;
 
-    for (std::list< AttributeModifierState * >::iterator it = mStates.begin();
-         it != mStates.end() && (fullCheck || !(*it)->mDuration);)
+    for (States::iterator it = mStates.begin();
+         it != mStates.end() && (fullCheck || !it->mExpiry);)
     {
         /* Check for a match */
-        if ((*it)->mValue != value || (*it)->mId != id)
+        if (it->mValue != value || it->mId != id)
         {
             ++it;
             continue;
         }
 
-        delete *it;
-        mStates.erase(it++);
+        it = mStates.erase(it);
 
         /* If this is stackable, we need to update for every modifier affected */
         if (mStackableType == Stackable)
@@ -188,12 +182,11 @@ void AttributeModifiersEffect::updateMod(double value)
             else
             {
                 mMod = 1;
-                for (std::list< AttributeModifierState * >::const_iterator
-                     it = mStates.begin(),
+                for (States::const_iterator it = mStates.begin(),
                      it_end = mStates.end();
                     it != it_end;
                     ++it)
-                    mMod *= (*it)->mValue;
+                    mMod *= it->mValue;
             }
         }
         else LOG_ERROR("Attribute modifiers effect: unhandled type '"
@@ -204,13 +197,12 @@ void AttributeModifiersEffect::updateMod(double value)
         if (mMod == value)
         {
             mMod = 0;
-            for (std::list< AttributeModifierState * >::const_iterator
-                 it = mStates.begin(),
+            for (States::const_iterator it = mStates.begin(),
                  it_end = mStates.end();
                 it != it_end;
                 ++it)
-                if ((*it)->mValue > mMod)
-                    mMod = (*it)->mValue;
+                if (it->mValue > mMod)
+                    mMod = it->mValue;
         }
     }
     else
@@ -248,27 +240,28 @@ bool AttributeModifiersEffect::recalculateModifiedValue(double newPrevLayerValue
 }
 
 
-bool Attribute::add(unsigned short duration, double value,
+bool Attribute::add(int expiry, double value,
                     unsigned int layer, int level)
 {
     assert(mMods.size() > layer);
-    LOG_DEBUG("Adding modifier to attribute with duration " << duration <<
+    LOG_DEBUG("Adding modifier to attribute with expiry " << expiry <<
               ", value " << value << ", at layer " << layer << " with id "
               << level);
-    if (mMods.at(layer)->add(duration, value,
-                            (layer ? mMods.at(layer - 1)->getCachedModifiedValue()
-                                   : mBase)
-                            , level))
+    if (mMods[layer].add(expiry, value,
+                         (layer ? mMods[layer - 1].getCachedModifiedValue()
+                                : mBase)
+                         , level))
     {
         while (++layer < mMods.size())
         {
-            if (!mMods.at(layer)->recalculateModifiedValue(
-                       mMods.at(layer - 1)->getCachedModifiedValue()))
+            if (!mMods[layer].recalculateModifiedValue(
+                       mMods[layer - 1].getCachedModifiedValue()))
             {
                 LOG_DEBUG("Modifier added, but modified value not changed.");
                 return false;
             }
         }
+        updateModifiedValue();
         LOG_DEBUG("Modifier added. Base value: " << mBase << ", new modified "
                   "value: " << getModifiedAttribute() << ".");
         return true;
@@ -281,37 +274,52 @@ bool Attribute::remove(double value, unsigned int layer,
                        int lvl, bool fullcheck)
 {
     assert(mMods.size() > layer);
-    if (mMods.at(layer)->remove(value, lvl, fullcheck))
+    if (mMods[layer].remove(value, lvl, fullcheck))
     {
         while (++layer < mMods.size())
-           if (!mMods.at(layer)->recalculateModifiedValue(
-                         mMods.at(layer - 1)->getCachedModifiedValue()))
+           if (!mMods[layer].recalculateModifiedValue(
+                         mMods[layer - 1].getCachedModifiedValue()))
                return false;
+        updateModifiedValue();
         return true;
     }
     return false;
 }
 
-bool AttributeModifiersEffect::tick()
+bool AttributeModifiersEffect::expire(int tick)
 {
     bool ret = false;
-    std::list<AttributeModifierState *>::iterator it = mStates.begin();
+    States::iterator it = mStates.begin();
     while (it != mStates.end())
     {
-        if ((*it)->tick())
+        if (it->isExpired(tick))
         {
-            double value = (*it)->mValue;
+            double value = it->mValue;
             LOG_DEBUG("Modifier of value " << value << " expiring!");
-            delete *it;
-            mStates.erase(it++);
+            it = mStates.erase(it);
             updateMod(value);
             ret = true;
         }
-        ++it;
+        else
+        {
+            ++it;
+        }
     }
     return ret;
 }
 
+int AttributeModifiersEffect::getNextExpiry() const
+{
+    int next = 0;
+    for (States::const_iterator it = mStates.begin(),
+         it_end = mStates.end(); it != it_end; ++it)
+    {
+        if (it->mExpiry && (!next || it->mExpiry < next))
+            next = it->mExpiry;
+    }
+    return next;
+}
+
 Attribute::Attribute(const AttributeManager::AttributeInfo &info):
     mBase(0),
     mMinValue(info.minimum),
@@ -325,48 +333,54 @@ Attribute::Attribute(const AttributeManager::AttributeInfo &info):
         LOG_DEBUG("Adding layer with stackable type "
                   << modifiers[i].stackableType
                   << " and effect type " << modifiers[i].effectType << ".");
-        mMods.push_back(new AttributeModifiersEffect(modifiers[i].stackableType,
-                                                     modifiers[i].effectType));
+        mMods.push_back(AttributeModifiersEffect(modifiers[i].stackableType,
+                                                 modifiers[i].effectType));
         LOG_DEBUG("Layer added.");
     }
     mBase = checkBounds(mBase);
+    updateModifiedValue();
 }
 
-Attribute::~Attribute()
-{
-//    for (std::vector<AttributeModifiersEffect *>::iterator it = mMods.begin(),
-//         it_end = mMods.end(); it != it_end; ++it)
-//    {
-        // ?
-        //delete *it;
-//    }
-}
-
-bool Attribute::tick()
+bool Attribute::expire(int tick)
 {
     bool ret = false;
     double prev = mBase;
-    for (std::vector<AttributeModifiersEffect *>::iterator it = mMods.begin(),
+    for (Layers::iterator it = mMods.begin(),
         it_end = mMods.end(); it != it_end; ++it)
     {
-        if ((*it)->tick())
+        if (it->expire(tick))
         {
             LOG_DEBUG("Attribute layer " << mMods.begin() - it
                       << " has expiring modifiers.");
             ret = true;
         }
         if (ret)
-            if (!(*it)->recalculateModifiedValue(prev)) ret = false;
-        prev = (*it)->getCachedModifiedValue();
+            if (!it->recalculateModifiedValue(prev)) ret = false;
+        prev = it->getCachedModifiedValue();
     }
+    updateModifiedValue();
     return ret;
 }
 
+int Attribute::getNextExpiry() const
+{
+    int next = 0;
+    for (Layers::const_iterator it = mMods.begin(),
+         it_end = mMods.end(); it != it_end; ++it)
+    {
+        const int expiry = it->getNextExpiry();
+        if (expiry && (!next || expiry < next))
+            next = expiry;
+    }
+    return next;
+}
+
 void Attribute::clearMods()
 {
-    for (std::vector<AttributeModifiersEffect *>::iterator it = mMods.begin(),
+    for (Layers::iterator it = mMods.begin(),
          it_end = mMods.end(); it != it_end; ++it)
-        (*it)->clearMods(mBase);
+        it->clearMods(mBase);
+    updateModifiedValue();
 }
 
 void Attribute::setBase(double base)
@@ -375,14 +389,15 @@ void Attribute::setBase(double base)
     LOG_DEBUG("Setting base attribute from " << mBase << " to " << base << ".");
     double prev = mBase = base;
 
-    std::vector<AttributeModifiersEffect *>::iterator it = mMods.begin();
+    Layers::iterator it = mMods.begin();
     while (it != mMods.end())
     {
-        if ((*it)->recalculateModifiedValue(prev))
-            prev = (*it++)->getCachedModifiedValue();
+        if (it->recalculateModifiedValue(prev))
+            prev = (it++)->getCachedModifiedValue();
         else
             break;
     }
+    updateModifiedValue();
 }
 
 void AttributeModifiersEffect::clearMods(double baseValue)
@@ -401,3 +416,51 @@ double Attribute::checkBounds(double baseValue)
         baseValue = mMinValue;
     return baseValue;
 }
+
+Attribute &AttributeMap::at(unsigned int id)
+{
+    const int position = getPosition(id);
+    if (position < 0)
+        throw std::out_of_range("AttributeMap::at");
+    return mAttributes[position].second;
+}
+
+const Attribute &AttributeMap::at(unsigned int id) const
+{
+    const int position = getPosition(id);
+    if (position < 0)
+        throw std::out_of_range("AttributeMap::at");
+    return mAttributes[position].second;
+}
+
+void AttributeMap::insert(const value_type &attribute)
+{
+    const int index = attributeManager->getIndex(attribute.first);
+    if (index < 0)
+    {
+        LOG_WARN("Attribute map: attribute '" << attribute.first
+                 << "' is unknown and will be ignored.");
+        return;
+    }
+    if (count(attribute.first))
+        return;
+
+    // Make room for every attribute at once, to spare reallocations
+    if (mAttributes.empty())
+        mAttributes.reserve(attributeManager->getAttributeCount());
+
+    if (mPositions.empty())
+        mPositions.assign(attributeManager->getAttributeCount(), -1);
+
+    // Keep the order of the ids. Attributes are usually inserted in that
+    // order, so that there is seldom any position after it to shift.
+    std::vector<value_type>::iterator it = mAttributes.end();
+    while (it != mAttributes.begin() && (it - 1)->first > attribute.first)
+        --it;
+    const unsigned int position = it - mAttributes.begin();
+    mAttributes.insert(it, attribute);
+
+    mPositions[index] = position;
+    for (unsigned int i = position + 1; i < mAttributes.size(); ++i)
+        ++mPositions[attributeManager->getIndex(mAttributes[i].first)];
+}
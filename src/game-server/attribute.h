@@ -23,34 +23,35 @@
 
 #include "common/defines.h"
 #include "attributemanager.h"
+#include "utils/smallvector.h"
 #include <vector>
-#include <list>
 
 class AttributeModifierState
 {
     public:
-        AttributeModifierState(unsigned short duration,
+        AttributeModifierState(int expiry,
                                double value,
                                unsigned int id)
-            : mDuration(duration)
+            : mExpiry(expiry)
             , mValue(value)
             , mId(id)
         {}
 
-        bool tick() { return mDuration ? !--mDuration : false; }
+        bool isExpired(int tick) const
+        { return mExpiry && mExpiry <= tick; }
 
     private:
-        /** Number of ticks (0 means permanent, e.g. equipment). */
-        unsigned short mDuration;
-        const double mValue;   /**< Positive or negative amount. */
+        /** Tick at which it expires (0 means permanent, e.g. equipment). */
+        int mExpiry;
+        double mValue;   /**< Positive or negative amount. */
         /**
          * Special purpose variable used to identify this effect to
          * dispells or similar. Exact usage depends on the effect,
          * origin, etc.
          */
-        const unsigned int mId;
-        friend bool durationCompare(const AttributeModifierState*,
-                                    const AttributeModifierState*);
+        unsigned int mId;
+        friend bool durationCompare(const AttributeModifierState &,
+                                    const AttributeModifierState &);
         friend class AttributeModifiersEffect;
 };
 
@@ -59,7 +60,6 @@ class AttributeModifiersEffect
     public:
         AttributeModifiersEffect(StackableType stackableType,
                                  ModifierEffectType effectType);
-        ~AttributeModifiersEffect();
 
         /**
          * Recalculates the value for this level.
@@ -69,7 +69,7 @@ class AttributeModifiersEffect
          * If this returns true, the cached values for *all* modifiers of a
          *     higher level must be recalculated, as well as the final
          */
-        bool add(unsigned short duration, double value,
+        bool add(int expiry, double value,
                  double prevLayerValue, int level);
 
         /**
@@ -98,7 +98,16 @@ class AttributeModifiersEffect
 
         double getCachedModifiedValue() const { return mCacheVal; }
 
-        bool tick();
+        /**
+         * Removes the modifiers that expire by the given tick.
+         * @returns Whether any was removed.
+         */
+        bool expire(int tick);
+
+        /**
+         * Gets the tick at which the next modifier expires, or 0 if none do.
+         */
+        int getNextExpiry() const;
 
         /**
          * clearMods() - removes all modifications present in this layer.
@@ -109,8 +118,14 @@ class AttributeModifiersEffect
         void clearMods(double baseValue);
 
     private:
-        /** List of all modifications present at this level */
-        std::list<AttributeModifierState *> mStates;
+        /**
+         * Layers seldom hold more than a couple of modifiers at once, which
+         * are then kept in place.
+         */
+        typedef utils::SmallVector<AttributeModifierState, 2> States;
+
+        /** All modifications present at this level. */
+        States mStates;
         /**
          * Stores the value that results from mStates. This takes into
          * account all previous layers.
@@ -121,8 +136,8 @@ class AttributeModifiersEffect
          * 0 for additive modifiers and 1 for multiplicative modifiers.
          */
         double mMod;
-        const StackableType mStackableType;
-        const ModifierEffectType mEffectType;
+        StackableType mStackableType;
+        ModifierEffectType mEffectType;
 };
 
 /**
@@ -136,14 +151,11 @@ class Attribute
 
         Attribute(const AttributeManager::AttributeInfo &info);
 
-        ~Attribute();
-
         void setBase(double base);
         double getBase() const { return mBase; }
 
         double getModifiedAttribute() const
-        { return mMods.empty() ? mBase :
-                                 (*mMods.rbegin())->getCachedModifiedValue(); }
+        { return mModifiedValue; }
 
         /*
          * add() and remove() are the standard functions used to add and
@@ -151,8 +163,7 @@ class Attribute
          */
 
         /**
-         * @param duration The amount of time before the modifier expires
-         *        naturally.
+         * @param expiry The tick at which the modifier expires naturally.
          *        When set to 0, the effect does not expire.
          * @param value The value to be applied as the modifier.
          * @param layer The id of the layer with which this modifier is to be
@@ -160,7 +171,7 @@ class Attribute
          * @param id Used to identify this effect.
          * @return Whether the modified attribute value was changed.
          */
-        bool add(unsigned short duration, double value, unsigned int layer, int id = 0);
+        bool add(int expiry, double value, unsigned int layer, int id = 0);
 
         /**
          * @param value The value of the modifier to be removed.
@@ -182,21 +193,99 @@ class Attribute
         void clearMods();
 
         /**
-         * tick() processes all timers associated with modifiers for this attribute.
+         * expire() removes the modifiers of this attribute that expire by the
+         * given tick.
+         * @returns Whether the modified attribute value was changed.
          */
-        bool tick();
+        bool expire(int tick);
+
+        /**
+         * Gets the tick at which the next modifier of this attribute
+         * expires, or 0 if none do.
+         */
+        int getNextExpiry() const;
 
     private:
+        /** Attributes seldom have more layers, which are then kept in place. */
+        typedef utils::SmallVector<AttributeModifiersEffect, 3> Layers;
+
         /**
          * Checks the min and max permitted values for the given base value
          * and return the adjusted value.
          */
         double checkBounds(double baseValue);
 
+        /**
+         * Caches the value resulting from the modifier layers.
+         */
+        void updateModifiedValue()
+        { mModifiedValue = mMods.empty() ? mBase :
+                                           mMods.back().getCachedModifiedValue(); }
+
         double mBase; // The attribute base value
+        double mModifiedValue; // The value after applying the modifiers
         double mMinValue; // The min authorized base and derived attribute value
         double mMaxValue; // The max authorized base and derived attribute value
-        std::vector<AttributeModifiersEffect *> mMods;
+        Layers mMods;
+};
+
+/**
+ * The attributes of a being, stored contiguously in the order of their ids.
+ * They are found through the dense indices given by the attribute manager,
+ * without searching.
+ */
+class AttributeMap
+{
+    public:
+        typedef std::pair<unsigned int, Attribute> value_type;
+        typedef std::vector<value_type>::iterator iterator;
+        typedef std::vector<value_type>::const_iterator const_iterator;
+
+        iterator begin() { return mAttributes.begin(); }
+        iterator end() { return mAttributes.end(); }
+        const_iterator begin() const { return mAttributes.begin(); }
+        const_iterator end() const { return mAttributes.end(); }
+
+        size_t size() const { return mAttributes.size(); }
+
+        size_t count(unsigned int id) const
+        { return getPosition(id) >= 0; }
+
+        iterator find(unsigned int id)
+        {
+            const int position = getPosition(id);
+            return position < 0 ? end() : begin() + position;
+        }
+
+        const_iterator find(unsigned int id) const
+        {
+            const int position = getPosition(id);
+            return position < 0 ? end() : begin() + position;
+        }
+
+        /**
+         * Gets an attribute.
+         * @exception std::out_of_range if the attribute does not exist.
+         */
+        Attribute &at(unsigned int id);
+        const Attribute &at(unsigned int id) const;
+
+        /**
+         * Adds an attribute, unless one of the same id exists.
+         */
+        void insert(const value_type &attribute);
+
+    private:
+        int getPosition(unsigned int id) const
+        {
+            const int index = attributeManager->getIndex(id);
+            if (index < 0 || (unsigned) index >= mPositions.size())
+                return -1;
+            return mPositions[index];
+        }
+
+        std::vector<value_type> mAttributes;
+        std::vector<int> mPositions; /**< By dense index, -1 if absent. */
 };
 
 #endif // ATTRIBUTE_H
@@ -38,6 +38,17 @@ void AttributeManager::reload()
 
     readAttributesFile();
 
+    // Number the attributes in the order of their ids
+    mIndexes.clear();
+    if (!mAttributeMap.empty())
+        mIndexes.resize(mAttributeMap.rbegin()->first + 1, -1);
+    int index = 0;
+    for (AttributeMap::const_iterator i = mAttributeMap.begin(),
+         i_end = mAttributeMap.end(); i != i_end; ++i)
+    {
+        mIndexes[i->first] = index++;
+    }
+
     LOG_DEBUG("attribute map:");
     LOG_DEBUG("Stackable is " << Stackable << ", NonStackable is " << NonStackable
               << ", NonStackableBonus is " << NonStackableBonus << ".");
@@ -128,6 +128,16 @@ class AttributeManager
 
         bool isAttributeDirectlyModifiable(int id) const;
 
+        /**
+         * Gets the dense index given to an attribute when loading, by which
+         * beings store it, or -1 if it does not exist.
+         */
+        int getIndex(unsigned int id) const
+        { return id < mIndexes.size() ? mIndexes[id] : -1; }
+
+        unsigned int getAttributeCount() const
+        { return mAttributeMap.size(); }
+
         ModifierLocation getLocation(const std::string &tag) const;
 
         const std::string *getTag(const ModifierLocation &location) const;
@@ -145,6 +155,7 @@ class AttributeManager
 
         AttributeScope mAttributeScopes[MaxScope];
         AttributeMap mAttributeMap;
+        std::vector<int> mIndexes; /**< Dense index of each attribute id. */
         TagMap mTagMap;
 
         const std::string mAttributeReferenceFile;
@@ -18,6 +18,7 @@
  *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 
 #include "game-server/being.h"
@@ -30,17 +31,28 @@
 #include "game-server/eventlistener.h"
 #include "game-server/mapcomposite.h"
 #include "game-server/effect.h"
+#include "game-server/pathservice.h"
+#include "game-server/state.h"
 #include "game-server/statuseffect.h"
 #include "game-server/statusmanager.h"
 #include "utils/logger.h"
 #include "utils/speedconv.h"
 
+static Configuration::Option< int > hpRegenBreakAfterHit(
+        "game_hpRegenBreakAfterHit", 0);
+
 Being::Being(EntityType type):
     Actor(type),
     mAction(STAND),
     mTarget(NULL),
     mGender(GENDER_UNSPECIFIED),
-    mDirection(DOWN)
+    mDirection(DOWN),
+    mPathRequest(0),
+    mPathFound(false),
+    mTimingWheel(0),
+    mModifierTimer(this),
+    mStatusTimer(this),
+    mRegenerationTimer(this)
 {
     const AttributeManager::AttributeScope &attr = attributeManager->getAttributeScope(BeingScope);
     LOG_DEBUG("Being creation: initialisation of " << attr.size() << " attributes.");
@@ -69,6 +81,12 @@ Being::Being(EntityType type):
 #endif
 }
 
+Being::~Being()
+{
+    if (mPathRequest)
+        PathService::cancel(this);
+}
+
 int Being::damage(Actor * /* source */, const Damage &damage)
 {
     if (mAction == DEAD)
@@ -126,8 +144,14 @@ int Being::damage(Actor * /* source */, const Damage &damage)
                   << mAttributes.at(ATTR_MAX_HP).getModifiedAttribute());
         setAttribute(ATTR_HP, HP.getBase() - HPloss);
         // No HP regen after being hit if this is set.
-        mHealthRegenerationTimeout.setSoft(
-                    Configuration::getValue("game_hpRegenBreakAfterHit", 0));
+        if (hpRegenBreakAfterHit)
+        {
+            const int tick = GameState::getCurrentTick()
+                             + hpRegenBreakAfterHit;
+            if (!mRegenerationTimer.isScheduled()
+                || mRegenerationTimer.getTick() < tick)
+                schedule(mRegenerationTimer, tick);
+        }
     }
     else
     {
@@ -190,6 +214,8 @@ void Being::setDestination(const Point &dst)
     mDst = dst;
     raiseUpdateFlags(UPDATEFLAG_NEW_DESTINATION);
     mPath.clear();
+    mPathRequest = 0;
+    mPathFound = false;
 }
 
 Path Being::findPath()
@@ -204,6 +230,30 @@ Path Being::findPath()
     return map->findPath(startX, startY, destX, destY, getWalkMask());
 }
 
+bool Being::pathFound(unsigned request, const Map *map,
+                      const Point &start, const Path &path)
+{
+    if (!isWaitingForPath(request))
+        return false;
+
+    mPathRequest = 0;
+
+    // The being may have been moved to another place in the meantime, in
+    // which case it will ask again.
+    const MapComposite *composite = getMap();
+    if (!composite || composite->getMap() != map)
+        return false;
+
+    const Point tile(getPosition().x / map->getTileWidth(),
+                     getPosition().y / map->getTileHeight());
+    if (tile != start)
+        return false;
+
+    mPath = path;
+    mPathFound = true;
+    return true;
+}
+
 void Being::updateDirection(const Point &currentPos, const Point &destPos)
 {
     // We update the being direction on each tile to permit other beings
@@ -343,16 +393,30 @@ void Being::move()
         if (!map->getWalk(pathIterator->x, pathIterator->y, getWalkMask()))
         {
             mPath.clear();
+            mPathFound = false;
             break;
         }
     }
 
-    if (mPath.empty())
+    if (mPath.empty() && !mPathFound)
     {
         // No path exists: the walkability of cached path has changed, the
         // destination has changed, or a path was never set.
+        if (PathService::isEnabled())
+        {
+            // The path is searched at the start of the next tick
+            if (!mPathRequest)
+            {
+                mPathRequest = PathService::request(this,
+                                                    Point(tileSX, tileSY),
+                                                    Point(tileDX, tileDY));
+            }
+            return;
+        }
+
         mPath = findPath();
     }
+    mPathFound = false;
 
     if (mPath.empty())
     {
@@ -453,8 +517,11 @@ void Being::setAction(BeingAction action)
 void Being::applyModifier(unsigned int attr, double value, unsigned int layer,
                           unsigned int duration, unsigned int id)
 {
-    mAttributes.at(attr).add(duration, value, layer, id);
+    const int expiry = duration ? GameState::getCurrentTick() + duration : 0;
+    mAttributes.at(attr).add(expiry, value, layer, id);
     updateDerivedAttributes(attr);
+    if (expiry)
+        scheduleModifierExpiry();
 }
 
 bool Being::removeModifier(unsigned int attr, double value, unsigned int layer,
@@ -485,29 +552,10 @@ void Being::setAttribute(unsigned int id, double value)
     }
 }
 
-double Being::getAttribute(unsigned int id) const
-{
-    AttributeMap::const_iterator ret = mAttributes.find(id);
-    if (ret == mAttributes.end())
-    {
-        LOG_DEBUG("Being::getAttribute: Attribute "
-                  << id << " not found! Returning 0.");
-        return 0;
-    }
-    return ret->second.getBase();
-}
-
-
-double Being::getModifiedAttribute(unsigned int id) const
+double Being::getMissingAttribute(unsigned int id) const
 {
-    AttributeMap::const_iterator ret = mAttributes.find(id);
-    if (ret == mAttributes.end())
-    {
-        LOG_DEBUG("Being::getModifiedAttribute: Attribute "
-                  << id << " not found! Returning 0.");
-        return 0;
-    }
-    return ret->second.getModifiedAttribute();
+    LOG_DEBUG("Being: Attribute " << id << " not found! Returning 0.");
+    return 0;
 }
 
 void Being::setModAttribute(unsigned int, double)
@@ -576,6 +624,8 @@ void Being::updateDerivedAttributes(unsigned int attr)
         updateDerivedAttributes(ATTR_HP);
     case ATTR_HP:
         raiseUpdateFlags(UPDATEFLAG_HEALTHCHANGE);
+        // The hit points are capped and checked for death by update()
+        wake();
         break;
     case ATTR_MOVE_SPEED_TPS:
         if (getAttribute(attr) > 0.0f)
@@ -597,8 +647,10 @@ void Being::applyStatusEffect(int id, int timer)
     {
         Status newStatus;
         newStatus.status = statusEffect;
-        newStatus.time = timer;
+        newStatus.end = GameState::getCurrentTick() + timer;
         mStatus[id] = newStatus;
+        scheduleStatusExpiry();
+        wake();
     }
     else
     {
@@ -626,66 +678,141 @@ bool Being::hasStatusEffect(int id) const
 unsigned Being::getStatusEffectTime(int id) const
 {
     StatusEffects::const_iterator it = mStatus.find(id);
-    if (it != mStatus.end()) return it->second.time;
-    else return 0;
+    if (it == mStatus.end())
+        return 0;
+    const int remaining = it->second.end - GameState::getCurrentTick();
+    return remaining > 0 ? remaining : 0;
 }
 
 void Being::setStatusEffectTime(int id, int time)
 {
     StatusEffects::iterator it = mStatus.find(id);
-    if (it != mStatus.end()) it->second.time = time;
+    if (it != mStatus.end())
+    {
+        it->second.end = GameState::getCurrentTick() + time;
+        scheduleStatusExpiry();
+    }
 }
 
-void Being::update()
+void Being::schedule(TimingWheel::Timer &timer, int tick)
 {
-    int oldHP = getModifiedAttribute(ATTR_HP);
-    int newHP = oldHP;
-    int maxHP = getModifiedAttribute(ATTR_MAX_HP);
+    if (mTimingWheel)
+        mTimingWheel->schedule(&timer, tick);
+}
 
-    // Regenerate HP
-    if (mAction != DEAD && mHealthRegenerationTimeout.expired())
+void Being::expireModifiers()
+{
+    const int tick = GameState::getCurrentTick();
+    for (AttributeMap::iterator it = mAttributes.begin(),
+         it_end = mAttributes.end(); it != it_end; ++it)
     {
-        mHealthRegenerationTimeout.set(TICKS_PER_HP_REGENERATION);
-        newHP += getModifiedAttribute(ATTR_HP_REGEN);
+        if (it->second.expire(tick))
+            updateDerivedAttributes(it->first);
     }
-    // Cap HP at maximum
-    if (newHP > maxHP)
+    scheduleModifierExpiry();
+}
+
+void Being::scheduleModifierExpiry()
+{
+    int next = 0;
+    for (AttributeMap::const_iterator it = mAttributes.begin(),
+         it_end = mAttributes.end(); it != it_end; ++it)
     {
-        newHP = maxHP;
+        const int expiry = it->second.getNextExpiry();
+        if (expiry && (!next || expiry < next))
+            next = expiry;
+    }
+
+    if (next)
+        schedule(mModifierTimer, next);
+    else
+        mModifierTimer.cancel();
+}
+
+void Being::expireStatusEffects()
+{
+    const int tick = GameState::getCurrentTick();
+    StatusEffects::iterator it = mStatus.begin();
+    while (it != mStatus.end())
+    {
+        if (it->second.end <= tick)
+            mStatus.erase(it++);
+        else
+            ++it;
+    }
+    scheduleStatusExpiry();
+}
+
+void Being::scheduleStatusExpiry()
+{
+    if (mStatus.empty())
+    {
+        mStatusTimer.cancel();
+        return;
+    }
+
+    int next = mStatus.begin()->second.end;
+    for (StatusEffects::const_iterator it = mStatus.begin(),
+         it_end = mStatus.end(); it != it_end; ++it)
+    {
+        if (it->second.end < next)
+            next = it->second.end;
     }
+    schedule(mStatusTimer, next);
+}
+
+void Being::regenerate()
+{
+    schedule(mRegenerationTimer,
+             GameState::getCurrentTick() + TICKS_PER_HP_REGENERATION);
+
+    if (mAction == DEAD)
+        return;
+
+    const int oldHP = getModifiedAttribute(ATTR_HP);
+    const int maxHP = getModifiedAttribute(ATTR_MAX_HP);
+    int newHP = oldHP;
+    newHP += getModifiedAttribute(ATTR_HP_REGEN);
+    if (newHP > maxHP)
+        newHP = maxHP;
+
     // Only update HP when it actually changed to avoid network noise
     if (newHP != oldHP)
     {
         setAttribute(ATTR_HP, newHP);
         raiseUpdateFlags(UPDATEFLAG_HEALTHCHANGE);
     }
+}
 
-    // Update lifetime of effects.
-    for (AttributeMap::iterator it = mAttributes.begin();
-         it != mAttributes.end();
-         ++it)
+void Being::update()
+{
+    // Cap HP at maximum
+    const int oldHP = getModifiedAttribute(ATTR_HP);
+    const int maxHP = getModifiedAttribute(ATTR_MAX_HP);
+    if (oldHP > maxHP)
     {
-        if (it->second.tick())
-            updateDerivedAttributes(it->first);
+        setAttribute(ATTR_HP, maxHP);
+        raiseUpdateFlags(UPDATEFLAG_HEALTHCHANGE);
     }
 
-    // Update and run status effects
-    StatusEffects::iterator it = mStatus.begin();
-    while (it != mStatus.end())
+    // Run status effects, their expiry is handled by mStatusTimer
+    if (!mStatus.empty())
     {
-        it->second.time--;
-        if (it->second.time > 0 && mAction != DEAD)
-            it->second.status->tick(this, it->second.time);
-
-        if (it->second.time <= 0 || mAction == DEAD)
+        if (mAction == DEAD)
         {
-            StatusEffects::iterator removeIt = it;
-            it++; // bring this iterator to the safety of the next element
-            mStatus.erase(removeIt);
+            mStatus.clear();
+            mStatusTimer.cancel();
         }
         else
         {
-            it++;
+            const int tick = GameState::getCurrentTick();
+            for (StatusEffects::iterator it = mStatus.begin(),
+                 it_end = mStatus.end(); it != it_end; ++it)
+            {
+                const int remaining = it->second.end - tick;
+                if (remaining > 0)
+                    it->second.status->tick(this, remaining);
+            }
         }
     }
 
@@ -701,6 +828,22 @@ void Being::inserted()
     // Reset the old position, since after insertion it is important that it is
     // in sync with the zone that we're currently present in.
     mOld = getPosition();
+
+    mTimingWheel = &getMap()->getTimingWheel();
+    scheduleModifierExpiry();
+    scheduleStatusExpiry();
+    schedule(mRegenerationTimer, std::max(mRegenerationTimer.getTick(),
+                                          GameState::getCurrentTick()));
+}
+
+void Being::removed()
+{
+    mModifierTimer.cancel();
+    mStatusTimer.cancel();
+    mRegenerationTimer.cancel();
+    mTimingWheel = 0;
+
+    Actor::removed();
 }
 
 void Being::setGender(BeingGender gender)
@@ -31,17 +31,16 @@
 #include "game-server/attribute.h"
 #include "game-server/autoattack.h"
 #include "game-server/timeout.h"
+#include "game-server/timingwheel.h"
 
 class Being;
 class MapComposite;
 class StatusEffect;
 
-typedef std::map< unsigned int, Attribute > AttributeMap;
-
 struct Status
 {
     StatusEffect *status;
-    unsigned time;  // Number of ticks
+    int end;        // Tick at which it ends
 };
 
 typedef std::map< int, Status > StatusEffects;
@@ -63,6 +62,8 @@ class Being : public Actor
          */
         Being(EntityType type);
 
+        ~Being();
+
         /**
          * Update being state.
          */
@@ -165,6 +166,21 @@ class Being : public Actor
          */
         virtual Path findPath();
 
+        /**
+         * Tells whether the being still waits for the path of a request made
+         * to the PathService.
+         */
+        bool isWaitingForPath(unsigned request) const
+        { return mPathRequest && request == mPathRequest; }
+
+        /**
+         * Gives the being the path found by the PathService for a request.
+         *
+         * @return whether the path was still needed.
+         */
+        bool pathFound(unsigned request, const Map *map,
+                       const Point &start, const Path &path);
+
         /** Gets the gender of the being (male or female). */
         BeingGender getGender() const
         { return mGender; }
@@ -180,12 +196,23 @@ class Being : public Actor
         /**
          * Gets an attribute.
          */
-        double getAttribute(unsigned int id) const;
+        double getAttribute(unsigned int id) const
+        {
+            AttributeMap::const_iterator it = mAttributes.find(id);
+            return it != mAttributes.end() ? it->second.getBase()
+                                           : getMissingAttribute(id);
+        }
 
         /**
          * Gets an attribute after applying modifiers.
          */
-        double getModifiedAttribute(unsigned int id) const;
+        double getModifiedAttribute(unsigned int id) const
+        {
+            AttributeMap::const_iterator it = mAttributes.find(id);
+            return it != mAttributes.end() ?
+                        it->second.getModifiedAttribute() :
+                        getMissingAttribute(id);
+        }
 
         /**
          * No-op to satisfy shared structure.
@@ -281,13 +308,24 @@ class Being : public Actor
         { mTarget = target; }
 
         /**
-         * Overridden in order to reset the old position upon insertion.
+         * Overridden in order to reset the old position and schedule the
+         * timers of the being upon insertion.
          */
         virtual void inserted();
 
+        /**
+         * Overridden in order to cancel the timers of the being.
+         */
+        virtual void removed();
+
     protected:
         static const int TICKS_PER_HP_REGENERATION = 100;
 
+        /**
+         * Schedules a timer on the wheel of the map, if the being is on one.
+         */
+        void schedule(TimingWheel::Timer &timer, int tick);
+
         BeingAction mAction;
         AttributeMap mAttributes;
         AutoAttacks mAutoAttacks;
@@ -301,6 +339,29 @@ class Being : public Actor
         Being(const Being &rhs);
         Being &operator=(const Being &rhs);
 
+        /**
+         * Logs the lookup of an attribute the being does not have.
+         * @return 0
+         */
+        double getMissingAttribute(unsigned int id) const;
+
+        /**
+         * Removes the modifiers that have expired, and waits for the next.
+         */
+        void expireModifiers();
+        void scheduleModifierExpiry();
+
+        /**
+         * Removes the status effects that have ended, and waits for the next.
+         */
+        void expireStatusEffects();
+        void scheduleStatusExpiry();
+
+        /**
+         * Regenerates hit points, every TICKS_PER_HP_REGENERATION ticks.
+         */
+        void regenerate();
+
         /**
          * Update the being direction when moving so avoid directions desyncs
          * with other clients.
@@ -310,12 +371,18 @@ class Being : public Actor
 
         Path mPath;
         BeingDirection mDirection;   /**< Facing direction. */
+        unsigned mPathRequest;       /**< Path waited for, if any. */
+        bool mPathFound;             /**< mPath came from the PathService. */
 
         std::string mName;
         Hits mHitsTaken; /**< List of punches taken since last update. */
 
+        /** Wheel of the map the being is inserted in, if any. */
+        TimingWheel *mTimingWheel;
+        MemberTimer< Being, &Being::expireModifiers > mModifierTimer;
+        MemberTimer< Being, &Being::expireStatusEffects > mStatusTimer;
         /** Time until hp is regenerated again */
-        Timeout mHealthRegenerationTimeout;
+        MemberTimer< Being, &Being::regenerate > mRegenerationTimer;
 };
 
 #endif // BEING_H
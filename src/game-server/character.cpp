@@ -76,6 +76,7 @@ Character::Character(MessageIn &msg):
     mClient(NULL),
     mConnected(true),
     mTransactionHandler(NULL),
+    mStoredData(new StoredCharacterData),
     mSpecialUpdateNeeded(false),
     mDatabaseID(-1),
     mHairStyle(0),
@@ -103,6 +104,7 @@ Character::Character(MessageIn &msg):
     mDatabaseID = msg.readInt32();
     setName(msg.readString());
     deserializeCharacterData(*this, msg);
+    rememberCharacterData(*this, *mStoredData);
     mOld = getPosition();
     Inventory(this).initialize();
     modifiedAllAttribute();
@@ -112,6 +114,7 @@ Character::Character(MessageIn &msg):
 Character::~Character()
 {
     delete mNpcThread;
+    delete mStoredData;
 }
 
 void Character::update()
@@ -157,10 +160,11 @@ void Character::update()
     }
 
     mStatusEffects.clear();
+    const int tick = GameState::getCurrentTick();
     StatusEffects::iterator it = mStatus.begin();
     while (it != mStatus.end())
     {
-        mStatusEffects[it->first] = it->second.time;
+        mStatusEffects[it->first] = it->second.end - tick;
         it++;
     }
 
@@ -242,7 +246,7 @@ void Character::respawn()
         return;
 
     // No script respawn callback set - fall back to hardcoded logic
-    mAttributes[ATTR_HP].setBase(mAttributes[ATTR_MAX_HP].getModifiedAttribute());
+    mAttributes.at(ATTR_HP).setBase(mAttributes.at(ATTR_MAX_HP).getModifiedAttribute());
     updateDerivedAttributes(ATTR_HP);
     // Warp back to spawn point.
     int spawnMap = Configuration::getValue("char_respawnMap", 1);
@@ -33,6 +33,7 @@
 #include "utils/logger.h"
 
 #include <map>
+#include <set>
 #include <string>
 #include <vector>
 
@@ -42,6 +43,7 @@ class MessageIn;
 class MessageOut;
 class Point;
 class Trade;
+struct StoredCharacterData;
 
 struct SpecialValue
 {
@@ -153,6 +155,13 @@ class Character : public Being
         void setClient(GameClient *c)
         { mClient = c; }
 
+        /**
+         * Gets the beings the client has been told about, including the
+         * character itself. Kept up to date by GameState.
+         */
+        std::set< Being * > &getVisibleBeings()
+        { return mVisibleBeings; }
+
         /**
          * Gets a reference to the possessions.
          */
@@ -165,6 +174,13 @@ class Character : public Being
         Possessions &getPossessions()
         { return mPossessions; }
 
+        /**
+         * Gets the data of the character as last stored by the account
+         * server, to send only what changed.
+         */
+        StoredCharacterData &getStoredData()
+        { return *mStoredData; }
+
         /**
          * Gets the Trade object the character is involved in.
          */
@@ -223,7 +239,10 @@ class Character : public Being
         int getParty() const
         { return mParty; }
 
-        /** Sets the party id of the character */
+        /**
+         * Sets the party id of the character.
+         * @note Use GameState::setParty for characters in the game world.
+         */
         void setParty(int party)
         { mParty = party; }
 
@@ -495,6 +514,10 @@ class Character : public Being
         void *mTransactionHandler;
 
         Possessions mPossessions;    /**< Possesssions of the character. */
+        StoredCharacterData *mStoredData;
+
+        /** Beings currently visible to the client. */
+        std::set< Being * > mVisibleBeings;
 
         /** Attributes modified since last update. */
         std::set<size_t> mModifiedAttributes;
@@ -534,6 +557,13 @@ class Character : public Being
         // Set as a friend, but still a lot of redundant accessors. FIXME.
         template< class T >
         friend void serializeCharacterData(const T &data, MessageOut &msg);
+        template< class T >
+        friend void rememberCharacterData(const T &data,
+                                          StoredCharacterData &stored);
+        template< class T >
+        friend void serializeCharacterChanges(const T &data,
+                                              StoredCharacterData &stored,
+                                              MessageOut &msg);
 };
 
 #endif // CHARACTER_H
@@ -0,0 +1,602 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/clustergraph.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+#include <limits.h>
+
+#include "game-server/map.h"
+
+// Costs of a step, matching those of the tile-level pathfinder
+static int const basicCost = 100;
+static int const straightCost = basicCost + 1;
+static int const diagonalCost = basicCost * 362 / 256;
+
+// Runs of border tiles at least this long get an entrance at both ends
+static int const longEntrance = 6;
+
+static int heuristic(const Point &from, int destX, int destY)
+{
+    int dx = std::abs(from.x - destX), dy = std::abs(from.y - destY);
+    return std::abs(dx - dy) * basicCost + std::min(dx, dy) * diagonalCost;
+}
+
+namespace {
+
+/**
+ * An entry of an open list, ordered by increasing cost.
+ */
+struct OpenEntry
+{
+    OpenEntry(int cost, unsigned key):
+        cost(cost), key(key)
+    {}
+
+    bool operator< (const OpenEntry &other) const
+    { return cost > other.cost; }
+
+    int cost;
+    unsigned key;
+};
+
+} // anonymous namespace
+
+ClusterGraph::ClusterGraph(const Map *map, int clusterSize):
+    mMap(map),
+    mClusterSize(clusterSize),
+    mClustersX((map->getWidth() + clusterSize - 1) / clusterSize),
+    mClustersY((map->getHeight() + clusterSize - 1) / clusterSize),
+    mClusters(mClustersX * mClustersY),
+    mSearch(0)
+{
+    for (int cy = 0; cy < mClustersY; ++cy)
+    {
+        for (int cx = 0; cx < mClustersX; ++cx)
+        {
+            Cluster &cluster = mClusters[cx + cy * mClustersX];
+            cluster.bounds.x = cx * clusterSize;
+            cluster.bounds.y = cy * clusterSize;
+            cluster.bounds.w = std::min(clusterSize,
+                                        map->getWidth() - cluster.bounds.x);
+            cluster.bounds.h = std::min(clusterSize,
+                                        map->getHeight() - cluster.bounds.y);
+        }
+    }
+
+    std::vector<unsigned> rebuilt(mClusters.size());
+    for (unsigned i = 0; i < mClusters.size(); ++i)
+    {
+        rebuild(mClusters[i]);
+        rebuilt[i] = i;
+    }
+    link(rebuilt);
+}
+
+void ClusterGraph::invalidateTile(int x, int y)
+{
+    if (!mMap->contains(x, y))
+        return;
+
+    utils::MutexLocker lock(&mMutex);
+
+    // Entrances depend on the tiles on both sides of a border, so a change
+    // on a border tile also affects the neighbouring cluster.
+    int candidates[3][2] = { { x, y }, { x, y }, { x, y } };
+    const int localX = x % mClusterSize, localY = y % mClusterSize;
+    if (localX == 0)
+        candidates[1][0] = x - 1;
+    else if (localX == mClusterSize - 1)
+        candidates[1][0] = x + 1;
+    if (localY == 0)
+        candidates[2][1] = y - 1;
+    else if (localY == mClusterSize - 1)
+        candidates[2][1] = y + 1;
+
+    for (int i = 0; i < 3; ++i)
+    {
+        if (!mMap->contains(candidates[i][0], candidates[i][1]))
+            continue;
+
+        unsigned index = clusterIndex(candidates[i][0], candidates[i][1]);
+        Cluster &cluster = mClusters[index];
+        if (!cluster.dirty)
+        {
+            cluster.dirty = true;
+            mDirtyClusters.push_back(index);
+        }
+    }
+}
+
+void ClusterGraph::update()
+{
+    if (mDirtyClusters.empty())
+        return;
+
+    for (std::vector<unsigned>::iterator i = mDirtyClusters.begin(),
+         i_end = mDirtyClusters.end(); i != i_end; ++i)
+    {
+        rebuild(mClusters[*i]);
+    }
+
+    link(mDirtyClusters);
+    mDirtyClusters.clear();
+}
+
+void ClusterGraph::rebuild(Cluster &cluster)
+{
+    const Rectangle &b = cluster.bounds;
+    cluster.nodes.clear();
+
+    if (b.x > 0)
+        addEntrances(cluster, b.x, b.y, 0, 1, b.h, -1, 0);
+    if (b.x + b.w < mMap->getWidth())
+        addEntrances(cluster, b.x + b.w - 1, b.y, 0, 1, b.h, 1, 0);
+    if (b.y > 0)
+        addEntrances(cluster, b.x, b.y, 1, 0, b.w, 0, -1);
+    if (b.y + b.h < mMap->getHeight())
+        addEntrances(cluster, b.x, b.y + b.h - 1, 1, 0, b.w, 0, 1);
+
+    std::vector<int> costs;
+    for (unsigned i = 0; i < cluster.nodes.size(); ++i)
+    {
+        Node &node = cluster.nodes[i];
+        expand(cluster, node.tile.x, node.tile.y, costs);
+
+        for (unsigned j = 0; j < cluster.nodes.size(); ++j)
+        {
+            const Point &tile = cluster.nodes[j].tile;
+            int cost = costs[(tile.x - b.x) + (tile.y - b.y) * b.w];
+            if (j != i && cost >= 0)
+                node.edges.push_back(Edge(j, cost));
+        }
+    }
+
+    cluster.dirty = false;
+}
+
+void ClusterGraph::link(const std::vector<unsigned> &rebuilt)
+{
+    const unsigned clusterCount = mClusters.size();
+    mFirstNode.resize(clusterCount);
+    mNodeCluster.clear();
+
+    for (unsigned c = 0; c < clusterCount; ++c)
+    {
+        mFirstNode[c] = mNodeCluster.size();
+        mNodeCluster.resize(mFirstNode[c] + mClusters[c].nodes.size(), c);
+    }
+
+    // Entrances are shared with the neighbouring clusters, the links of the
+    // other clusters still refer to the same nodes
+    std::vector<bool> relink(clusterCount, false);
+    for (std::vector<unsigned>::const_iterator i = rebuilt.begin(),
+         i_end = rebuilt.end(); i != i_end; ++i)
+    {
+        const unsigned c = *i;
+        const int cx = c % mClustersX, cy = c / mClustersX;
+        relink[c] = true;
+        if (cx > 0)
+            relink[c - 1] = true;
+        if (cx < mClustersX - 1)
+            relink[c + 1] = true;
+        if (cy > 0)
+            relink[c - mClustersX] = true;
+        if (cy < mClustersY - 1)
+            relink[c + mClustersX] = true;
+    }
+
+    const unsigned nodeCount = mNodeCluster.size();
+    for (unsigned c = 0; c < clusterCount; ++c)
+    {
+        if (!relink[c])
+            continue;
+
+        std::vector<Node> &nodes = mClusters[c].nodes;
+        for (std::vector<Node>::iterator i = nodes.begin(),
+             i_end = nodes.end(); i != i_end; ++i)
+        {
+            i->links.clear();
+            for (std::vector<Point>::iterator j = i->exits.begin(),
+                 j_end = i->exits.end(); j != j_end; ++j)
+            {
+                const unsigned other = clusterIndex(j->x, j->y);
+                const int index = findNode(mClusters[other], *j);
+                if (index >= 0)
+                    i->links.push_back(NodeRef(other, index));
+            }
+        }
+    }
+
+    // Flood the graph to find out which nodes can reach each other
+    static unsigned const none = UINT_MAX;
+    mComponents.assign(nodeCount, none);
+    std::vector<unsigned> pending;
+
+    for (unsigned n = 0; n < nodeCount; ++n)
+    {
+        if (mComponents[n] != none)
+            continue;
+
+        mComponents[n] = n;
+        pending.push_back(n);
+        while (!pending.empty())
+        {
+            const unsigned current = pending.back();
+            pending.pop_back();
+
+            const unsigned c = mNodeCluster[current];
+            const Node &node = mClusters[c].nodes[current - mFirstNode[c]];
+
+            for (std::vector<Edge>::const_iterator i = node.edges.begin(),
+                 i_end = node.edges.end(); i != i_end; ++i)
+            {
+                const unsigned next = mFirstNode[c] + i->node;
+                if (mComponents[next] == none)
+                {
+                    mComponents[next] = n;
+                    pending.push_back(next);
+                }
+            }
+
+            for (std::vector<NodeRef>::const_iterator i = node.links.begin(),
+                 i_end = node.links.end(); i != i_end; ++i)
+            {
+                const unsigned next = nodeKey(*i);
+                if (mComponents[next] == none)
+                {
+                    mComponents[next] = n;
+                    pending.push_back(next);
+                }
+            }
+        }
+    }
+
+    // Two more records for the start and the destination of a search
+    mRecords.resize(nodeCount + 2);
+}
+
+void ClusterGraph::addEntrances(Cluster &cluster, int x, int y, int dx, int dy,
+                                int length, int ox, int oy)
+{
+    int runStart = -1;
+    for (int i = 0; i <= length; ++i)
+    {
+        const int tileX = x + dx * i, tileY = y + dy * i;
+        const bool open = i < length &&
+                          mMap->getWalk(tileX, tileY) &&
+                          mMap->getWalk(tileX + ox, tileY + oy);
+
+        if (open)
+        {
+            if (runStart < 0)
+                runStart = i;
+            continue;
+        }
+
+        if (runStart < 0)
+            continue;
+
+        // Both clusters sharing the border place the same entrances, since
+        // they are derived from the same pairs of tiles.
+        const int runEnd = i - 1;
+        if (runEnd - runStart + 1 < longEntrance)
+        {
+            const int mid = (runStart + runEnd) / 2;
+            addEntrance(cluster, Point(x + dx * mid, y + dy * mid),
+                        Point(x + dx * mid + ox, y + dy * mid + oy));
+        }
+        else
+        {
+            addEntrance(cluster, Point(x + dx * runStart, y + dy * runStart),
+                        Point(x + dx * runStart + ox,
+                              y + dy * runStart + oy));
+            addEntrance(cluster, Point(x + dx * runEnd, y + dy * runEnd),
+                        Point(x + dx * runEnd + ox, y + dy * runEnd + oy));
+        }
+        runStart = -1;
+    }
+}
+
+void ClusterGraph::addEntrance(Cluster &cluster, const Point &tile,
+                               const Point &exit)
+{
+    int index = findNode(cluster, tile);
+    if (index < 0)
+    {
+        index = cluster.nodes.size();
+        cluster.nodes.push_back(Node());
+        cluster.nodes.back().tile = tile;
+    }
+    cluster.nodes[index].exits.push_back(exit);
+}
+
+int ClusterGraph::findNode(const Cluster &cluster, const Point &tile) const
+{
+    for (unsigned i = 0; i < cluster.nodes.size(); ++i)
+        if (cluster.nodes[i].tile == tile)
+            return i;
+    return -1;
+}
+
+void ClusterGraph::expand(const Cluster &cluster, int x, int y,
+                          std::vector<int> &costs)
+{
+    const Rectangle &b = cluster.bounds;
+    const unsigned size = b.w * b.h;
+
+    costs.assign(size, -1);
+    mClosed.assign(size, 0);
+
+    std::priority_queue<OpenEntry> openList;
+    costs[(x - b.x) + (y - b.y) * b.w] = 0;
+    openList.push(OpenEntry(0, (x - b.x) + (y - b.y) * b.w));
+
+    while (!openList.empty())
+    {
+        const OpenEntry curr = openList.top();
+        openList.pop();
+
+        if (mClosed[curr.key])
+            continue;
+        mClosed[curr.key] = 1;
+
+        const int currX = b.x + curr.key % b.w;
+        const int currY = b.y + curr.key / b.w;
+
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                const int nx = currX + dx, ny = currY + dy;
+                if ((dx == 0 && dy == 0) || !b.contains(Point(nx, ny)))
+                    continue;
+
+                const unsigned index = (nx - b.x) + (ny - b.y) * b.w;
+                if (mClosed[index] || !mMap->getWalk(nx, ny))
+                    continue;
+
+                if (dx != 0 && dy != 0 &&
+                    (!mMap->getWalk(currX, ny) || !mMap->getWalk(nx, currY)))
+                    continue;
+
+                const int cost = curr.cost +
+                    (dx == 0 || dy == 0 ? straightCost : diagonalCost);
+                if (costs[index] < 0 || cost < costs[index])
+                {
+                    costs[index] = cost;
+                    openList.push(OpenEntry(cost, index));
+                }
+            }
+        }
+    }
+}
+
+bool ClusterGraph::findRoute(int startX, int startY, int destX, int destY,
+                             int maxCost, std::vector<Waypoint> &route)
+{
+    utils::MutexLocker lock(&mMutex);
+
+    update();
+
+    const unsigned startCluster = clusterIndex(startX, startY);
+    const unsigned destCluster = clusterIndex(destX, destY);
+    const Cluster &start = mClusters[startCluster];
+    const Cluster &dest = mClusters[destCluster];
+
+    // Connect the start and the destination to the nodes of their clusters.
+    // Paths are symmetric, so the costs from the destination can be used.
+    std::vector<int> startCosts, destCosts;
+    expand(start, startX, startY, startCosts);
+    expand(dest, destX, destY, destCosts);
+
+    std::vector<OpenEntry> startEdges, destEdges;
+    for (unsigned i = 0; i < start.nodes.size(); ++i)
+    {
+        const Point &tile = start.nodes[i].tile;
+        const int cost = startCosts[(tile.x - start.bounds.x) +
+                                    (tile.y - start.bounds.y) *
+                                    start.bounds.w];
+        if (cost >= 0)
+            startEdges.push_back(OpenEntry(cost,
+                                           mFirstNode[startCluster] + i));
+    }
+    for (unsigned i = 0; i < dest.nodes.size(); ++i)
+    {
+        const Point &tile = dest.nodes[i].tile;
+        const int cost = destCosts[(tile.x - dest.bounds.x) +
+                                   (tile.y - dest.bounds.y) * dest.bounds.w];
+        if (cost >= 0)
+            destEdges.push_back(OpenEntry(cost, mFirstNode[destCluster] + i));
+    }
+
+    // Give up right away when the destination can not be reached
+    bool connected = false;
+    for (std::vector<OpenEntry>::iterator i = startEdges.begin(),
+         i_end = startEdges.end(); i != i_end && !connected; ++i)
+    {
+        for (std::vector<OpenEntry>::iterator j = destEdges.begin(),
+             j_end = destEdges.end(); j != j_end && !connected; ++j)
+        {
+            connected = mComponents[i->key] == mComponents[j->key];
+        }
+    }
+    if (!connected)
+        return false;
+
+    const unsigned startKey = mNodeCluster.size();
+    const unsigned goalKey = startKey + 1;
+
+    // Costs to reach the destination from the nodes of its cluster
+    std::vector<int> goalCosts(dest.nodes.size(), -1);
+    for (std::vector<OpenEntry>::iterator i = destEdges.begin(),
+         i_end = destEdges.end(); i != i_end; ++i)
+    {
+        goalCosts[i->key - mFirstNode[destCluster]] = i->cost;
+    }
+
+    if (++mSearch == 0)
+    {
+        // Wrapped around, forget about all earlier searches
+        for (unsigned i = 0; i < mRecords.size(); ++i)
+            mRecords[i].search = 0;
+        mSearch = 1;
+    }
+
+    const int costLimit = maxCost * basicCost;
+    std::priority_queue<OpenEntry> openList;
+    std::vector<OpenEntry> successors;
+
+    NodeRecord &startRecord = mRecords[startKey];
+    startRecord.search = mSearch;
+    startRecord.Gcost = 0;
+    startRecord.closed = false;
+    openList.push(OpenEntry(0, startKey));
+
+    bool found = false;
+    while (!openList.empty())
+    {
+        const unsigned key = openList.top().key;
+        openList.pop();
+
+        NodeRecord &current = mRecords[key];
+        if (current.closed)
+            continue;
+        current.closed = true;
+
+        if (key == goalKey)
+        {
+            found = true;
+            break;
+        }
+
+        // Gather the successors of the node with the cost to reach them
+        successors.clear();
+        if (key == startKey)
+        {
+            successors = startEdges;
+        }
+        else
+        {
+            const unsigned c = mNodeCluster[key];
+            const unsigned first = mFirstNode[c];
+            const Node &node = mClusters[c].nodes[key - first];
+
+            for (std::vector<Edge>::const_iterator i = node.edges.begin(),
+                 i_end = node.edges.end(); i != i_end; ++i)
+            {
+                successors.push_back(OpenEntry(i->cost, first + i->node));
+            }
+
+            for (std::vector<NodeRef>::const_iterator i = node.links.begin(),
+                 i_end = node.links.end(); i != i_end; ++i)
+            {
+                successors.push_back(OpenEntry(straightCost, nodeKey(*i)));
+            }
+
+            if (c == destCluster && goalCosts[key - first] >= 0)
+                successors.push_back(OpenEntry(goalCosts[key - first],
+                                               goalKey));
+        }
+
+        const int Gcost = current.Gcost;
+        for (std::vector<OpenEntry>::iterator i = successors.begin(),
+             i_end = successors.end(); i != i_end; ++i)
+        {
+            const int cost = Gcost + i->cost;
+            if (cost > costLimit)
+                continue;
+
+            NodeRecord &record = mRecords[i->key];
+            if (record.search != mSearch)
+            {
+                record.search = mSearch;
+                record.closed = false;
+            }
+            else if (record.closed || record.Gcost <= cost)
+            {
+                continue;
+            }
+
+            record.Gcost = cost;
+            record.parent = key;
+
+            int Hcost = 0;
+            if (i->key != goalKey)
+            {
+                const unsigned c = mNodeCluster[i->key];
+                const Point &tile =
+                        mClusters[c].nodes[i->key - mFirstNode[c]].tile;
+                Hcost = heuristic(tile, destX, destY);
+            }
+            openList.push(OpenEntry(cost + Hcost, i->key));
+        }
+    }
+
+    if (!found)
+        return false;
+
+    // Walk back from the destination, collecting the abstract nodes
+    std::vector<unsigned> keys;
+    for (unsigned key = goalKey; key != startKey; key = mRecords[key].parent)
+        keys.push_back(key);
+
+    route.clear();
+    Point previous(startX, startY);
+    unsigned previousCluster = startCluster;
+    for (std::vector<unsigned>::reverse_iterator i = keys.rbegin(),
+         i_end = keys.rend(); i != i_end; ++i)
+    {
+        Waypoint waypoint;
+        unsigned cluster;
+        if (*i == goalKey)
+        {
+            waypoint.tile = Point(destX, destY);
+            cluster = destCluster;
+        }
+        else
+        {
+            cluster = mNodeCluster[*i];
+            const unsigned index = *i - mFirstNode[cluster];
+            waypoint.tile = mClusters[cluster].nodes[index].tile;
+        }
+
+        if (cluster == previousCluster)
+        {
+            waypoint.bounds = mClusters[cluster].bounds;
+        }
+        else
+        {
+            // Crossing a border, a single step
+            waypoint.bounds.x = std::min(previous.x, waypoint.tile.x);
+            waypoint.bounds.y = std::min(previous.y, waypoint.tile.y);
+            waypoint.bounds.w = std::abs(previous.x - waypoint.tile.x) + 1;
+            waypoint.bounds.h = std::abs(previous.y - waypoint.tile.y) + 1;
+        }
+
+        route.push_back(waypoint);
+        previous = waypoint.tile;
+        previousCluster = cluster;
+    }
+
+    return true;
+}
@@ -0,0 +1,222 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CLUSTERGRAPH_H
+#define CLUSTERGRAPH_H
+
+#include <vector>
+
+#include "utils/point.h"
+#include "utils/thread.h"
+
+class Map;
+
+/**
+ * Abstract graph used for hierarchical pathfinding on the walls of a map.
+ *
+ * The map is divided into square clusters. Where two neighbouring clusters
+ * share walkable border tiles, entrance nodes are placed on both sides, and
+ * the nodes of each cluster are connected by the cost of the shortest path
+ * between them inside the cluster. Long paths are first searched on this
+ * graph, and the resulting route is then refined one cluster at a time.
+ *
+ * Only walls are taken into account. Changing the walls of a tile marks the
+ * clusters it borders as outdated; they are rebuilt on the next search.
+ */
+class ClusterGraph
+{
+    public:
+        /**
+         * A step of a route found on the abstract graph. The tile-level path
+         * to the target only needs to be searched inside the bounds.
+         */
+        struct Waypoint
+        {
+            Point tile;
+            Rectangle bounds;
+        };
+
+        ClusterGraph(const Map *map, int clusterSize);
+
+        /**
+         * Returns the size in tiles of the clusters.
+         */
+        int getClusterSize() const
+        { return mClusterSize; }
+
+        /**
+         * Tells whether both tiles are in the same cluster.
+         */
+        bool sameCluster(int x1, int y1, int x2, int y2) const
+        {
+            return x1 / mClusterSize == x2 / mClusterSize &&
+                   y1 / mClusterSize == y2 / mClusterSize;
+        }
+
+        /**
+         * Marks the clusters affected by a change of the walls on the given
+         * tile as outdated. Waits for a route being searched to be found.
+         */
+        void invalidateTile(int x, int y);
+
+        /**
+         * Searches a route between two tiles of different clusters on the
+         * abstract graph. Routes costing more than maxCost tiles are
+         * rejected. Only one route is searched at a time when several
+         * threads ask for one.
+         *
+         * @return whether a route was found.
+         */
+        bool findRoute(int startX, int startY, int destX, int destY,
+                       int maxCost, std::vector<Waypoint> &route);
+
+    private:
+        struct Edge
+        {
+            Edge(unsigned node, int cost):
+                node(node), cost(cost)
+            {}
+
+            unsigned node;          /**< Index of the node in its cluster */
+            int cost;
+        };
+
+        /**
+         * A node of another cluster. It stays valid until that cluster is
+         * rebuilt, which relinks the clusters around it.
+         */
+        struct NodeRef
+        {
+            NodeRef(unsigned cluster, unsigned node):
+                cluster(cluster), node(node)
+            {}
+
+            unsigned cluster;
+            unsigned node;          /**< Index of the node in its cluster */
+        };
+
+        struct Node
+        {
+            Point tile;
+            std::vector<Point> exits;   /**< Tiles across cluster borders */
+            std::vector<NodeRef> links; /**< Nodes on the exits */
+            std::vector<Edge> edges;    /**< Nodes of the same cluster */
+        };
+
+        /**
+         * Search state of a node.
+         */
+        struct NodeRecord
+        {
+            NodeRecord(): search(0) {}
+
+            unsigned search;        /**< Search the record belongs to */
+            int Gcost;
+            unsigned parent;
+            bool closed;
+        };
+
+        struct Cluster
+        {
+            Cluster(): dirty(true) {}
+
+            Rectangle bounds;
+            std::vector<Node> nodes;
+            bool dirty;
+        };
+
+        /**
+         * Gets the index of the cluster containing a tile.
+         */
+        unsigned clusterIndex(int x, int y) const
+        { return x / mClusterSize + (y / mClusterSize) * mClustersX; }
+
+        /**
+         * Gets the number of a node of the graph.
+         */
+        unsigned nodeKey(const NodeRef &ref) const
+        { return mFirstNode[ref.cluster] + ref.node; }
+
+        /**
+         * Rebuilds the outdated clusters and links them with the others.
+         */
+        void update();
+
+        /**
+         * Recomputes the entrances and internal edges of a cluster.
+         */
+        void rebuild(Cluster &cluster);
+
+        /**
+         * Numbers all nodes, connects the nodes on both sides of the
+         * entrances of the rebuilt clusters and finds the connected parts of
+         * the graph.
+         */
+        void link(const std::vector<unsigned> &rebuilt);
+
+        /**
+         * Adds the entrances on the border shared by the tiles starting at
+         * (x, y) inside the cluster and those at (x + ox, y + oy) outside of
+         * it. The border runs along (dx, dy) for the given length.
+         */
+        void addEntrances(Cluster &cluster, int x, int y, int dx, int dy,
+                          int length, int ox, int oy);
+
+        /**
+         * Adds an entrance node on a tile of a cluster, or an exit to the
+         * node already there.
+         */
+        void addEntrance(Cluster &cluster, const Point &tile,
+                         const Point &exit);
+
+        /**
+         * Computes the cost of reaching every tile of the cluster from the
+         * given tile, without leaving the cluster. Unreachable tiles are
+         * given a negative cost.
+         */
+        void expand(const Cluster &cluster, int x, int y,
+                    std::vector<int> &costs);
+
+        /**
+         * Gets the index of the node on the given tile of a cluster, or -1.
+         */
+        int findNode(const Cluster &cluster, const Point &tile) const;
+
+        const Map *mMap;
+        int mClusterSize;
+        int mClustersX, mClustersY;
+        std::vector<Cluster> mClusters;
+        std::vector<unsigned> mDirtyClusters;
+
+        // Nodes are numbered cluster by cluster
+        std::vector<unsigned> mFirstNode;       /**< Per cluster */
+        std::vector<unsigned> mNodeCluster;     /**< Per node */
+        std::vector<unsigned> mComponents;      /**< Per node */
+
+        std::vector<NodeRecord> mRecords;
+        unsigned mSearch;
+
+        // Scratch space of expand()
+        std::vector<unsigned char> mClosed;
+
+        utils::Mutex mMutex;        /**< Held while searching or changing */
+};
+
+#endif // CLUSTERGRAPH_H
@@ -23,10 +23,29 @@
 #include "game-server/mapcomposite.h"
 #include "game-server/state.h"
 
+static utils::ObjectPool effectPool(sizeof(Effect));
+
+void *Effect::operator new(size_t size)
+{
+    return effectPool.allocate(size);
+}
+
+void Effect::operator delete(void *object, size_t size)
+{
+    effectPool.release(object, size);
+}
+
+const utils::ObjectPool::Statistics &Effect::getPoolStatistics()
+{
+    return effectPool.getStatistics();
+}
+
 void Effect::update()
 {
     if (mHasBeenShown)
         GameState::enqueueRemove(this);
+    else
+        sleep();
 }
 
 namespace Effects
@@ -23,6 +23,7 @@
 
 #include "game-server/actor.h"
 #include "game-server/being.h"
+#include "utils/objectpool.h"
 
 class Effect : public Actor
 {
@@ -41,7 +42,7 @@ class Effect : public Actor
         { return mBeing; }
 
         /**
-         * Removes effect after it has been shown.
+         * Removes effect after it has been shown, and sleeps until then.
          */
         virtual void update();
 
@@ -49,7 +50,10 @@ class Effect : public Actor
          * Called when the object has been shown to a player in the state loop.
          */
         void show()
-        { mHasBeenShown = true; }
+        {
+            mHasBeenShown = true;
+            wake();
+        }
 
 
         bool setBeing(Being *b)
@@ -64,6 +68,14 @@ class Effect : public Actor
             }
         }
 
+        /**
+         * Effects only live until shown, so they are kept in a pool.
+         */
+        static void *operator new(size_t size);
+        static void operator delete(void *object, size_t size);
+
+        static const utils::ObjectPool::Statistics &getPoolStatistics();
+
     private:
         int mEffectId;
         bool mHasBeenShown;
@@ -23,6 +23,7 @@
 #include "game-server/entity.h"
 
 #include "game-server/eventlistener.h"
+#include "game-server/mapcomposite.h"
 
 Entity::~Entity()
 {
@@ -35,6 +36,13 @@ Entity::~Entity()
     assert(mListeners.empty());
 }
 
+void Entity::wake()
+{
+    mAwake = true;
+    if (mSchedule == SLEEPING)
+        mMap->activate(this);
+}
+
 void Entity::addListener(const EventListener *l)
 {
     mListeners.insert(l);
@@ -39,7 +39,9 @@ class Entity
     public:
         Entity(EntityType type, MapComposite *map = 0)
           : mMap(map),
-            mType(type)
+            mType(type),
+            mAwake(true),
+            mSchedule(UNSCHEDULED)
         {}
 
         virtual ~Entity();
@@ -72,10 +74,30 @@ class Entity
         { return mType == OBJECT_CHARACTER || mType == OBJECT_MONSTER; }
 
         /**
-         * Updates the internal status.
+         * Updates the internal status. Only called while the entity is awake.
          */
         virtual void update() = 0;
 
+        /**
+         * Returns whether the entity is updated every tick.
+         */
+        bool isAwake() const
+        { return mAwake; }
+
+        /**
+         * Makes the map update the entity again, from the next tick on if
+         * its update has already run.
+         */
+        void wake();
+
+        /**
+         * Stops updating the entity until something wakes it up. Entities
+         * usually put themselves to sleep from update() when they have
+         * nothing to do until some event.
+         */
+        void sleep()
+        { mAwake = false; }
+
         /**
          * Gets the map this entity is located on.
          */
@@ -113,8 +135,22 @@ class Entity
         Listeners mListeners;   /**< List of event listeners. */
 
     private:
+        /**
+         * Where the entity stands in the updates of its map.
+         */
+        enum Schedule
+        {
+            UNSCHEDULED,        /**< Not inserted on the map. */
+            SLEEPING,           /**< Not updated by the map. */
+            ACTIVE              /**< In the entities updated by the map. */
+        };
+
         MapComposite *mMap;     /**< Map the entity is on */
         EntityType mType;       /**< Type of this entity. */
+        bool mAwake;            /**< Whether it wants to be updated. */
+        Schedule mSchedule;
+
+        friend class MapComposite;
 };
 
 #endif // ENTITY_H
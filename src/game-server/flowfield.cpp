@@ -0,0 +1,132 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/flowfield.h"
+
+#include <algorithm>
+#include <queue>
+
+#include "game-server/map.h"
+
+// Costs of a step, matching those of the tile-level pathfinder
+static int const basicCost = 100;
+static int const straightCost = basicCost + 1;
+static int const diagonalCost = basicCost * 362 / 256;
+
+namespace {
+
+/**
+ * A tile waiting to be visited, ordered by increasing cost.
+ */
+struct OpenTile
+{
+    OpenTile(int cost, unsigned index):
+        cost(cost), index(index)
+    {}
+
+    bool operator< (const OpenTile &other) const
+    { return cost > other.cost; }
+
+    int cost;
+    unsigned index;
+};
+
+} // anonymous namespace
+
+FlowField::FlowField()
+{
+    mBounds.x = mBounds.y = mBounds.w = mBounds.h = 0;
+}
+
+void FlowField::compute(const Map *map, int x, int y,
+                        unsigned char walkmask, int range)
+{
+    // No path can leave the square of the range around the start
+    mBounds.x = std::max(0, x - range);
+    mBounds.y = std::max(0, y - range);
+    mBounds.w = std::min(map->getWidth(), x + range + 1) - mBounds.x;
+    mBounds.h = std::min(map->getHeight(), y + range + 1) - mBounds.y;
+
+    if (mBounds.w <= 0 || mBounds.h <= 0 || !map->contains(x, y))
+    {
+        mBounds.w = mBounds.h = 0;
+        mSteps.clear();
+        return;
+    }
+
+    const unsigned size = mBounds.w * mBounds.h;
+    mSteps.assign(size, -1);
+    mCosts.assign(size, -1);
+
+    const int costLimit = range * basicCost;
+    std::priority_queue<OpenTile> openList;
+
+    const unsigned start = (x - mBounds.x) + (y - mBounds.y) * mBounds.w;
+    mCosts[start] = 0;
+    mSteps[start] = 0;
+    openList.push(OpenTile(0, start));
+
+    while (!openList.empty())
+    {
+        const OpenTile curr = openList.top();
+        openList.pop();
+
+        // Skip tiles that were reached in a cheaper way since
+        if (curr.cost != mCosts[curr.index])
+            continue;
+
+        const int currX = mBounds.x + curr.index % mBounds.w;
+        const int currY = mBounds.y + curr.index / mBounds.w;
+
+        for (int dy = -1; dy <= 1; ++dy)
+        {
+            for (int dx = -1; dx <= 1; ++dx)
+            {
+                const int nx = currX + dx, ny = currY + dy;
+                if ((dx == 0 && dy == 0) || !mBounds.contains(Point(nx, ny)))
+                    continue;
+
+                if (!map->getWalk(nx, ny, walkmask))
+                    continue;
+
+                // When taking a diagonal step, verify that we can skip the
+                // corner.
+                if (dx != 0 && dy != 0 &&
+                    (!map->getWalk(currX, ny, walkmask) ||
+                     !map->getWalk(nx, currY, walkmask)))
+                    continue;
+
+                const int cost = curr.cost +
+                    (dx == 0 || dy == 0 ? straightCost : diagonalCost);
+                if (cost > costLimit)
+                    continue;
+
+                const unsigned index =
+                        (nx - mBounds.x) + (ny - mBounds.y) * mBounds.w;
+                if (mCosts[index] < 0 || cost < mCosts[index])
+                {
+                    mCosts[index] = cost;
+                    mSteps[index] = mSteps[curr.index] + 1;
+                    openList.push(OpenTile(cost, index));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,64 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef FLOWFIELD_H
+#define FLOWFIELD_H
+
+#include <vector>
+
+#include "utils/point.h"
+
+class Map;
+
+/**
+ * The length of the cheapest paths from one tile to all tiles around it,
+ * within a limited range. Answers the same questions as many calls to
+ * Map::findPath from the same start, at the cost of a single search.
+ */
+class FlowField
+{
+    public:
+        FlowField();
+
+        /**
+         * Computes the paths from the given tile to the tiles within range,
+         * using the same costs and limits as Map::findPath.
+         */
+        void compute(const Map *map, int x, int y,
+                     unsigned char walkmask, int range);
+
+        /**
+         * Returns the number of steps of the cheapest path to a tile, or -1
+         * when there is no such path within range.
+         */
+        int getSteps(int x, int y) const
+        {
+            if (!mBounds.contains(Point(x, y)))
+                return -1;
+            return mSteps[(x - mBounds.x) + (y - mBounds.y) * mBounds.w];
+        }
+
+    private:
+        Rectangle mBounds;          /**< Tiles covered by the field */
+        std::vector<int> mSteps;
+        std::vector<int> mCosts;
+};
+
+#endif // FLOWFIELD_H
@@ -37,6 +37,7 @@
 #include "game-server/postman.h"
 #include "game-server/state.h"
 #include "game-server/trade.h"
+#include "net/broadcast.h"
 #include "net/messagein.h"
 #include "net/messageout.h"
 #include "net/netcomputer.h"
@@ -124,9 +125,9 @@ void GameHandler::updateCharacter(int charid, int partyid)
          i_end = clients.end(); i != i_end; ++i)
     {
         GameClient *c = static_cast< GameClient * >(*i);
-        if (c->character->getDatabaseID() == charid)
+        if (c->character && c->character->getDatabaseID() == charid)
         {
-            c->character->setParty(partyid);
+            GameState::setParty(c->character, partyid);
         }
     }
 }
@@ -190,6 +191,8 @@ void GameHandler::processMessage(NetComputer *computer, MessageIn &message)
             return;
 
         std::string magic_token = message.readString(MAGIC_TOKEN_LENGTH);
+        if (message.getUnreadLength() > 0)
+            client.capabilities = message.readInt8();
         client.status = CLIENT_QUEUED; // Before the addPendingClient
         mTokenCollector.addPendingClient(magic_token, &client);
         return;
@@ -316,6 +319,13 @@ void GameHandler::sendTo(Character *beingPtr, MessageOut &msg)
     client->send(msg);
 }
 
+void GameHandler::sendTo(Character *beingPtr, Broadcast &broadcast)
+{
+    GameClient *client = beingPtr->getClient();
+    assert(client && client->status == CLIENT_CONNECTED);
+    broadcast.send(client);
+}
+
 void GameHandler::addPendingCharacter(const std::string &token, Character *ch)
 {
     /* First, check if the character is already on the map. This may happen if
@@ -375,8 +385,24 @@ void GameHandler::tokenMatched(GameClient *computer, Character *character)
     character->triggerLoginCallback();
 
     result.writeInt8(ERRMSG_OK);
+
+    // Older clients neither request capabilities nor expect them here.
+    int capabilities = 0;
+    if (computer->capabilities)
+    {
+        if ((computer->capabilities & CAPABILITY_BUNDLE) &&
+            !MessageOut::isDebugModeEnabled() &&
+            Configuration::getBoolValue("net_bundleMessages", true))
+        {
+            capabilities |= CAPABILITY_BUNDLE;
+        }
+        result.writeInt8(capabilities);
+    }
     computer->send(result);
 
+    // The response itself is never part of a bundle.
+    computer->setBundling(capabilities & CAPABILITY_BUNDLE);
+
     // Force sending the whole character to the client.
     Inventory(character).sendFull();
     character->modifiedAllAttribute();
@@ -416,6 +442,19 @@ Character *GameHandler::getCharacterByNameSlow(const std::string &name) const
     return 0;
 }
 
+Character *GameHandler::getCharacterByDatabaseIdSlow(int id) const
+{
+    for (NetComputers::const_iterator i = clients.begin(),
+         i_end = clients.end(); i != i_end; ++i)
+    {
+        GameClient *c = static_cast< GameClient * >(*i);
+        Character *ch = c->character;
+        if (ch && ch->getDatabaseID() == id)
+            return ch;
+    }
+    return 0;
+}
+
 void GameHandler::handleSay(GameClient &client, MessageIn &message)
 {
     const std::string say = message.readString();
@@ -494,7 +533,7 @@ void GameHandler::handlePickup(GameClient &client, MessageIn &message)
 
                     // We only do this when items are to be kept in memory
                     // between two server restart.
-                    if (!Configuration::getValue("game_floorItemDecayTime", 0))
+                    if (!GameState::floorItemDecayTime)
                     {
                         // Remove the floor item from map
                         accountHandler->removeFloorItems(map->getID(),
@@ -565,7 +604,7 @@ void GameHandler::handleDrop(GameClient &client, MessageIn &message)
 
         // We store the item in database only when the floor items are meant
         // to be persistent between two server restarts.
-        if (!Configuration::getValue("game_floorItemDecayTime", 0))
+        if (!GameState::floorItemDecayTime)
         {
             // Create the floor item on map
             accountHandler->createFloorItems(client.character->getMap()->getID(),
@@ -877,7 +916,7 @@ void GameHandler::handleNpcPostSend(GameClient &client, MessageIn &message)
 void GameHandler::handlePartyInvite(GameClient &client, MessageIn &message)
 {
     MapComposite *map = client.character->getMap();
-    const int visualRange = Configuration::getValue("game_visualRange", 448);
+    const int visualRange = GameState::visualRangeOption;
     std::string invitee = message.readString();
 
     if (invitee == client.character->getName())
@@ -26,6 +26,8 @@
 #include "net/netcomputer.h"
 #include "utils/tokencollector.h"
 
+class Broadcast;
+
 enum
 {
     CLIENT_LOGIN = 0,
@@ -37,9 +39,11 @@ enum
 struct GameClient: NetComputer
 {
     GameClient(ENetPeer *peer)
-      : NetComputer(peer), character(NULL), status(CLIENT_LOGIN) {}
+      : NetComputer(peer), character(NULL), status(CLIENT_LOGIN),
+        capabilities(0) {}
     Character *character;
     int status;
+    int capabilities; /**< Protocol features requested by the client. */
 };
 
 /**
@@ -60,6 +64,11 @@ class GameHandler: public ConnectionHandler
          */
         void sendTo(Character *, MessageOut &msg);
 
+        /**
+         * Sends a broadcast message to the given character.
+         */
+        void sendTo(Character *, Broadcast &broadcast);
+
         /**
          * Kills connection with given character.
          */
@@ -111,6 +120,12 @@ class GameHandler: public ConnectionHandler
          */
         Character *getCharacterByNameSlow(const std::string &) const;
 
+        /**
+         * Gets the character of a client by its database id. This method is
+         * slow, so it should never be called for regular operations.
+         */
+        Character *getCharacterByDatabaseIdSlow(int id) const;
+
     protected:
         NetComputer *computerConnected(ENetPeer *);
         void computerDisconnected(NetComputer *);
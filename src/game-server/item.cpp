@@ -28,10 +28,13 @@
 #include "game-server/autoattack.h"
 #include "game-server/attributemanager.h"
 #include "game-server/being.h"
+#include "game-server/mapcomposite.h"
 #include "game-server/state.h"
 #include "scripting/script.h"
 #include "scripting/scriptmanager.h"
 
+static utils::ObjectPool itemPool(sizeof(Item));
+
 bool ItemEffectAttrMod::apply(Being *itemUser)
 {
     LOG_DEBUG("Applying modifier.");
@@ -120,17 +123,49 @@ bool ItemClass::useTrigger(Being *itemUser, ItemTriggerType trigger)
 
 
 Item::Item(ItemClass *type, int amount)
-          : Actor(OBJECT_ITEM), mType(type), mAmount(amount)
+          : Actor(OBJECT_ITEM), mType(type), mAmount(amount),
+            mDecayTimer(this)
+{
+    mLifetime = GameState::floorItemDecayTime * 10;
+}
+
+void *Item::operator new(size_t size)
+{
+    return itemPool.allocate(size);
+}
+
+void Item::operator delete(void *object, size_t size)
+{
+    itemPool.release(object, size);
+}
+
+const utils::ObjectPool::Statistics &Item::getPoolStatistics()
 {
-    mLifetime = Configuration::getValue("game_floorItemDecayTime", 0) * 10;
+    return itemPool.getStatistics();
 }
 
 void Item::update()
 {
+    sleep();
+}
+
+void Item::inserted()
+{
+    Actor::inserted();
     if (mLifetime)
     {
-        mLifetime--;
-        if (!mLifetime)
-            GameState::enqueueRemove(this);
+        getMap()->getTimingWheel().schedule(
+                &mDecayTimer, GameState::getCurrentTick() + mLifetime);
     }
 }
+
+void Item::removed()
+{
+    mDecayTimer.cancel();
+    Actor::removed();
+}
+
+void Item::decay()
+{
+    GameState::enqueueRemove(this);
+}
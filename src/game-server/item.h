@@ -24,7 +24,9 @@
 #include <vector>
 
 #include "game-server/actor.h"
+#include "game-server/timingwheel.h"
 #include "scripting/script.h"
+#include "utils/objectpool.h"
 
 class Being;
 class ItemClass;
@@ -314,12 +316,40 @@ class Item : public Actor
         int getAmount() const
         { return mAmount; }
 
+        /**
+         * Sleeps, floor items only wait for their decay timer.
+         */
         virtual void update();
 
+        /**
+         * Overridden in order to schedule the decay of the item.
+         */
+        virtual void inserted();
+
+        /**
+         * Overridden in order to cancel the decay of the item.
+         */
+        virtual void removed();
+
+        /**
+         * Items lying on the floor are allocated from a pool, since they are
+         * dropped and picked up all the time.
+         */
+        static void *operator new(size_t size);
+        static void operator delete(void *object, size_t size);
+
+        static const utils::ObjectPool::Statistics &getPoolStatistics();
+
     private:
+        /**
+         * Removes the item from the floor.
+         */
+        void decay();
+
         ItemClass *mType;
         unsigned char mAmount;
-        int mLifetime;
+        int mLifetime;          /**< Ticks on the floor, 0 for ever. */
+        MemberTimer< Item, &Item::decay > mDecayTimer;
 };
 
 #endif // ITEM_H
@@ -0,0 +1,645 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A game server without network, of which the world is populated by
+ * simulated players. It runs a fixed number of ticks as fast as it can and
+ * reports how long they took, how much memory was allocated and how much
+ * data would have been sent to the clients.
+ */
+
+#include "common/configuration.h"
+#include "common/defines.h"
+#include "common/manaserv_protocol.h"
+#include "common/permissionmanager.h"
+#include "common/resourcemanager.h"
+#include "game-server/accountconnection.h"
+#include "game-server/attributemanager.h"
+#include "game-server/character.h"
+#include "game-server/gamehandler.h"
+#include "game-server/itemmanager.h"
+#include "game-server/map.h"
+#include "game-server/mapcomposite.h"
+#include "game-server/mapmanager.h"
+#include "game-server/monstermanager.h"
+#include "game-server/pathservice.h"
+#include "game-server/postman.h"
+#include "game-server/skillmanager.h"
+#include "game-server/specialmanager.h"
+#include "game-server/state.h"
+#include "game-server/statusmanager.h"
+#include "game-server/tickprofiler.h"
+#include "net/bandwidth.h"
+#include "net/messagein.h"
+#include "net/messageout.h"
+#include "scripting/scriptmanager.h"
+#include "utils/logger.h"
+#include "utils/mathutils.h"
+#include "utils/processorutils.h"
+#include "utils/stringfilter.h"
+#include "utils/timer.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <getopt.h>
+#include <iostream>
+#include <map>
+#include <new>
+#include <sstream>
+#include <vector>
+#include <physfs.h>
+
+using namespace ManaServ;
+using utils::Logger;
+
+#define DEFAULT_LOG_FILE                    "manaserv-bench.log"
+#define DEFAULT_ITEMSDB_FILE                "items.xml"
+#define DEFAULT_EQUIPDB_FILE                "equip.xml"
+#define DEFAULT_SKILLSDB_FILE               "skills.xml"
+#define DEFAULT_ATTRIBUTEDB_FILE            "attributes.xml"
+#define DEFAULT_MAPSDB_FILE                 "maps.xml"
+#define DEFAULT_MONSTERSDB_FILE             "monsters.xml"
+#define DEFAULT_STATUSDB_FILE               "status-effects.xml"
+#define DEFAULT_PERMISSION_FILE             "permissions.xml"
+#define DEFAULT_MAIN_SCRIPT_FILE            "scripts/main.lua"
+#define DEFAULT_SPECIALSDB_FILE             "specials.xml"
+
+/** Ticks between two actions of a simulated player. */
+static int const ACTION_TICKS = 10;
+
+/** Distance up to which simulated players look for targets, in pixels. */
+static int const SIGHT_RANGE = 320;
+
+// The globals otherwise defined by main-game.cpp
+
+utils::StringFilter *stringFilter;
+
+AttributeManager *attributeManager = new AttributeManager(DEFAULT_ATTRIBUTEDB_FILE);
+ItemManager *itemManager = new ItemManager(DEFAULT_ITEMSDB_FILE, DEFAULT_EQUIPDB_FILE);
+MonsterManager *monsterManager = new MonsterManager(DEFAULT_MONSTERSDB_FILE);
+SkillManager *skillManager = new SkillManager(DEFAULT_SKILLSDB_FILE);
+SpecialManager *specialManager = new SpecialManager(DEFAULT_SPECIALSDB_FILE);
+
+GameHandler *gameHandler;
+AccountConnection *accountHandler;
+PostMan *postMan;
+BandwidthMonitor *gBandwidth;
+
+/*
+ * Count the allocations made with new. Arrays are allocated through these
+ * as well.
+ */
+
+static volatile unsigned long allocations = 0;
+
+#if __cplusplus >= 201103L
+#define THROW_BAD_ALLOC
+#else
+#define THROW_BAD_ALLOC throw (std::bad_alloc)
+#endif
+
+void *operator new(std::size_t size) THROW_BAD_ALLOC
+{
+    __sync_fetch_and_add(&allocations, 1);
+    void *p = std::malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) throw()
+{
+    std::free(p);
+}
+
+/**
+ * A game handler of which the clients are fed with messages by the
+ * benchmark instead of the network.
+ */
+class BenchHandler : public GameHandler
+{
+    public:
+        /**
+         * Adds a client without network connection. The messages sent to
+         * it are counted but dropped.
+         */
+        GameClient *addClient()
+        {
+            ENetPeer *peer = new ENetPeer;
+            std::memset(peer, 0, sizeof(ENetPeer));
+            peer->state = ENET_PEER_STATE_DISCONNECTED;
+
+            GameClient *client = new GameClient(peer);
+            clients.push_back(client);
+            return client;
+        }
+
+        /**
+         * Handles a message as if it was received from the client.
+         */
+        void receive(GameClient *client, const MessageOut &msg)
+        {
+            MessageIn in(msg.getData(), msg.getLength());
+            processMessage(client, in);
+        }
+
+        /**
+         * Sends the bundled messages, without touching the network host.
+         */
+        void flushBundles()
+        {
+            for (NetComputers::iterator i = clients.begin(),
+                 i_end = clients.end(); i != i_end; ++i)
+            {
+                (*i)->flushBundle();
+            }
+        }
+};
+
+/**
+ * A player driven by the benchmark. Every few ticks it walks around, attacks
+ * a monster, picks up an item or says something, as a client would ask.
+ */
+class Bot
+{
+    public:
+        Bot(BenchHandler *handler, GameClient *client, int index)
+            : mHandler(handler),
+              mClient(client),
+              mIndex(index),
+              mSeed(index * 7919 + 1)
+        {}
+
+        void act(int tick)
+        {
+            Character *ch = mClient->character;
+            if (!ch || !ch->getMap())
+                return;
+
+            // Spread the actions of the players over the ticks
+            if ((tick + mIndex) % ACTION_TICKS != 0)
+                return;
+
+            const int choice = random(100);
+            if (choice < 50)
+                walk(ch);
+            else if (choice < 75)
+                attack(ch);
+            else if (choice < 90)
+                pickup(ch);
+            else
+                chat();
+        }
+
+    private:
+        int random(int range)
+        {
+            mSeed = mSeed * 1103515245 + 12345;
+            return (mSeed >> 16) % range;
+        }
+
+        void walk(Character *ch)
+        {
+            const Map *map = ch->getMap()->getMap();
+            const int tileWidth = map->getTileWidth();
+            const int tileHeight = map->getTileHeight();
+            const Point &pos = ch->getPosition();
+
+            // Try a few tiles around, as a player clicking somewhere would
+            for (int tries = 0; tries < 8; ++tries)
+            {
+                const int x = pos.x / tileWidth + random(17) - 8;
+                const int y = pos.y / tileHeight + random(17) - 8;
+                if (!map->getWalk(x, y, ch->getWalkMask()))
+                    continue;
+
+                sendWalk(x * tileWidth + tileWidth / 2,
+                         y * tileHeight + tileHeight / 2);
+                return;
+            }
+        }
+
+        void attack(Character *ch)
+        {
+            MapComposite *map = ch->getMap();
+            for (BeingIterator i(map->getAroundBeingIterator(ch,
+                                                             SIGHT_RANGE));
+                 i; ++i)
+            {
+                if ((*i)->getType() != OBJECT_MONSTER)
+                    continue;
+
+                MessageOut msg(PGMSG_ATTACK);
+                msg.writeInt16((*i)->getPublicID());
+                mHandler->receive(mClient, msg);
+                return;
+            }
+
+            walk(ch);
+        }
+
+        void pickup(Character *ch)
+        {
+            MapComposite *map = ch->getMap();
+            const Point &pos = ch->getPosition();
+            for (FixedActorIterator i(map->getAroundActorIterator(ch,
+                                                                  SIGHT_RANGE));
+                 i; ++i)
+            {
+                if ((*i)->getType() != OBJECT_ITEM)
+                    continue;
+
+                const Point &itemPos = (*i)->getPosition();
+                if (std::abs(itemPos.x - pos.x) +
+                    std::abs(itemPos.y - pos.y) < 48)
+                {
+                    MessageOut msg(PGMSG_PICKUP);
+                    msg.writeInt16(itemPos.x);
+                    msg.writeInt16(itemPos.y);
+                    mHandler->receive(mClient, msg);
+                }
+                else
+                {
+                    sendWalk(itemPos.x, itemPos.y);
+                }
+                return;
+            }
+
+            walk(ch);
+        }
+
+        void chat()
+        {
+            std::ostringstream text;
+            text << "Hello from bot " << mIndex << "!";
+
+            MessageOut msg(PGMSG_SAY);
+            msg.writeString(text.str());
+            mHandler->receive(mClient, msg);
+        }
+
+        void sendWalk(int x, int y)
+        {
+            MessageOut msg(PGMSG_WALK);
+            msg.writeInt16(x);
+            msg.writeInt16(y);
+            mHandler->receive(mClient, msg);
+        }
+
+        BenchHandler *mHandler;
+        GameClient *mClient;
+        int mIndex;
+        unsigned mSeed;
+};
+
+struct CommandLineOptions
+{
+    CommandLineOptions():
+        verbosity(Logger::Error),
+        players(100),
+        ticks(1000),
+        mapId(1)
+    {}
+
+    std::string configPath;
+    Logger::Level verbosity;
+    int players;
+    int ticks;
+    int mapId;
+};
+
+static void printHelp()
+{
+    std::cout << "manaserv-bench" << std::endl << std::endl
+              << "Options: " << std::endl
+              << "  -h --help          : Display this help" << std::endl
+              << "     --config <path> : Set the config path to use."
+              << " (Default: ./manaserv.xml)" << std::endl
+              << "     --verbosity <n> : Set the verbosity level"
+              << " (Default: 1)" << std::endl
+              << "     --players <n>   : Set the number of simulated players"
+              << " (Default: 100)" << std::endl
+              << "     --ticks <n>     : Set the number of ticks to run"
+              << " (Default: 1000)" << std::endl
+              << "     --map <id>      : Set the map the players start on"
+              << " (Default: 1)" << std::endl;
+    exit(EXIT_NORMAL);
+}
+
+static void parseOptions(int argc, char *argv[], CommandLineOptions &options)
+{
+    const char *optString = "h";
+
+    const struct option longOptions[] =
+    {
+        { "help",       no_argument,       0, 'h' },
+        { "config",     required_argument, 0, 'c' },
+        { "verbosity",  required_argument, 0, 'v' },
+        { "players",    required_argument, 0, 'n' },
+        { "ticks",      required_argument, 0, 't' },
+        { "map",        required_argument, 0, 'm' },
+        { 0, 0, 0, 0 }
+    };
+
+    while (optind < argc)
+    {
+        int result = getopt_long(argc, argv, optString, longOptions, NULL);
+
+        if (result == -1)
+            break;
+
+        switch (result)
+        {
+            default: // Unknown option.
+            case 'h':
+                printHelp();
+                break;
+            case 'c':
+                options.configPath = optarg;
+                break;
+            case 'v':
+                options.verbosity = static_cast<Logger::Level>(atoi(optarg));
+                break;
+            case 'n':
+                options.players = atoi(optarg);
+                break;
+            case 't':
+                options.ticks = atoi(optarg);
+                break;
+            case 'm':
+                options.mapId = atoi(optarg);
+                break;
+        }
+    }
+}
+
+static void initializeServer()
+{
+    PHYSFS_init("");
+
+    Logger::initialize(DEFAULT_LOG_FILE);
+
+    stringFilter = new utils::StringFilter;
+
+    ResourceManager::initialize();
+    ScriptManager::initialize();   // Depends on ResourceManager
+    if (MapManager::initialize(DEFAULT_MAPSDB_FILE) < 1)
+    {
+        LOG_FATAL("The benchmark can't find any valid/available maps.");
+        exit(EXIT_MAP_FILE_NOT_FOUND);
+    }
+    attributeManager->initialize();
+    skillManager->initialize();
+    specialManager->initialize();
+    itemManager->initialize();
+    monsterManager->initialize();
+    StatusManager::initialize(DEFAULT_STATUSDB_FILE);
+    PermissionManager::initialize(DEFAULT_PERMISSION_FILE);
+
+    std::string mainScript = Configuration::getValue("script_mainFile",
+                                                     DEFAULT_MAIN_SCRIPT_FILE);
+    ScriptManager::loadMainScript(mainScript);
+
+    // The account connection is never started, what is sent to it is lost
+    gameHandler = new BenchHandler;
+    accountHandler = new AccountConnection;
+    postMan = new PostMan;
+    gBandwidth = new BandwidthMonitor;
+    GameState::initialize();
+    PathService::initialize();
+
+    utils::math::init();
+    utils::processor::init();
+
+    // Have the same world for every run
+    std::srand(0);
+
+    // Without account server, all the maps are served here
+    const MapManager::Maps &maps = MapManager::getMaps();
+    for (MapManager::Maps::const_iterator m = maps.begin(),
+         m_end = maps.end(); m != m_end; ++m)
+    {
+        MapManager::activateMap(m->first);
+    }
+}
+
+/**
+ * Creates a character as the account server would describe it, standing on
+ * a random walkable tile of the given map.
+ */
+static Character *createCharacter(int id, MapComposite *map)
+{
+    const Map *tiles = map->getMap();
+    int x, y;
+    do
+    {
+        x = std::rand() % tiles->getWidth();
+        y = std::rand() % tiles->getHeight();
+    }
+    while (!tiles->getWalk(x, y, Map::BLOCKMASK_WALL));
+
+    std::ostringstream name;
+    name << "Bot" << id;
+
+    // As sent by an account server accepting binary doubles
+    MessageOut msg(AGMSG_PLAYER_ENTER);
+    msg.setBinaryDoubles(true);
+    msg.writeInt32(id);
+    msg.writeString(name.str());
+    msg.writeInt8(AL_PLAYER);
+    msg.writeInt8(GENDER_UNSPECIFIED);
+    msg.writeInt8(0);                       // Hair style
+    msg.writeInt8(0);                       // Hair color
+    msg.writeInt16(1);                      // Level
+    msg.writeInt16(0);                      // Character points
+    msg.writeInt16(0);                      // Correction points
+
+    // The base attributes, as given when creating a character
+    msg.writeInt16(ATTR_WIL - ATTR_STR + 1);
+    for (int i = ATTR_STR; i <= ATTR_WIL; ++i)
+    {
+        msg.writeInt16(i);
+        msg.writeDouble(10);
+        msg.writeDouble(10);
+    }
+
+    msg.writeInt16(0);                      // Skills
+    msg.writeInt16(0);                      // Status effects
+    msg.writeInt16(map->getID());
+    msg.writeInt16(x * tiles->getTileWidth() + tiles->getTileWidth() / 2);
+    msg.writeInt16(y * tiles->getTileHeight() + tiles->getTileHeight() / 2);
+    msg.writeInt16(0);                      // Kill counts
+    msg.writeInt16(0);                      // Specials
+    msg.writeInt16(0);                      // Equipment
+
+    MessageIn in(msg.getData(), msg.getLength());
+    return new Character(in);
+}
+
+static void printTimes(const char *name, const utils::Histogram &times)
+{
+    std::cout << "  " << name << ": p50 " << times.getPercentile(50)
+              << " us, p90 " << times.getPercentile(90)
+              << " us, p99 " << times.getPercentile(99)
+              << " us, max " << times.getMax() << " us" << std::endl;
+}
+
+typedef std::map< int, ZoneStatistics > ZoneStatisticsMap;
+
+static void getZoneStatistics(ZoneStatisticsMap &zones)
+{
+    const MapManager::Maps &maps = MapManager::getMaps();
+    for (MapManager::Maps::const_iterator i = maps.begin(),
+         i_end = maps.end(); i != i_end; ++i)
+    {
+        if (i->second->isActive())
+            zones[i->first] = i->second->getZoneStatistics();
+    }
+}
+
+/**
+ * Prints the use of the zones of the active maps since the given statistics
+ * were taken, and how many of their entities are awake.
+ */
+static void printMapStatistics(const ZoneStatisticsMap &start)
+{
+    const MapManager::Maps &maps = MapManager::getMaps();
+    for (MapManager::Maps::const_iterator i = maps.begin(),
+         i_end = maps.end(); i != i_end; ++i)
+    {
+        const MapComposite *map = i->second;
+        if (!map->isActive())
+            continue;
+
+        ZoneStatistics before;
+        ZoneStatisticsMap::const_iterator s = start.find(i->first);
+        if (s != start.end())
+            before = s->second;
+
+        const ZoneStatistics &zones = map->getZoneStatistics();
+        const unsigned active = map->getActiveEntityCount();
+        const unsigned sleeping = map->getEverything().size() - active;
+        std::cout << "  " << map->getName() << ": "
+                  << zones.zoneChanges - before.zoneChanges
+                  << " zone changes, "
+                  << zones.regions - before.regions << " regions of "
+                  << zones.regionZones - before.regionZones << " zones, "
+                  << active << " entities active, "
+                  << sleeping << " sleeping" << std::endl;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    CommandLineOptions options;
+    parseOptions(argc, argv, options);
+
+    // The defaults will do when there is no configuration
+    Configuration::initialize(options.configPath);
+    Logger::setVerbosity(options.verbosity);
+
+    initializeServer();
+
+    MapComposite *startMap = MapManager::getMap(options.mapId);
+    if (!startMap || !startMap->isActive())
+    {
+        LOG_FATAL("Map " << options.mapId << " is not available.");
+        return EXIT_MAP_FILE_NOT_FOUND;
+    }
+
+    BenchHandler *handler = static_cast< BenchHandler * >(gameHandler);
+
+    // Bring the players in
+    const unsigned long allocationsBefore = allocations;
+    std::vector< Bot > bots;
+    for (int i = 0; i < options.players; ++i)
+    {
+        GameClient *client = handler->addClient();
+        handler->tokenMatched(client, createCharacter(i + 1, startMap));
+        bots.push_back(Bot(handler, client, i));
+    }
+    handler->flushBundles();
+
+    std::cout << "Inserted " << options.players << " players with "
+              << allocations - allocationsBefore << " allocations."
+              << std::endl;
+
+    // Only measure the ticks
+    TickProfiler::reset();
+    ZoneStatisticsMap zonesStart;
+    getZoneStatistics(zonesStart);
+    const unsigned long allocationsStart = allocations;
+    const int outputStart = gBandwidth->totalClientOut();
+    const uint64_t timeStart = utils::getMicroseconds();
+
+    for (int tick = 1; tick <= options.ticks; ++tick)
+    {
+        TickProfiler::Timer tickTimer(TickProfiler::PHASE_TICK);
+
+        {
+            TickProfiler::Timer timer(TickProfiler::PHASE_NETWORK);
+            for (std::vector< Bot >::iterator i = bots.begin(),
+                 i_end = bots.end(); i != i_end; ++i)
+            {
+                i->act(tick);
+            }
+        }
+
+        GameState::update(tick);
+
+        {
+            TickProfiler::Timer timer(TickProfiler::PHASE_FLUSH);
+            handler->flushBundles();
+        }
+    }
+
+    const uint64_t elapsed = utils::getMicroseconds() - timeStart;
+    const unsigned long tickAllocations = allocations - allocationsStart;
+    const int output = gBandwidth->totalClientOut() - outputStart;
+
+    std::cout << "Ran " << options.ticks << " ticks in " << elapsed / 1000
+              << " ms." << std::endl;
+    for (int i = 0; i < TickProfiler::NB_PHASES; ++i)
+    {
+        TickProfiler::Phase phase = static_cast< TickProfiler::Phase >(i);
+        printTimes(TickProfiler::getPhaseName(phase),
+                   TickProfiler::getHistogram(phase));
+    }
+
+    std::cout << "Allocations: " << tickAllocations << " ("
+              << tickAllocations / std::max(options.ticks, 1)
+              << " per tick)" << std::endl;
+
+    MessageOut::BufferStatistics buffers = MessageOut::getBufferStatistics();
+    std::cout << "Message buffers: " << buffers.allocated << " allocated, "
+              << buffers.reused << " reused" << std::endl;
+    std::cout << "Client output: " << output << " bytes ("
+              << output / std::max(options.ticks, 1) << " per tick, "
+              << output / std::max(options.ticks * options.players, 1)
+              << " per player and tick)" << std::endl;
+
+    std::cout << "Maps:" << std::endl;
+    printMapStatistics(zonesStart);
+
+    Logger::deinitialize();
+    PHYSFS_deinit();
+
+    return EXIT_NORMAL;
+}
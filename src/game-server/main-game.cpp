@@ -24,13 +24,19 @@
 #include "common/resourcemanager.h"
 #include "game-server/accountconnection.h"
 #include "game-server/attributemanager.h"
+#include "game-server/effect.h"
 #include "game-server/gamehandler.h"
+#include "game-server/item.h"
 #include "game-server/itemmanager.h"
+#include "game-server/mapcomposite.h"
 #include "game-server/mapmanager.h"
+#include "game-server/monster.h"
 #include "game-server/monstermanager.h"
+#include "game-server/pathservice.h"
 #include "game-server/skillmanager.h"
 #include "game-server/specialmanager.h"
 #include "game-server/statusmanager.h"
+#include "game-server/tickprofiler.h"
 #include "game-server/postman.h"
 #include "game-server/state.h"
 #include "net/bandwidth.h"
@@ -82,6 +88,9 @@ static utils::Timer worldTimer(WORLD_TICK_MS);
 static int currentTick = 0;     /**< Current world time in ticks */
 static bool running = true;     /**< Whether the server keeps running */
 
+/** Whether the configuration is to be read again */
+static volatile sig_atomic_t reloadRequested = 0;
+
 utils::StringFilter *stringFilter; /**< Slang's Filter */
 
 AttributeManager *attributeManager = new AttributeManager(DEFAULT_ATTRIBUTEDB_FILE);
@@ -108,6 +117,29 @@ static void closeGracefully(int)
     running = false;
 }
 
+#ifdef SIGHUP
+/** Callback used when SIGHUP signal is received. */
+static void requestReload(int)
+{
+    reloadRequested = 1;
+}
+#endif
+
+/**
+ * Applies a changed log level, unless it was given on the command line.
+ */
+class LogLevelListener : public Configuration::Listener
+{
+    public:
+        void optionChanged(const std::string &key)
+        {
+            Logger::setVerbosity(static_cast<Logger::Level>(
+                    Configuration::getValue(key, Logger::Warn)));
+        }
+};
+
+static LogLevelListener logLevelListener;
+
 static void initializeServer()
 {
     // Used to close via process signals
@@ -117,6 +149,11 @@ static void initializeServer()
     signal(SIGINT, closeGracefully);
     signal(SIGTERM, closeGracefully);
 
+    // Used to read the configuration again without restarting
+#ifdef SIGHUP
+    signal(SIGHUP, requestReload);
+#endif
+
     std::string logFile = Configuration::getValue("log_gameServerFile",
                                                   DEFAULT_LOG_FILE);
 
@@ -155,6 +192,8 @@ static void initializeServer()
     accountHandler = new AccountConnection;
     postMan = new PostMan;
     gBandwidth = new BandwidthMonitor;
+    GameState::initialize();
+    PathService::initialize();
 
     // --- Initialize enet.
     if (enet_initialize() != 0)
@@ -190,6 +229,8 @@ static void deinitializeServer()
     delete accountHandler; accountHandler = 0;
     delete postMan; postMan = 0;
     delete gBandwidth; gBandwidth = 0;
+    PathService::deinitialize();
+    GameState::deinitialize();
 
     // Destroy Managers
     delete stringFilter; stringFilter = 0;
@@ -201,9 +242,90 @@ static void deinitializeServer()
     ScriptManager::deinitialize();
 
     PHYSFS_deinit();
+
+    // Write the remaining log messages
+    Logger::deinitialize();
 }
 
 
+/**
+ * Logs the counters of a pool of entities.
+ */
+static void logPoolStatistics(const char *name,
+                              const utils::ObjectPool::Statistics &pool)
+{
+    LOG_INFO("Pooled " << name << ": " << pool.live << " alive (at most "
+             << pool.peak << "), " << pool.slabs << " slabs, "
+             << pool.allocations << " allocated in total");
+}
+
+/**
+ * Logs the statistics of the world, whether connected to the account server
+ * or not, and starts gathering them anew.
+ */
+static void logStatistics()
+{
+    MessageOut::BufferStatistics buffers =
+            MessageOut::getBufferStatistics();
+    LOG_INFO("Message buffers: " << buffers.allocated
+             << " allocated, " << buffers.reused << " reused, "
+             << buffers.copiedBytes << " Bytes copied");
+    LOG_INFO("Packets sharing message data: " << buffers.packets
+             << " (" << buffers.packetBytes << " Bytes)");
+
+    if (unsigned dropped = Logger::getDroppedCount())
+        LOG_INFO("Log messages dropped: " << dropped);
+
+    logPoolStatistics("monsters", Monster::getPoolStatistics());
+    logPoolStatistics("items", Item::getPoolStatistics());
+    logPoolStatistics("effects", Effect::getPoolStatistics());
+
+    unsigned activeEntities = 0, sleepingEntities = 0;
+    const MapManager::Maps &maps = MapManager::getMaps();
+    for (MapManager::Maps::const_iterator m = maps.begin(),
+         m_end = maps.end(); m != m_end; ++m)
+    {
+        const MapComposite *map = m->second;
+        if (!map->isActive())
+            continue;
+
+        const ZoneStatistics &zones = map->getZoneStatistics();
+        LOG_DEBUG("Zones of map " << map->getName() << ": "
+                  << zones.zoneChanges << " changes, "
+                  << zones.regions << " regions of "
+                  << zones.regionZones << " zones in total");
+
+        const unsigned active = map->getActiveEntityCount();
+        const unsigned sleeping =
+                map->getEverything().size() - active;
+        LOG_DEBUG("Entities of map " << map->getName() << ": "
+                  << active << " active, "
+                  << sleeping << " sleeping");
+        activeEntities += active;
+        sleepingEntities += sleeping;
+    }
+    LOG_INFO("Entities: " << activeEntities << " active, "
+             << sleepingEntities << " sleeping");
+
+    if (PathService::isEnabled())
+    {
+        const PathService::Statistics &paths =
+                PathService::getStatistics();
+        LOG_INFO("Paths: " << paths.requests << " requested, "
+                 << paths.solved << " searched in "
+                 << paths.searchTime / 1000 << " ms, "
+                 << paths.outdated << " outdated");
+        LOG_INFO("Path requests waiting: " << paths.queued
+                 << " (at most " << paths.maxQueued
+                 << "), latency: at most " << paths.maxLatency
+                 << " ticks, " << paths.overBudget
+                 << " ticks over budget");
+    }
+
+    TickProfiler::logStatistics();
+    TickProfiler::reset();
+}
+
 /**
  * Show command line arguments.
  */
@@ -319,6 +441,10 @@ int main(int argc, char *argv[])
                                                        options.verbosity) );
     Logger::setVerbosity(options.verbosity);
 
+    if (!options.verbosityChanged)
+        Configuration::addListener("log_gameServerLogLevel",
+                                   &logLevelListener);
+
     // General initialization
     initializeServer();
 
@@ -379,6 +505,13 @@ int main(int argc, char *argv[])
 
     while (running)
     {
+        if (reloadRequested)
+        {
+            reloadRequested = 0;
+            LOG_INFO("Received: Hangup signal, reloading configuration...");
+            Configuration::reload();
+        }
+
         int elapsedTicks = worldTimer.poll();
 
         if (elapsedTicks == 0)
@@ -395,6 +528,7 @@ int main(int argc, char *argv[])
 
         while (elapsedTicks > 0)
         {
+            TickProfiler::Timer tickTimer(TickProfiler::PHASE_TICK);
             currentTick++;
             elapsedTicks--;
 
@@ -407,7 +541,10 @@ int main(int argc, char *argv[])
                 accountServerLost = false;
 
                 // Handle all messages that are in the message queues
-                accountHandler->process();
+                {
+                    TickProfiler::Timer timer(TickProfiler::PHASE_ACCOUNT);
+                    accountHandler->process();
+                }
 
                 if (currentTick % 100 == 0) {
                     accountHandler->syncChanges(true);
@@ -421,6 +558,7 @@ int main(int argc, char *argv[])
                     LOG_INFO("Total Account Input: " << gBandwidth->totalInterServerIn() << " Bytes");
                     LOG_INFO("Total Client Output: " << gBandwidth->totalClientOut() << " Bytes");
                     LOG_INFO("Total Client Input: " << gBandwidth->totalClientIn() << " Bytes");
+                    LOG_INFO("Total Broadcast Saving: " << gBandwidth->totalBroadcastSaving() << " Bytes");
                 }
             }
             else
@@ -439,11 +577,22 @@ int main(int argc, char *argv[])
                     accountHandler->start(options.port);
                 }
             }
-            gameHandler->process();
+
+            // After the statistics were sent to the account server
+            if (currentTick % 300 == 0)
+                logStatistics();
+
+            {
+                TickProfiler::Timer timer(TickProfiler::PHASE_NETWORK);
+                gameHandler->process();
+            }
             // Update all active objects/beings
             GameState::update(currentTick);
             // Send potentially urgent outgoing messages
-            gameHandler->flush();
+            {
+                TickProfiler::Timer timer(TickProfiler::PHASE_FLUSH);
+                gameHandler->flush();
+            }
         }
     }
 
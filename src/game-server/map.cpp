@@ -21,12 +21,17 @@
 #include <algorithm>
 #include <queue>
 #include <cassert>
+#include <cstdlib>
 #include <cstring>
 #include <limits.h>
 
 #include "game-server/map.h"
 
+#include "game-server/clustergraph.h"
+#include "game-server/flowfield.h"
+
 #include "common/defines.h"
+#include "utils/thread.h"
 
 /**
  * Stores information used during path finding for each tile of a map.
@@ -60,6 +65,7 @@ class FindPath
         Path operator() (int startX, int startY,
                          int destX, int destY,
                          unsigned char walkmask, int maxCost,
+                         const Rectangle &bounds,
                          const Map *map);
 
     private:
@@ -73,7 +79,11 @@ class FindPath
         unsigned mOnClosedList, mOnOpenList;
 };
 
-static FindPath findPath;
+// Each thread gets its own, so that paths can be searched concurrently
+static utils::ThreadLocal<FindPath> findPath;
+
+// Amount of flow fields a map keeps
+static unsigned const maxFlowFields = 128;
 
 
 /**
@@ -99,7 +109,8 @@ class Location
 Map::Map(int width, int height, int tileWidth, int tileHeight):
     mWidth(width), mHeight(height),
     mTileWidth(tileWidth), mTileHeight(tileHeight),
-    mMetaTiles(width * height)
+    mMetaTiles(width * height),
+    mClusterGraph(0)
 {
 }
 
@@ -110,6 +121,14 @@ Map::~Map()
     {
         delete *it;
     }
+    delete mClusterGraph;
+
+    forgetFlowFields();
+    for (std::vector<FlowField*>::iterator it = mFreeFlowFields.begin();
+         it != mFreeFlowFields.end(); ++it)
+    {
+        delete *it;
+    }
 }
 
 void Map::setSize(int width, int height)
@@ -118,6 +137,17 @@ void Map::setSize(int width, int height)
     mHeight = height;
 
     mMetaTiles.resize(width * height);
+
+    delete mClusterGraph;
+    mClusterGraph = 0;
+
+    forgetFlowFields();
+}
+
+void Map::initializeClusters(int clusterSize)
+{
+    delete mClusterGraph;
+    mClusterGraph = new ClusterGraph(this, clusterSize);
 }
 
 const std::string &Map::getProperty(const std::string &key) const
@@ -136,6 +166,10 @@ void Map::blockTile(int x, int y, BlockType type)
         return;
 
     MetaTile &metaTile = mMetaTiles[x + y * mWidth];
+    const char oldBlockmask = metaTile.blockmask;
+
+    if (type == BLOCKTYPE_WALL && !metaTile.occupation[type] && mClusterGraph)
+        mClusterGraph->invalidateTile(x, y);
 
     if (metaTile.occupation[type] < UINT_MAX &&
         (++metaTile.occupation[type]) > 0)
@@ -156,6 +190,9 @@ void Map::blockTile(int x, int y, BlockType type)
                 break;
         }
     }
+
+    if ((metaTile.blockmask ^ oldBlockmask) & BLOCKMASK_WALL)
+        forgetFlowFields(x, y);
 }
 
 void Map::freeTile(int x, int y, BlockType type)
@@ -165,9 +202,13 @@ void Map::freeTile(int x, int y, BlockType type)
 
     MetaTile &metaTile = mMetaTiles[x + y * mWidth];
     assert(metaTile.occupation[type] > 0);
+    const char oldBlockmask = metaTile.blockmask;
 
     if (!(--metaTile.occupation[type]))
     {
+        if (type == BLOCKTYPE_WALL && mClusterGraph)
+            mClusterGraph->invalidateTile(x, y);
+
         switch (type)
         {
             case BLOCKTYPE_WALL:
@@ -183,6 +224,9 @@ void Map::freeTile(int x, int y, BlockType type)
                 // nothing
                 break;
         }
+
+        if ((metaTile.blockmask ^ oldBlockmask) & BLOCKMASK_WALL)
+            forgetFlowFields(x, y);
     }
 }
 
@@ -196,19 +240,157 @@ bool Map::getWalk(int x, int y, char walkmask) const
     return !(mMetaTiles[x + y * mWidth].blockmask & walkmask);
 }
 
+bool Map::FlowFieldKey::operator< (const FlowFieldKey &other) const
+{
+    if (x != other.x)
+        return x < other.x;
+    if (y != other.y)
+        return y < other.y;
+    if (walkmask != other.walkmask)
+        return walkmask < other.walkmask;
+    return range < other.range;
+}
+
+const FlowField &Map::getFlowField(int x, int y,
+                                   unsigned char walkmask, int range)
+{
+    // Occupation by beings is left to the paths followed
+    walkmask &= BLOCKMASK_WALL;
+
+    FlowFieldKey key;
+    key.x = x;
+    key.y = y;
+    key.walkmask = walkmask;
+    key.range = range;
+
+    FlowFields::iterator it = mFlowFields.find(key);
+    if (it != mFlowFields.end())
+    {
+        CachedFlowField &cached = it->second;
+        mFlowFieldUses.splice(mFlowFieldUses.begin(), mFlowFieldUses,
+                              cached.use);
+        return *cached.field;
+    }
+
+    FlowField *field;
+    if (mFlowFields.size() >= maxFlowFields)
+    {
+        // Reuse the field used the longest ago
+        FlowFields::iterator oldest = mFlowFields.find(mFlowFieldUses.back());
+        field = oldest->second.field;
+        mFlowFields.erase(oldest);
+        mFlowFieldUses.pop_back();
+    }
+    else if (mFreeFlowFields.empty())
+    {
+        field = new FlowField;
+    }
+    else
+    {
+        field = mFreeFlowFields.back();
+        mFreeFlowFields.pop_back();
+    }
+
+    field->compute(this, x, y, walkmask, range);
+
+    mFlowFieldUses.push_front(key);
+    CachedFlowField cached;
+    cached.field = field;
+    cached.use = mFlowFieldUses.begin();
+    mFlowFields.insert(std::make_pair(key, cached));
+    return *field;
+}
+
+void Map::forgetFlowFields()
+{
+    for (FlowFields::iterator it = mFlowFields.begin(),
+         it_end = mFlowFields.end(); it != it_end; ++it)
+    {
+        mFreeFlowFields.push_back(it->second.field);
+    }
+    mFlowFields.clear();
+    mFlowFieldUses.clear();
+}
+
+void Map::forgetFlowFields(int x, int y)
+{
+    FlowFields::iterator it = mFlowFields.begin();
+    while (it != mFlowFields.end())
+    {
+        // A field covers the square of its range around its start
+        const FlowFieldKey &key = it->first;
+        if (std::abs(key.x - x) <= key.range &&
+            std::abs(key.y - y) <= key.range)
+        {
+            mFreeFlowFields.push_back(it->second.field);
+            mFlowFieldUses.erase(it->second.use);
+            mFlowFields.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
 Path Map::findPath(int startX, int startY,
                    int destX, int destY,
                    unsigned char walkmask, int maxCost) const
 {
-    return ::findPath(startX, startY,
-                      destX, destY,
-                      walkmask, maxCost,
-                      this);
+    if (mClusterGraph && walkmask == BLOCKMASK_WALL &&
+        contains(startX, startY) && getWalk(destX, destY) &&
+        !mClusterGraph->sameCluster(startX, startY, destX, destY))
+    {
+        std::vector<ClusterGraph::Waypoint> route;
+        if (!mClusterGraph->findRoute(startX, startY, destX, destY,
+                                      maxCost, route))
+            return Path();
+
+        // Refine the route one section at a time
+        Path path;
+        Point current(startX, startY);
+        std::vector<ClusterGraph::Waypoint>::const_iterator i, i_end;
+        for (i = route.begin(), i_end = route.end(); i != i_end; ++i)
+        {
+            if (i->tile == current)
+                continue;
+
+            const Rectangle &bounds = i->bounds;
+            FindPath &search = *::findPath.get();
+            Path section = search(current.x, current.y,
+                                  i->tile.x, i->tile.y,
+                                  walkmask, bounds.w * bounds.h * 2,
+                                  bounds, this);
+            if (section.empty())
+                break;
+
+            path.splice(path.end(), section);
+            current = i->tile;
+        }
+
+        if (i == i_end)
+            return path;
+
+        LOG_WARN("Unable to refine the route from " << Point(startX, startY)
+                 << " to " << Point(destX, destY) << ", searching tiles.");
+    }
+
+    Rectangle bounds;
+    bounds.x = 0;
+    bounds.y = 0;
+    bounds.w = mWidth;
+    bounds.h = mHeight;
+
+    return (*::findPath.get())(startX, startY,
+                               destX, destY,
+                               walkmask, maxCost,
+                               bounds, this);
 }
 
 Path FindPath::operator() (int startX, int startY,
                            int destX, int destY,
                            unsigned char walkmask, int maxCost,
+                           const Rectangle &bounds,
                            const Map *map)
 {
     // Basic cost for moving from one tile to another.
@@ -262,8 +444,9 @@ Path FindPath::operator() (int startX, int startY,
                 int y = curr.y + dy;
 
                 // Skip if if we're checking the same tile we're leaving from,
-                // or if the new location falls outside of the map boundaries
-                if ((dx == 0 && dy == 0) || !map->contains(x, y))
+                // or if the new location falls outside of the searched area
+                if ((dx == 0 && dy == 0) || !bounds.contains(Point(x, y)) ||
+                    !map->contains(x, y))
                     continue;
 
                 PathInfo *newTile = getInfo(x, y);
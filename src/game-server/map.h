@@ -30,6 +30,9 @@
 #include "utils/point.h"
 #include "utils/string.h"
 
+class ClusterGraph;
+class FlowField;
+
 typedef std::list<Point> Path;
 typedef Path::iterator PathIterator;
 enum BlockType
@@ -190,14 +193,36 @@ class Map
         const std::vector<MapObject*> &getObjects() const
         { return mMapObjects; }
 
+        /**
+         * Divides the map into clusters of the given size in tiles, used to
+         * speed up finding long paths that are only blocked by walls.
+         */
+        void initializeClusters(int clusterSize);
+
         /**
          * Find a path from one location to the next.
+         *
+         * When clusters were initialized and only walls block the way, paths
+         * leading to other clusters are first searched between the clusters.
+         * They are then close to, but not always, the shortest.
          */
         Path findPath(int startX, int startY,
                       int destX, int destY,
                       unsigned char walkmask,
                       int maxCost = 20) const;
 
+        /**
+         * Gets the cheapest paths from a tile to the tiles within range, see
+         * FlowField. Only walls are taken into account, since the tiles
+         * occupied by beings change all the time and paths are checked
+         * against them as they are followed. Fields are kept until walls
+         * change within their range, so that beings searching from the same
+         * tile share them. When too many are kept, the one used the longest
+         * ago is forgotten.
+         */
+        const FlowField &getFlowField(int x, int y,
+                                      unsigned char walkmask, int range);
+
         /**
          * Blockmasks for different entities
          */
@@ -206,6 +231,40 @@ class Map
         static const unsigned char BLOCKMASK_MONSTER = 0x02;  // = bin 0000 0010
 
     private:
+        /**
+         * Identifies the start and limits of a cached flow field.
+         */
+        struct FlowFieldKey
+        {
+            int x, y;
+            unsigned char walkmask;
+            int range;
+
+            bool operator< (const FlowFieldKey &other) const;
+        };
+
+        /**
+         * A cached flow field, with its place in the order of use.
+         */
+        struct CachedFlowField
+        {
+            FlowField *field;
+            std::list<FlowFieldKey>::iterator use;
+        };
+
+        typedef std::map<FlowFieldKey, CachedFlowField> FlowFields;
+
+        /**
+         * Forgets all the flow fields.
+         */
+        void forgetFlowFields();
+
+        /**
+         * Forgets the flow fields that reach a tile of which the walls
+         * changed.
+         */
+        void forgetFlowFields(int x, int y);
+
         // map properties
         int mWidth, mHeight;
         int mTileWidth, mTileHeight;
@@ -213,6 +272,12 @@ class Map
 
         std::vector<MetaTile> mMetaTiles;
         std::vector<MapObject*> mMapObjects;
+
+        ClusterGraph *mClusterGraph;
+
+        FlowFields mFlowFields;
+        std::list<FlowFieldKey> mFlowFieldUses;   /**< Most recent first */
+        std::vector<FlowField *> mFreeFlowFields; /**< Unused storage */
 };
 
 #endif
@@ -32,28 +32,35 @@
 #include "game-server/mapreader.h"
 #include "game-server/monstermanager.h"
 #include "game-server/spawnarea.h"
+#include "game-server/state.h"
 #include "game-server/trigger.h"
 #include "scripting/script.h"
 #include "scripting/scriptmanager.h"
 #include "utils/logger.h"
 #include "utils/point.h"
 
-/* TODO: Implement overlapping map zones instead of strict partitioning.
-   Purpose: to decrease the number of zone changes, as overlapping allows for
-   hysteresis effect and prevents an actor from changing zone each server
-   tick. It requires storing the zone in the actor since it will not be
-   uniquely defined any longer. */
-
-/* Pixel-based width and height of the squares used in partitioning the map.
-   Squares should be big enough so that an actor cannot cross several ones
-   in one world tick.
-   TODO: Tune for decreasing server load. The higher the value, the closer we
+/* Default pixel-based width and height of the squares used in partitioning
+   the map. Squares should be big enough so that an actor cannot cross
+   several ones in one world tick. The higher the value, the closer we
    regress to quadratic behavior; the lower the value, the more we waste time
-   in dealing with zone changes. */
-static int const zoneDiam = 256;
+   in dealing with zone changes.
+   Zones overlap by a margin: an actor only changes zone once it is further
+   away from its zone than that, which keeps actors walking along a border
+   from changing zone each server tick. */
+static int const defaultZoneSize = 256;
+static int const defaultZoneMargin = 32;
 
 void MapZone::insert(Actor *obj)
 {
+    if (obj->canMove())
+    {
+        for (std::vector< Entity * >::const_iterator i = watchers.begin(),
+             i_end = watchers.end(); i != i_end; ++i)
+        {
+            (*i)->wake();
+        }
+    }
+
     int type = obj->getType();
     switch (type)
     {
@@ -344,8 +351,8 @@ void ObjectBucket::deallocate(int i)
  * MapContent
  *****************************************************************************/
 
-MapContent::MapContent(Map *map)
-  : last_bucket(0), zones(NULL)
+MapContent::MapContent(Map *map, int zoneSize, int zoneMargin)
+  : last_bucket(0), zones(NULL), zoneSize(zoneSize), zoneMargin(zoneMargin)
 {
     buckets[0] = new ObjectBucket;
     buckets[0]->allocate(); // Skip ID 0
@@ -353,10 +360,10 @@ MapContent::MapContent(Map *map)
     {
         buckets[i] = NULL;
     }
-    mapWidth = (map->getWidth() * map->getTileWidth() + zoneDiam - 1)
-               / zoneDiam;
-    mapHeight = (map->getHeight() * map->getTileHeight() + zoneDiam - 1)
-                / zoneDiam;
+    mapWidth = (map->getWidth() * map->getTileWidth() + zoneSize - 1)
+               / zoneSize;
+    mapHeight = (map->getHeight() * map->getTileHeight() + zoneSize - 1)
+                / zoneSize;
     zones = new MapZone[mapWidth * mapHeight];
 }
 
@@ -418,10 +425,13 @@ void MapContent::deallocate(Actor *obj)
 
 void MapContent::fillRegion(MapRegion &r, const Point &p, int radius) const
 {
-    int ax = p.x > radius ? (p.x - radius) / zoneDiam : 0,
-        ay = p.y > radius ? (p.y - radius) / zoneDiam : 0,
-        bx = std::min((p.x + radius) / zoneDiam, mapWidth - 1),
-        by = std::min((p.y + radius) / zoneDiam, mapHeight - 1);
+    // Actors of a zone may be up to the margin away from it
+    radius += zoneMargin;
+
+    int ax = p.x > radius ? (p.x - radius) / zoneSize : 0,
+        ay = p.y > radius ? (p.y - radius) / zoneSize : 0,
+        bx = std::min((p.x + radius) / zoneSize, mapWidth - 1),
+        by = std::min((p.y + radius) / zoneSize, mapHeight - 1);
     for (int y = ay; y <= by; ++y)
     {
         for (int x = ax; x <= bx; ++x)
@@ -429,14 +439,17 @@ void MapContent::fillRegion(MapRegion &r, const Point &p, int radius) const
             addZone(r, x + y * mapWidth);
         }
     }
+
+    ++statistics.regions;
+    statistics.regionZones += (bx - ax + 1) * (by - ay + 1);
 }
 
 void MapContent::fillRegion(MapRegion &r, const Rectangle &p) const
 {
-    int ax = p.x / zoneDiam,
-        ay = p.y / zoneDiam,
-        bx = std::min((p.x + p.w) / zoneDiam, mapWidth - 1),
-        by = std::min((p.y + p.h) / zoneDiam, mapHeight - 1);
+    int ax = p.x > zoneMargin ? (p.x - zoneMargin) / zoneSize : 0,
+        ay = p.y > zoneMargin ? (p.y - zoneMargin) / zoneSize : 0,
+        bx = std::min((p.x + p.w + zoneMargin) / zoneSize, mapWidth - 1),
+        by = std::min((p.y + p.h + zoneMargin) / zoneSize, mapHeight - 1);
     for (int y = ay; y <= by; ++y)
     {
         for (int x = ax; x <= bx; ++x)
@@ -444,11 +457,22 @@ void MapContent::fillRegion(MapRegion &r, const Rectangle &p) const
             addZone(r, x + y * mapWidth);
         }
     }
+
+    ++statistics.regions;
+    statistics.regionZones += (bx - ax + 1) * (by - ay + 1);
+}
+
+unsigned MapContent::getZoneIndex(const Point &pos) const
+{
+    return (pos.x / zoneSize) + (pos.y / zoneSize) * mapWidth;
 }
 
-MapZone& MapContent::getZone(const Point &pos) const
+bool MapContent::isInZone(unsigned zone, const Point &pos) const
 {
-    return zones[(pos.x / zoneDiam) + (pos.y / zoneDiam) * mapWidth];
+    const int x = (zone % mapWidth) * zoneSize,
+              y = (zone / mapWidth) * zoneSize;
+    return pos.x >= x - zoneMargin && pos.x < x + zoneSize + zoneMargin &&
+           pos.y >= y - zoneMargin && pos.y < y + zoneSize + zoneMargin;
 }
 
 
@@ -463,7 +487,9 @@ MapComposite::MapComposite(int id, const std::string &name):
     mMap(NULL),
     mContent(NULL),
     mName(name),
-    mID(id)
+    mID(id),
+    mTimingWheel(GameState::getCurrentTick()),
+    mWakeMargin(0)
 {
 }
 
@@ -485,6 +511,17 @@ bool MapComposite::activate()
     if (!mMap)
         return false;
 
+    if (Configuration::getBoolValue("game_hierarchicalPathfinding", false))
+    {
+        const int clusterSize =
+                Configuration::getValue("game_pathClusterSize", 16);
+        mMap->initializeClusters(std::max(clusterSize, 4));
+    }
+
+    // Timers are only scheduled once the map is active, which may be long
+    // after it was created: the wheel skips the ticks before this one
+    mTimingWheel.advance(GameState::getCurrentTick() - 1);
+
     initializeContent();
 
     std::string sPvP = mMap->getProperty("pvp");
@@ -567,16 +604,34 @@ bool MapComposite::insert(Entity *ptr)
         }
 
         Actor *obj = static_cast< Actor * >(ptr);
-        mContent->getZone(obj->getPosition()).insert(obj);
+        unsigned zone = mContent->getZoneIndex(obj->getPosition());
+        mContent->zones[zone].insert(obj);
+        obj->setZoneIndex(zone);
     }
 
     ptr->setMap(this);
     mContent->entities.push_back(ptr);
+
+    // Entities are woken on insertion, since what put them to sleep may no
+    // longer hold here; update() lets them go back to sleep
+    ptr->mSchedule = Entity::SLEEPING;
+    ptr->wake();
+
+    if (ptr->getType() == OBJECT_CHARACTER)
+        wakeAround(static_cast< Actor * >(ptr)->getPosition());
+
     return true;
 }
 
 void MapComposite::remove(Entity *ptr)
 {
+    if (ptr->mSchedule == Entity::ACTIVE)
+    {
+        std::vector< Entity * > &active = mContent->activeEntities;
+        active.erase(std::find(active.begin(), active.end(), ptr));
+    }
+    ptr->mSchedule = Entity::UNSCHEDULED;
+
     for (std::vector<Entity*>::iterator i = mContent->entities.begin(),
          i_end = mContent->entities.end(); i != i_end; ++i)
     {
@@ -597,7 +652,7 @@ void MapComposite::remove(Entity *ptr)
     if (ptr->isVisible())
     {
         Actor *obj = static_cast< Actor * >(ptr);
-        mContent->getZone(obj->getPosition()).remove(obj);
+        mContent->zones[obj->getZoneIndex()].remove(obj);
 
         if (ptr->canMove())
         {
@@ -608,13 +663,26 @@ void MapComposite::remove(Entity *ptr)
 
 void MapComposite::update()
 {
-    // Update object status
-    const std::vector< Entity * > &entities = getEverything();
-    for (std::vector< Entity * >::const_iterator it = entities.begin(),
-         it_end = entities.end(); it != it_end; ++it)
+    // Call back the timers due
+    mTimingWheel.advance(GameState::getCurrentTick());
+
+    // Update the entities that are awake, and leave out those that sleep.
+    // Entities woken up meanwhile are added at the end, for the next tick.
+    std::vector< Entity * > &active = mContent->activeEntities;
+    const unsigned count = active.size();
+    unsigned kept = 0;
+    for (unsigned i = 0; i < count; ++i)
     {
-        (*it)->update();
+        Entity *entity = active[i];
+        if (entity->isAwake())
+            entity->update();
+
+        if (entity->isAwake())
+            active[kept++] = entity;
+        else
+            entity->mSchedule = Entity::SLEEPING;
     }
+    active.erase(active.begin() + kept, active.begin() + count);
 
     if (mUpdateCallback.isValid())
     {
@@ -634,6 +702,7 @@ void MapComposite::update()
     for (int i = 0; i < mContent->mapHeight * mContent->mapWidth; ++i)
     {
         mContent->zones[i].destinations.clear();
+        mContent->zones[i].movedBeings.clear();
     }
 
     // Cannot use a WholeMap iterator as objects will change zones under its feet.
@@ -648,22 +717,91 @@ void MapComposite::update()
         const Point &pos1 = obj->getOldPosition(),
                     &pos2 = obj->getPosition();
 
-        MapZone &src = mContent->getZone(pos1),
-                &dst = mContent->getZone(pos2);
-        if (&src != &dst)
+        unsigned zone = obj->getZoneIndex();
+        if (!mContent->isInZone(zone, pos2))
         {
-            addZone(src.destinations, &dst - mContent->zones);
+            const unsigned dstZone = mContent->getZoneIndex(pos2);
+            MapZone &src = mContent->zones[zone],
+                    &dst = mContent->zones[dstZone];
+            addZone(src.destinations, dstZone);
             src.remove(obj);
             dst.insert(obj);
+            obj->setZoneIndex(dstZone);
+            zone = dstZone;
+            ++mContent->statistics.zoneChanges;
+
+            // Characters wake the beings they come close to, and sleeping
+            // beings that moved have to look around again
+            if (obj->getType() == OBJECT_CHARACTER)
+                wakeAround(pos2);
+            else
+                obj->wake();
         }
+
+        if (pos1 != pos2 || (obj->getUpdateFlags() & UPDATEFLAG_NEW_ON_MAP))
+            mContent->zones[zone].movedBeings.push_back(obj);
     }
 }
 
+const ZoneStatistics &MapComposite::getZoneStatistics() const
+{
+    return mContent->statistics;
+}
+
 const std::vector< Entity * > &MapComposite::getEverything() const
 {
     return mContent->entities;
 }
 
+unsigned MapComposite::getActiveEntityCount() const
+{
+    return mContent->activeEntities.size();
+}
+
+void MapComposite::activate(Entity *ptr)
+{
+    assert(ptr->mSchedule == Entity::SLEEPING);
+    mContent->activeEntities.push_back(ptr);
+    ptr->mSchedule = Entity::ACTIVE;
+}
+
+void MapComposite::addZoneWatcher(Entity *ptr, const Rectangle &rect)
+{
+    MapRegion r;
+    mContent->fillRegion(r, rect);
+    for (MapRegion::iterator i = r.begin(), i_end = r.end(); i != i_end; ++i)
+        mContent->zones[*i].watchers.push_back(ptr);
+}
+
+void MapComposite::removeZoneWatcher(Entity *ptr, const Rectangle &rect)
+{
+    MapRegion r;
+    mContent->fillRegion(r, rect);
+    for (MapRegion::iterator i = r.begin(), i_end = r.end(); i != i_end; ++i)
+    {
+        std::vector< Entity * > &watchers = mContent->zones[*i].watchers;
+        watchers.erase(std::remove(watchers.begin(), watchers.end(), ptr),
+                       watchers.end());
+    }
+}
+
+int MapComposite::getWakeRange() const
+{
+    return GameState::visualRangeOption + mWakeMargin;
+}
+
+bool MapComposite::hasCharactersAround(const Point &p) const
+{
+    CharacterIterator i(getAroundPointIterator(p, getWakeRange()));
+    return i;
+}
+
+void MapComposite::wakeAround(const Point &p)
+{
+    for (BeingIterator i(getAroundPointIterator(p, getWakeRange())); i; ++i)
+        (*i)->wake();
+}
+
 
 std::string MapComposite::getVariable(const std::string &key) const
 {
@@ -728,7 +866,24 @@ void MapComposite::callWorldVariableCallback(const std::string &key,
  */
 void MapComposite::initializeContent()
 {
-    mContent = new MapContent(mMap);
+    // Zones can be sized per map, as it depends on how crowded it gets
+    int zoneSize = utils::stringToInt(mMap->getProperty("zonesize"));
+    if (zoneSize <= 0)
+        zoneSize = Configuration::getValue("game_zoneSize", defaultZoneSize);
+
+    const std::string margin = mMap->getProperty("zonemargin");
+    int zoneMargin = margin.empty() ?
+            Configuration::getValue("game_zoneMargin", defaultZoneMargin) :
+            utils::stringToInt(margin);
+
+    zoneSize = std::max(zoneSize, 32);
+    zoneMargin = std::max(0, std::min(zoneMargin, zoneSize / 2));
+
+    mContent = new MapContent(mMap, zoneSize, zoneMargin);
+
+    // Beyond the visual range, allow for the zones that searches round up
+    // to, and for the distance beings move within their zone while asleep
+    mWakeMargin = 2 * (zoneSize + 2 * zoneMargin);
 
     const std::vector<MapObject*> &objects = mMap->getObjects();
 
@@ -26,6 +26,8 @@
 #include <vector>
 #include <map>
 
+#include "game-server/tickprofiler.h"
+#include "game-server/timingwheel.h"
 #include "scripting/script.h"
 
 class Actor;
@@ -148,6 +150,18 @@ struct MapZone
      */
     MapRegion destinations;
 
+    /**
+     * Beings that moved to a position inside this zone or appeared in it
+     * during the last update. Used to find the beings that may have come
+     * into sight of characters that did not move.
+     */
+    std::vector< Being * > movedBeings;
+
+    /**
+     * Entities to wake up when a being comes in this zone.
+     */
+    std::vector< Entity * > watchers;
+
     MapZone(): nbCharacters(0), nbMovingObjects(0) {}
     void insert(Actor *);
     void remove(Actor *);
@@ -171,12 +185,28 @@ struct ObjectBucket
     void deallocate(int);
 };
 
+/**
+ * Counters about the zones of a map.
+ */
+struct ZoneStatistics
+{
+    ZoneStatistics(): zoneChanges(0), regions(0), regionZones(0) {}
+
+    unsigned zoneChanges;   /**< Actors that moved to another zone. */
+    unsigned regions;       /**< Regions filled for iterators. */
+    unsigned regionZones;   /**< Zones in these regions. */
+};
+
 /**
  * Entities on a map.
  */
 struct MapContent
 {
-    MapContent(Map *);
+    /**
+     * Divides the map into zones of the given size in pixels. Actors stay
+     * in their zone until they are further than the margin away from it.
+     */
+    MapContent(Map *, int zoneSize, int zoneMargin);
     ~MapContent();
 
     /**
@@ -200,15 +230,26 @@ struct MapContent
     void fillRegion(MapRegion &, const Rectangle &) const;
 
     /**
-     * Gets zone at given position.
+     * Gets the index of the zone at given position.
+     */
+    unsigned getZoneIndex(const Point &pos) const;
+
+    /**
+     * Tells whether an actor at the given position may stay in a zone.
      */
-    MapZone &getZone(const Point &pos) const;
+    bool isInZone(unsigned zone, const Point &pos) const;
 
     /**
      * Entities (items, characters, monsters, etc) located on the map.
      */
     std::vector< Entity * > entities;
 
+    /**
+     * Entities updated each tick. Those put to sleep are left out by the
+     * next update.
+     */
+    std::vector< Entity * > activeEntities;
+
     /**
      * Buckets of MovingObjects located on the map, referenced by ID.
      */
@@ -223,6 +264,11 @@ struct MapContent
 
     unsigned short mapWidth;  /**< Width with respect to zones. */
     unsigned short mapHeight; /**< Height with respect to zones. */
+
+    int zoneSize;             /**< Width and height of a zone in pixels. */
+    int zoneMargin;           /**< Distance actors may leave their zone. */
+
+    mutable ZoneStatistics statistics;
 };
 
 /**
@@ -282,6 +328,23 @@ class MapComposite
          */
         void update();
 
+        /**
+         * Gets the counters about the zones of the map.
+         */
+        const ZoneStatistics &getZoneStatistics() const;
+
+        /**
+         * Gets the times spent updating the map and informing its players.
+         */
+        TickProfiler::MapTimes &getTimes()
+        { return mTimes; }
+
+        /**
+         * Gets the wheel calling back the timers of the entities on the map.
+         */
+        TimingWheel &getTimingWheel()
+        { return mTimingWheel; }
+
         /**
          * Gets the PvP rules on the map.
          */
@@ -319,6 +382,33 @@ class MapComposite
          */
         const std::vector< Entity * > &getEverything() const;
 
+        /**
+         * Gets the number of entities updated each tick, the others are
+         * sleeping.
+         */
+        unsigned getActiveEntityCount() const;
+
+        /**
+         * Adds a sleeping entity to those updated each tick. Called when the
+         * entity is woken up.
+         */
+        void activate(Entity *);
+
+        /**
+         * Wakes an entity up whenever a being comes in the zones of a
+         * rectangle, so that it can sleep while nobody is there.
+         */
+        void addZoneWatcher(Entity *, const Rectangle &);
+        void removeZoneWatcher(Entity *, const Rectangle &);
+
+        /**
+         * Returns whether a character is close enough to a point to be
+         * noticed from there, allowing for the zones the search rounds up
+         * to. Beings may sleep when this is not the case, since they are
+         * woken up by the characters coming this close.
+         */
+        bool hasCharactersAround(const Point &) const;
+
         /**
          * Gets the cached value of a map-bound script variable
          */
@@ -363,6 +453,17 @@ class MapComposite
         MapComposite(const MapComposite &);
 
         void initializeContent();
+
+        /**
+         * Wakes up the beings a character came close to.
+         */
+        void wakeAround(const Point &);
+
+        /**
+         * Gets the distance at which characters wake beings, following the
+         * visual range as it is reloaded.
+         */
+        int getWakeRange() const;
         void callMapVariableCallback(const std::string &key,
                                      const std::string &value);
 
@@ -375,6 +476,9 @@ class MapComposite
         PvPRules mPvPRules;
         std::map<const std::string, Script::Ref> mMapVariableCallbacks;
         std::map<const std::string, Script::Ref> mWorldVariableCallbacks;
+        TickProfiler::MapTimes mTimes;
+        TimingWheel mTimingWheel;
+        int mWakeMargin;      /**< Added to the visual range to wake beings. */
 
         static Script::Ref mInitializeCallback;
         static Script::Ref mUpdateCallback;
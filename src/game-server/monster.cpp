@@ -25,6 +25,7 @@
 #include "game-server/attributemanager.h"
 #include "game-server/character.h"
 #include "game-server/collisiondetection.h"
+#include "game-server/flowfield.h"
 #include "game-server/item.h"
 #include "game-server/map.h"
 #include "game-server/mapcomposite.h"
@@ -47,12 +48,17 @@ struct MonsterTargetEventDispatch: EventDispatch
 
 static MonsterTargetEventDispatch monsterTargetEventDispatch;
 
+static utils::ObjectPool monsterPool(sizeof(Monster));
+
 Monster::Monster(MonsterClass *specy):
     Being(OBJECT_MONSTER),
     mSpecy(specy),
     mTargetListener(&monsterTargetEventDispatch),
     mOwner(NULL),
-    mCurrentAttack(NULL)
+    mCurrentAttack(NULL),
+    mStrollTimer(this),
+    mOwnerTimer(this),
+    mDecayTimer(this)
 {
     LOG_DEBUG("Monster spawned! (id: " << mSpecy->getId() << ").");
 
@@ -108,6 +114,21 @@ Monster::Monster(MonsterClass *specy):
     loadScript(specy->getScript());
 }
 
+void *Monster::operator new(size_t size)
+{
+    return monsterPool.allocate(size);
+}
+
+void Monster::operator delete(void *object, size_t size)
+{
+    monsterPool.release(object, size);
+}
+
+const utils::ObjectPool::Statistics &Monster::getPoolStatistics()
+{
+    return monsterPool.getStatistics();
+}
+
 Monster::~Monster()
 {
     // Remove death listeners.
@@ -122,15 +143,10 @@ void Monster::update()
 {
     Being::update();
 
-    if (mKillStealProtectedTimeout.justFinished())
-        mOwner = NULL;
-
-    // If dead, remove it
+    // If dead, wait for mDecayTimer to remove it
     if (mAction == DEAD)
     {
-        if (mDecayTimeout.expired())
-            GameState::enqueueRemove(this);
-
+        sleep();
         return;
     }
 
@@ -149,32 +165,71 @@ void Monster::update()
 
     refreshTarget();
 
-    if (!mTarget)
+    if (mAction == ATTACK)
+        processAttack();
+    else if (!mTarget && mStatus.empty()
+             && !mSpecy->getUpdateCallback().isValid()
+             && !getMap()->hasCharactersAround(getPosition()))
     {
-        // We have no target - let's wander around
-        if (mStrollTimeout.expired() && getPosition() == getDestination())
+        // Strolling goes on through mStrollTimer, and the map wakes the
+        // monster up when a character comes close
+        sleep();
+    }
+}
+
+void Monster::stroll()
+{
+    if (mAction == DEAD)
+        return;
+
+    // Wander around when we have no target and are not walking yet
+    if (!mTarget && !mOwner && getPosition() == getDestination())
+    {
+        unsigned range = mSpecy->getStrollRange();
+        if (range)
         {
-            if (mKillStealProtectedTimeout.expired())
-            {
-                unsigned range = mSpecy->getStrollRange();
-                if (range)
-                {
-                    Point randomPos(rand() % (range * 2 + 1)
-                                    - range + getPosition().x,
-                                    rand() % (range * 2 + 1)
-                                    - range + getPosition().y);
-                    // Don't allow negative destinations, to avoid rounding
-                    // problems when divided by tile size
-                    if (randomPos.x >= 0 && randomPos.y >= 0)
-                        setDestination(randomPos);
-                }
-                mStrollTimeout.set(10 + rand() % 10);
-            }
+            Point randomPos(rand() % (range * 2 + 1)
+                            - range + getPosition().x,
+                            rand() % (range * 2 + 1)
+                            - range + getPosition().y);
+            // Don't allow negative destinations, to avoid rounding
+            // problems when divided by tile size
+            if (randomPos.x >= 0 && randomPos.y >= 0)
+                setDestination(randomPos);
         }
     }
 
-    if (mAction == ATTACK)
-        processAttack();
+    schedule(mStrollTimer, GameState::getCurrentTick() + 10 + rand() % 10);
+}
+
+void Monster::releaseOwner()
+{
+    mOwner = NULL;
+}
+
+void Monster::decay()
+{
+    GameState::enqueueRemove(this);
+}
+
+void Monster::inserted()
+{
+    Being::inserted();
+
+    if (mAction == DEAD)
+        schedule(mDecayTimer, GameState::getCurrentTick() + DECAY_TIME);
+    else
+        schedule(mStrollTimer, GameState::getCurrentTick());
+}
+
+void Monster::removed()
+{
+    mStrollTimer.cancel();
+    mOwnerTimer.cancel();
+    mDecayTimer.cancel();
+    mOwner = NULL;
+
+    Being::removed();
 }
 
 void Monster::refreshTarget()
@@ -185,8 +240,11 @@ void Monster::refreshTarget()
     Point bestAttackPosition;
     BeingDirection bestAttackDirection = DOWN;
 
+    // Paths to the attack positions are all looked up in the same field
+    const FlowField *field = 0;
+
     // Iterate through objects nearby
-    int aroundArea = Configuration::getValue("game_visualRange", 448);
+    int aroundArea = GameState::visualRangeOption;
     for (BeingIterator i(getMap()->getAroundBeingIterator(this, aroundArea));
          i; ++i)
     {
@@ -217,6 +275,15 @@ void Monster::refreshTarget()
             continue;
         }
 
+        if (!field)
+        {
+            Map *map = getMap()->getMap();
+            field = &map->getFlowField(getPosition().x / map->getTileWidth(),
+                                       getPosition().y / map->getTileHeight(),
+                                       getWalkMask(),
+                                       mSpecy->getTrackRange());
+        }
+
         // Check all attack positions
         for (std::list<AttackPosition>::iterator j = mAttackPositions.begin();
              j != mAttackPositions.end(); j++)
@@ -225,7 +292,8 @@ void Monster::refreshTarget()
             attackPosition.x += j->x;
             attackPosition.y += j->y;
 
-            int posPriority = calculatePositionPriority(attackPosition,
+            int posPriority = calculatePositionPriority(*field,
+                                                        attackPosition,
                                                         targetPriority);
             if (posPriority > bestTargetPriority)
             {
@@ -343,36 +411,28 @@ void Monster::loadScript(const std::string &scriptName)
     }
 }
 
-int Monster::calculatePositionPriority(Point position, int targetPriority)
+int Monster::calculatePositionPriority(const FlowField &field,
+                                       Point position, int targetPriority)
 {
-    Point thisPos = getPosition();
-
     unsigned range = mSpecy->getTrackRange();
 
     Map *map = getMap()->getMap();
-    int tileWidth = map->getTileWidth();
-    int tileHeight = map->getTileHeight();
+    const int tileX = position.x / map->getTileWidth();
+    const int tileY = position.y / map->getTileHeight();
 
-    // Check if we already are on this position
-    if (thisPos.x / tileWidth == position.x / tileWidth &&
-        thisPos.y / tileHeight == position.y / tileHeight)
-    {
-        return targetPriority *= range;
-    }
+    // The field only knows about walls, so skip the tiles taken by beings
+    if (!map->getWalk(tileX, tileY, getWalkMask()))
+        return 0;
 
-    Path path;
-    path = map->findPath(thisPos.x / tileWidth, thisPos.y / tileHeight,
-                         position.x / tileWidth, position.y / tileHeight,
-                         getWalkMask(),
-                         range);
+    int steps = field.getSteps(tileX, tileY);
 
-    if (path.empty() || path.size() >= range)
+    if (steps < 0 || (unsigned) steps >= range)
     {
         return 0;
     }
     else
     {
-        return targetPriority * (range - path.size());
+        return targetPriority * (range - steps);
     }
 }
 
@@ -405,6 +465,9 @@ void Monster::changeAnger(Actor *target, int amount)
             mAnger[t] = amount;
             t->addListener(&mTargetListener);
         }
+
+        // Look for the target again
+        wake();
     }
 }
 
@@ -421,12 +484,13 @@ int Monster::damage(Actor *source, const Damage &damage)
         Character *s = static_cast< Character * >(source);
 
         mExpReceivers[s].insert(damage.skill);
-        if (mKillStealProtectedTimeout.expired() || mOwner == s
+        if (!mOwner || mOwner == s
             || mOwner->getParty() == s->getParty())
         {
             mOwner = s;
             mLegalExpReceivers.insert(s);
-            mKillStealProtectedTimeout.set(KILLSTEAL_PROTECTION_TIME);
+            schedule(mOwnerTimer, GameState::getCurrentTick()
+                                  + KILLSTEAL_PROTECTION_TIME);
         }
     }
 
@@ -450,7 +514,8 @@ void Monster::died()
     if (mAction == DEAD) return;
 
     Being::died();
-    mDecayTimeout.set(DECAY_TIME);
+    mStrollTimer.cancel();
+    schedule(mDecayTimer, GameState::getCurrentTick() + DECAY_TIME);
 
     if (mExpReceivers.size() > 0)
     {
@@ -25,12 +25,14 @@
 #include "game-server/eventlistener.h"
 #include "common/defines.h"
 #include "scripting/script.h"
+#include "utils/objectpool.h"
 #include "utils/string.h"
 
 #include <map>
 #include <vector>
 #include <string>
 
+class FlowField;
 class ItemClass;
 class Script;
 
@@ -286,6 +288,15 @@ class Monster : public Being
         Monster(MonsterClass *);
         ~Monster();
 
+        /**
+         * Monsters are allocated from a pool, so that spawning and killing
+         * them over and over does not fragment the heap.
+         */
+        static void *operator new(size_t size);
+        static void operator delete(void *object, size_t size);
+
+        static const utils::ObjectPool::Statistics &getPoolStatistics();
+
         /**
          * Returns monster specy.
          */
@@ -346,6 +357,16 @@ class Monster : public Being
          */
         virtual bool recalculateBaseAttribute(unsigned int);
 
+        /**
+         * Overridden in order to schedule strolling upon insertion.
+         */
+        virtual void inserted();
+
+        /**
+         * Overridden in order to cancel the timers of the monster.
+         */
+        virtual void removed();
+
     protected:
         /**
          * Returns the way the actor blocks pathfinding for other objects.
@@ -356,7 +377,23 @@ class Monster : public Being
     private:
         static const int DECAY_TIME = 50;
 
-        int calculatePositionPriority(Point position, int targetPriority);
+        int calculatePositionPriority(const FlowField &field,
+                                      Point position, int targetPriority);
+
+        /**
+         * Walks to a random location nearby, when idle.
+         */
+        void stroll();
+
+        /**
+         * Ends the kill steal protection.
+         */
+        void releaseOwner();
+
+        /**
+         * Removes the dead monster.
+         */
+        void decay();
 
         MonsterClass *mSpecy;
 
@@ -389,11 +426,11 @@ class Monster : public Being
         std::list<AttackPosition> mAttackPositions;
 
         /** Time until monster strolls to new location */
-        Timeout mStrollTimeout;
+        MemberTimer< Monster, &Monster::stroll > mStrollTimer;
         /** Kill steal protection time */
-        Timeout mKillStealProtectedTimeout;
+        MemberTimer< Monster, &Monster::releaseOwner > mOwnerTimer;
         /** Time until dead monster is removed */
-        Timeout mDecayTimeout;
+        MemberTimer< Monster, &Monster::decay > mDecayTimer;
         /** Time until monster can attack again */
         Timeout mAttackTimeout;
 
@@ -46,12 +46,18 @@ NPC::~NPC()
 void NPC::setEnabled(bool enabled)
 {
     mEnabled = enabled;
+    if (enabled)
+        wake();
 }
 
 void NPC::update()
 {
+    // Nothing to do until enabled or given an update callback
     if (!mEnabled || !mUpdateCallback.isValid())
+    {
+        sleep();
         return;
+    }
 
     Script *script = ScriptManager::currentState();
     script->prepare(mUpdateCallback);
@@ -141,4 +147,5 @@ void NPC::setUpdateCallback(Script::Ref function)
 {
     ScriptManager::currentState()->unref(mUpdateCallback);
     mUpdateCallback = function;
+    wake();
 }
@@ -0,0 +1,239 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/pathservice.h"
+
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "common/configuration.h"
+#include "game-server/being.h"
+#include "game-server/map.h"
+#include "game-server/mapcomposite.h"
+#include "game-server/state.h"
+#include "utils/logger.h"
+#include "utils/thread.h"
+#include "utils/workerpool.h"
+
+enum PathPriority
+{
+    PRIORITY_CHARACTER = 0,
+    PRIORITY_OTHER,
+    NB_PRIORITIES
+};
+
+/**
+ * A path asked for by a being.
+ */
+struct PathRequest
+{
+    Being *being;
+    unsigned id;
+    const Map *map;
+    Point start, dest;
+    unsigned char walkmask;
+    int tick;                   /**< Tick during which it was made. */
+};
+
+/**
+ * Searches the path of a request, possibly on a worker thread.
+ */
+class PathJob : public utils::WorkerPool::Job
+{
+    public:
+        PathJob(const PathRequest &request)
+            : request(request)
+        {}
+
+        void run()
+        {
+            path = request.map->findPath(request.start.x, request.start.y,
+                                         request.dest.x, request.dest.y,
+                                         request.walkmask);
+        }
+
+        PathRequest request;
+        Path path;
+};
+
+static bool enabled = false;
+static utils::WorkerPool *pathWorkers = 0;
+static uint64_t budget = 0;     /**< Microseconds to spend each tick. */
+static unsigned nextRequestId = 0;
+
+static std::deque< PathRequest > requests[NB_PRIORITIES];
+static PathService::Statistics statistics;
+
+/** Guards the requests made while the maps are updated in parallel. */
+static utils::Mutex requestMutex;
+
+void PathService::initialize()
+{
+    enabled = Configuration::getBoolValue("game_asyncPathfinding", false);
+    if (!enabled)
+        return;
+
+    int threads = Configuration::getValue("game_pathThreads", 1);
+    budget = Configuration::getValue("game_pathBudget", 20) * 1000;
+
+    pathWorkers = new utils::WorkerPool(std::max(threads, 1));
+    LOG_INFO("Searching paths using " << pathWorkers->getThreadCount()
+             << " threads, spending up to " << budget / 1000
+             << " ms each tick.");
+}
+
+void PathService::deinitialize()
+{
+    delete pathWorkers;
+    pathWorkers = 0;
+    enabled = false;
+
+    for (int i = 0; i < NB_PRIORITIES; ++i)
+        requests[i].clear();
+    statistics.queued = 0;
+}
+
+bool PathService::isEnabled()
+{
+    return enabled;
+}
+
+unsigned PathService::request(Being *being, const Point &start,
+                              const Point &dest)
+{
+    utils::MutexLocker lock(&requestMutex);
+    if (++nextRequestId == 0)
+        ++nextRequestId;
+
+    PathRequest request;
+    request.being = being;
+    request.id = nextRequestId;
+    request.map = being->getMap()->getMap();
+    request.start = start;
+    request.dest = dest;
+    request.walkmask = being->getWalkMask();
+    request.tick = GameState::getCurrentTick();
+
+    PathPriority priority = being->getType() == OBJECT_CHARACTER ?
+                            PRIORITY_CHARACTER : PRIORITY_OTHER;
+    requests[priority].push_back(request);
+
+    ++statistics.requests;
+    if (++statistics.queued > statistics.maxQueued)
+        statistics.maxQueued = statistics.queued;
+
+    return request.id;
+}
+
+void PathService::cancel(Being *being)
+{
+    utils::MutexLocker lock(&requestMutex);
+    for (int i = 0; i < NB_PRIORITIES; ++i)
+    {
+        std::deque< PathRequest > &queue = requests[i];
+        std::deque< PathRequest >::iterator it = queue.begin();
+        while (it != queue.end())
+        {
+            if (it->being == being)
+            {
+                it = queue.erase(it);
+                --statistics.queued;
+                ++statistics.outdated;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+}
+
+void PathService::update()
+{
+    if (!enabled || !statistics.queued)
+        return;
+
+    const uint64_t startTime = utils::getMicroseconds();
+    const unsigned batchSize = pathWorkers->getThreadCount() * 4;
+    const int tick = GameState::getCurrentTick();
+
+    std::vector< PathJob > jobs;
+    std::vector< utils::WorkerPool::Job * > batch;
+
+    // Always solve at least one batch, so that requests keep moving
+    do
+    {
+        jobs.clear();
+        for (int i = 0; i < NB_PRIORITIES && jobs.size() < batchSize; ++i)
+        {
+            std::deque< PathRequest > &queue = requests[i];
+            while (!queue.empty() && jobs.size() < batchSize)
+            {
+                const PathRequest &request = queue.front();
+                if (request.being->isWaitingForPath(request.id))
+                    jobs.push_back(PathJob(request));
+                else
+                    ++statistics.outdated;
+
+                queue.pop_front();
+                --statistics.queued;
+            }
+        }
+
+        batch.clear();
+        for (std::vector< PathJob >::iterator i = jobs.begin(),
+             i_end = jobs.end(); i != i_end; ++i)
+        {
+            batch.push_back(&*i);
+        }
+        pathWorkers->run(batch);
+
+        for (std::vector< PathJob >::iterator i = jobs.begin(),
+             i_end = jobs.end(); i != i_end; ++i)
+        {
+            const PathRequest &request = i->request;
+            ++statistics.solved;
+
+            if (!request.being->pathFound(request.id, request.map,
+                                          request.start, i->path))
+            {
+                ++statistics.outdated;
+                continue;
+            }
+
+            const unsigned latency = tick - request.tick;
+            statistics.totalLatency += latency;
+            if (latency > statistics.maxLatency)
+                statistics.maxLatency = latency;
+        }
+    }
+    while (statistics.queued &&
+           utils::getMicroseconds() - startTime < budget);
+
+    statistics.searchTime += utils::getMicroseconds() - startTime;
+    if (statistics.queued)
+        ++statistics.overBudget;
+}
+
+const PathService::Statistics &PathService::getStatistics()
+{
+    return statistics;
+}
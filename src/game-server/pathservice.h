@@ -0,0 +1,92 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef PATHSERVICE_H
+#define PATHSERVICE_H
+
+#include "utils/timer.h"
+
+class Being;
+class Point;
+
+/**
+ * Searches the paths of moving beings outside of their update. Requests made
+ * during a tick are solved at the start of the next one, characters first,
+ * on a set of threads and within a time budget. Requests left over once the
+ * budget is spent wait for the following tick.
+ */
+namespace PathService
+{
+    struct Statistics
+    {
+        Statistics():
+            requests(0), solved(0), outdated(0), queued(0), maxQueued(0),
+            maxLatency(0), totalLatency(0), searchTime(0), overBudget(0)
+        {}
+
+        unsigned requests;      /**< Requests made. */
+        unsigned solved;        /**< Paths searched. */
+        unsigned outdated;      /**< Requests no longer needed. */
+        unsigned queued;        /**< Requests waiting right now. */
+        unsigned maxQueued;     /**< Most requests ever waiting. */
+        unsigned maxLatency;    /**< Most ticks a request waited. */
+        uint64_t totalLatency;  /**< Ticks waited by all delivered paths. */
+        uint64_t searchTime;    /**< Microseconds spent searching paths. */
+        unsigned overBudget;    /**< Ticks that left requests waiting. */
+    };
+
+    /**
+     * Sets up the service as configured by the game_asyncPathfinding,
+     * game_pathThreads and game_pathBudget options.
+     */
+    void initialize();
+
+    void deinitialize();
+
+    /**
+     * Tells whether paths are searched by the service. When not, beings
+     * search their paths themselves.
+     */
+    bool isEnabled();
+
+    /**
+     * Asks for a path between two tiles of the map of a being. The being is
+     * given the path through Being::pathFound. May be called by the maps
+     * being updated in parallel.
+     *
+     * @return the identifier of the request, never 0.
+     */
+    unsigned request(Being *, const Point &start, const Point &dest);
+
+    /**
+     * Forgets the requests of a being.
+     */
+    void cancel(Being *);
+
+    /**
+     * Solves waiting requests and hands the paths to the beings.
+     * @note No update may be in progress.
+     */
+    void update();
+
+    const Statistics &getStatistics();
+}
+
+#endif // PATHSERVICE_H
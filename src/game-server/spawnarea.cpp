@@ -49,16 +49,16 @@ SpawnArea::SpawnArea(MapComposite *map,
     mMaxBeings(maxBeings),
     mSpawnRate(spawnRate),
     mNumBeings(0),
-    mNextSpawn(0)
+    mNextSpawn(0),
+    mSpawnTimer(this)
 {
 }
 
 void SpawnArea::update()
 {
-    if (mNextSpawn > 0)
-        mNextSpawn--;
+    const int tick = GameState::getCurrentTick();
 
-    if (mNextSpawn == 0 && mNumBeings < mMaxBeings && mSpawnRate > 0)
+    if (tick >= mNextSpawn && mNumBeings < mMaxBeings && mSpawnRate > 0)
     {
         MapComposite *map = getMap();
         const Map *realMap = map->getMap();
@@ -121,12 +121,17 @@ void SpawnArea::update()
         }
 
         // Predictable respawn intervals (can be randomized later)
-        mNextSpawn = (10 * 60) / mSpawnRate;
+        mNextSpawn = tick + (10 * 60) / mSpawnRate;
     }
+
+    if (mNumBeings < mMaxBeings && mSpawnRate > 0)
+        getMap()->getTimingWheel().schedule(&mSpawnTimer, mNextSpawn);
+    sleep();
 }
 
 void SpawnArea::decrease(Entity *t)
 {
     --mNumBeings;
     t->removeListener(&mSpawnedListener);
+    wake();
 }
@@ -23,6 +23,7 @@
 
 #include "game-server/eventlistener.h"
 #include "game-server/entity.h"
+#include "game-server/timingwheel.h"
 #include "utils/point.h"
 
 class Being;
@@ -38,6 +39,10 @@ class SpawnArea : public Entity
         SpawnArea(MapComposite *, MonsterClass *, const Rectangle &zone,
             int maxBeings, int spawnRate);
 
+        /**
+         * Spawns a being when it is time, then sleeps until the next one is
+         * due, or until a being is removed if the area is full.
+         */
         void update();
 
         /**
@@ -52,7 +57,9 @@ class SpawnArea : public Entity
         int mMaxBeings;    /**< Maximum population of this area. */
         int mSpawnRate;    /**< Number of beings spawning per minute. */
         int mNumBeings;    /**< Current population of this area. */
-        int mNextSpawn;    /**< The time until next being spawn. */
+        int mNextSpawn;    /**< The tick of the next being spawn. */
+        /** Wakes the area up for the next spawn. */
+        MemberTimer< Entity, &Entity::wake > mSpawnTimer;
 
         friend struct SpawnAreaEventDispatch;
 };
@@ -32,13 +32,18 @@
 #include "game-server/mapmanager.h"
 #include "game-server/monster.h"
 #include "game-server/npc.h"
+#include "game-server/pathservice.h"
+#include "game-server/tickprofiler.h"
 #include "game-server/trade.h"
+#include "net/broadcast.h"
 #include "net/messageout.h"
+#include "net/netcomputer.h"
 #include "scripting/script.h"
 #include "scripting/scriptmanager.h"
 #include "utils/logger.h"
 #include "utils/point.h"
 #include "utils/speedconv.h"
+#include "utils/workerpool.h"
 
 #include <cassert>
 
@@ -75,6 +80,28 @@ static DelayedEvents delayedEvents;
  */
 static std::map< std::string, std::string > mScriptVariables;
 
+typedef std::map< int, std::set< Character * > > PartyMembers;
+
+/**
+ * Characters in the game world by party. Characters that are not in a party
+ * are listed under party 0.
+ */
+static PartyMembers partyMembers;
+
+/**
+ * Threads updating the different maps and informing their players in
+ * parallel. Not set when the world is updated by the main thread only.
+ */
+static utils::WorkerPool *worldWorkers;
+
+/** Guards the delayed events queued while the maps are updated. */
+static utils::Mutex delayedEventsMutex;
+
+Configuration::Option< int > GameState::visualRangeOption("game_visualRange",
+                                                         448);
+Configuration::Option< int > GameState::floorItemDecayTime(
+        "game_floorItemDecayTime", 0);
+
 /**
  * Sets message fields describing character look.
  */
@@ -126,182 +153,223 @@ static void serializeLooks(Character *ch, MessageOut &msg)
 }
 
 /**
- * Informs a player of what happened around the character.
+ * Informs a player about the activities of a being it already knows about.
  */
-static void informPlayer(MapComposite *map, Character *p)
+static void informAboutChanges(Character *p, Being *o, MessageOut &damageMsg)
 {
-    MessageOut moveMsg(GPMSG_BEINGS_MOVE);
-    MessageOut damageMsg(GPMSG_BEINGS_DAMAGE);
-    const Point &pold = p->getOldPosition(), ppos = p->getPosition();
-    int pid = p->getPublicID(), pflags = p->getUpdateFlags();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
+    int oid = o->getPublicID(), oflags = o->getUpdateFlags();
 
-    // Inform client about activities of other beings near its character
-    for (BeingIterator it(map->getAroundBeingIterator(p, visualRange));
-         it; ++it)
+    // Send attack messages.
+    if ((oflags & UPDATEFLAG_ATTACK) && o != p)
     {
-        Being *o = *it;
+        MessageOut AttackMsg(GPMSG_BEING_ATTACK);
+        AttackMsg.writeInt16(oid);
+        AttackMsg.writeInt8(o->getDirection());
+        AttackMsg.writeInt8(o->getAttackId());
+        gameHandler->sendTo(p, AttackMsg);
+    }
 
-        const Point &oold = o->getOldPosition(), opos = o->getPosition();
-        int otype = o->getType();
-        int oid = o->getPublicID(), oflags = o->getUpdateFlags();
-        int flags = 0;
+    // Send action change messages.
+    if ((oflags & UPDATEFLAG_ACTIONCHANGE))
+    {
+        MessageOut ActionMsg(GPMSG_BEING_ACTION_CHANGE);
+        ActionMsg.writeInt16(oid);
+        ActionMsg.writeInt8(o->getAction());
+        gameHandler->sendTo(p, ActionMsg);
+    }
 
-        // Check if the character p and the moving object o are around.
-        bool wereInRange = pold.inRangeOf(oold, visualRange) &&
-                           !((pflags | oflags) & UPDATEFLAG_NEW_ON_MAP);
-        bool willBeInRange = ppos.inRangeOf(opos, visualRange);
+    // Send looks change messages.
+    if (oflags & UPDATEFLAG_LOOKSCHANGE)
+    {
+        MessageOut LooksMsg(GPMSG_BEING_LOOKS_CHANGE);
+        LooksMsg.writeInt16(oid);
+        Character * c = static_cast<Character * >(o);
+        serializeLooks(c, LooksMsg);
+        LooksMsg.writeInt16(c->getHairStyle());
+        LooksMsg.writeInt16(c->getHairColor());
+        LooksMsg.writeInt16(c->getGender());
+        gameHandler->sendTo(p, LooksMsg);
+    }
+
+    // Send direction change messages.
+    if (oflags & UPDATEFLAG_DIRCHANGE)
+    {
+        MessageOut DirMsg(GPMSG_BEING_DIR_CHANGE);
+        DirMsg.writeInt16(oid);
+        DirMsg.writeInt8(o->getDirection());
+        gameHandler->sendTo(p, DirMsg);
+    }
 
-        if (!wereInRange && !willBeInRange)
+    // Send damage messages.
+    if (o->canFight())
+    {
+        const Hits &hits = o->getHitsTaken();
+        for (Hits::const_iterator j = hits.begin(),
+             j_end = hits.end(); j != j_end; ++j)
         {
-            // Nothing to report: o and p are far away from each other.
-            continue;
+            damageMsg.writeInt16(oid);
+            damageMsg.writeInt16(*j);
         }
+    }
+}
 
+/**
+ * Informs a player about a being coming into sight.
+ */
+static void informAboutEnter(Character *p, Being *o)
+{
+    const Point &opos = o->getPosition();
+    int otype = o->getType();
+
+    MessageOut enterMsg(GPMSG_BEING_ENTER);
+    enterMsg.writeInt8(otype);
+    enterMsg.writeInt16(o->getPublicID());
+    enterMsg.writeInt8(o->getAction());
+    enterMsg.writeInt16(opos.x);
+    enterMsg.writeInt16(opos.y);
+    enterMsg.writeInt8(o->getDirection());
+    switch (otype)
+    {
+        case OBJECT_CHARACTER:
+        {
+            Character *q = static_cast< Character * >(o);
+            enterMsg.writeString(q->getName());
+            enterMsg.writeInt8(q->getHairStyle());
+            enterMsg.writeInt8(q->getHairColor());
+            enterMsg.writeInt8(q->getGender());
+            serializeLooks(q, enterMsg);
+        } break;
 
-        if (wereInRange && willBeInRange)
+        case OBJECT_MONSTER:
         {
-            // Send attack messages.
-            if ((oflags & UPDATEFLAG_ATTACK) && oid != pid)
-            {
-                MessageOut AttackMsg(GPMSG_BEING_ATTACK);
-                AttackMsg.writeInt16(oid);
-                AttackMsg.writeInt8(o->getDirection());
-                AttackMsg.writeInt8(static_cast< Being * >(o)->getAttackId());
-                gameHandler->sendTo(p, AttackMsg);
-            }
+            Monster *q = static_cast< Monster * >(o);
+            enterMsg.writeInt16(q->getSpecy()->getId());
+            enterMsg.writeString(q->getName());
+            enterMsg.writeInt8(q->getGender());
+        } break;
 
-            // Send action change messages.
-            if ((oflags & UPDATEFLAG_ACTIONCHANGE))
-            {
-                MessageOut ActionMsg(GPMSG_BEING_ACTION_CHANGE);
-                ActionMsg.writeInt16(oid);
-                ActionMsg.writeInt8(static_cast< Being * >(o)->getAction());
-                gameHandler->sendTo(p, ActionMsg);
-            }
+        case OBJECT_NPC:
+        {
+            NPC *q = static_cast< NPC * >(o);
+            enterMsg.writeInt16(q->getNPC());
+            enterMsg.writeString(q->getName());
+            enterMsg.writeInt8(q->getGender());
+        } break;
 
-            // Send looks change messages.
-            if (oflags & UPDATEFLAG_LOOKSCHANGE)
-            {
-                MessageOut LooksMsg(GPMSG_BEING_LOOKS_CHANGE);
-                LooksMsg.writeInt16(oid);
-                Character * c = static_cast<Character * >(o);
-                serializeLooks(c, LooksMsg);
-                LooksMsg.writeInt16(c->getHairStyle());
-                LooksMsg.writeInt16(c->getHairColor());
-                LooksMsg.writeInt16(c->getGender());
-                gameHandler->sendTo(p, LooksMsg);
-            }
+        default:
+            assert(false); // TODO
+    }
+    gameHandler->sendTo(p, enterMsg);
+}
 
-            // Send direction change messages.
-            if (oflags & UPDATEFLAG_DIRCHANGE)
-            {
-                MessageOut DirMsg(GPMSG_BEING_DIR_CHANGE);
-                DirMsg.writeInt16(oid);
-                DirMsg.writeInt8(o->getDirection());
-                gameHandler->sendTo(p, DirMsg);
-            }
+/**
+ * Adds the movement of a being to a move message.
+ */
+static void serializeMove(Being *o, MessageOut &moveMsg)
+{
+    const Point &oold = o->getOldPosition(), opos = o->getPosition();
+    int flags = 0;
 
-            // Send damage messages.
-            if (o->canFight())
-            {
-                Being *victim = static_cast< Being * >(o);
-                const Hits &hits = victim->getHitsTaken();
-                for (Hits::const_iterator j = hits.begin(),
-                     j_end = hits.end(); j != j_end; ++j)
-                {
-                    damageMsg.writeInt16(oid);
-                    damageMsg.writeInt16(*j);
-                }
-            }
+    if (opos != oold)
+    {
+        // Add position check coords every 5 seconds.
+        if (currentTick % 50 == 0)
+            flags |= MOVING_POSITION;
 
-            if (oold == opos)
-            {
-                // o does not move, nothing more to report.
-                continue;
-            }
-        }
+        flags |= MOVING_DESTINATION;
+    }
 
-        if (!willBeInRange)
+    moveMsg.writeInt16(o->getPublicID());
+    moveMsg.writeInt8(flags);
+    if (flags & MOVING_POSITION)
+    {
+        moveMsg.writeInt16(oold.x);
+        moveMsg.writeInt16(oold.y);
+    }
+
+    if (flags & MOVING_DESTINATION)
+    {
+        moveMsg.writeInt16(opos.x);
+        moveMsg.writeInt16(opos.y);
+        // We multiply the sent speed (in tiles per second) by ten
+        // to get it within a byte with decimal precision.
+        // For instance, a value of 4.5 will be sent as 45.
+        moveMsg.writeInt8((unsigned short)
+            (o->getModifiedAttribute(ATTR_MOVE_SPEED_TPS) * 10));
+    }
+}
+
+/**
+ * Informs a player of what happened around the character.
+ */
+static void informPlayer(MapComposite *map, Character *p)
+{
+    MessageOut moveMsg(GPMSG_BEINGS_MOVE);
+    MessageOut damageMsg(GPMSG_BEINGS_DAMAGE);
+    const Point &pold = p->getOldPosition(), ppos = p->getPosition();
+    int pflags = p->getUpdateFlags();
+    int visualRange = GameState::visualRangeOption;
+
+    /* The client knows about the beings in the visible set of the character.
+       Only those need to be checked for leaving sight or for activities. */
+    std::set< Being * > &visible = p->getVisibleBeings();
+    for (std::set< Being * >::iterator it = visible.begin(),
+         it_end = visible.end(); it != it_end; )
+    {
+        Being *o = *it;
+
+        if (!ppos.inRangeOf(o->getPosition(), visualRange))
         {
             // o is no longer visible from p. Send leave message.
             MessageOut leaveMsg(GPMSG_BEING_LEAVE);
-            leaveMsg.writeInt16(oid);
+            leaveMsg.writeInt16(o->getPublicID());
             gameHandler->sendTo(p, leaveMsg);
+            visible.erase(it++);
             continue;
         }
 
-        if (!wereInRange)
-        {
-            // o is now visible by p. Send enter message.
-            MessageOut enterMsg(GPMSG_BEING_ENTER);
-            enterMsg.writeInt8(otype);
-            enterMsg.writeInt16(oid);
-            enterMsg.writeInt8(static_cast< Being *>(o)->getAction());
-            enterMsg.writeInt16(opos.x);
-            enterMsg.writeInt16(opos.y);
-            enterMsg.writeInt8(o->getDirection());
-            switch (otype)
-            {
-                case OBJECT_CHARACTER:
-                {
-                    Character *q = static_cast< Character * >(o);
-                    enterMsg.writeString(q->getName());
-                    enterMsg.writeInt8(q->getHairStyle());
-                    enterMsg.writeInt8(q->getHairColor());
-                    enterMsg.writeInt8(q->getGender());
-                    serializeLooks(q, enterMsg);
-                } break;
-
-                case OBJECT_MONSTER:
-                {
-                    Monster *q = static_cast< Monster * >(o);
-                    enterMsg.writeInt16(q->getSpecy()->getId());
-                    enterMsg.writeString(q->getName());
-                    enterMsg.writeInt8(q->getGender());
-                } break;
-
-                case OBJECT_NPC:
-                {
-                    NPC *q = static_cast< NPC * >(o);
-                    enterMsg.writeInt16(q->getNPC());
-                    enterMsg.writeString(q->getName());
-                    enterMsg.writeInt8(q->getGender());
-                } break;
-
-                default:
-                    assert(false); // TODO
-            }
-            gameHandler->sendTo(p, enterMsg);
-        }
+        informAboutChanges(p, o, damageMsg);
 
-        if (opos != oold)
-        {
-            // Add position check coords every 5 seconds.
-            if (currentTick % 50 == 0)
-                flags |= MOVING_POSITION;
+        if (o->getOldPosition() != o->getPosition())
+            serializeMove(o, moveMsg);
 
-            flags |= MOVING_DESTINATION;
-        }
+        ++it;
+    }
 
-        // Send move messages.
-        moveMsg.writeInt16(oid);
-        moveMsg.writeInt8(flags);
-        if (flags & MOVING_POSITION)
+    /* Beings can only have come into sight when either the character or the
+       beings moved. When the character did not move, only the beings that
+       moved near it need to be looked at. */
+    if (pold != ppos || (pflags & UPDATEFLAG_NEW_ON_MAP))
+    {
+        for (BeingIterator it(map->getAroundActorIterator(p, visualRange));
+             it; ++it)
         {
-            moveMsg.writeInt16(oold.x);
-            moveMsg.writeInt16(oold.y);
+            Being *o = *it;
+            if (ppos.inRangeOf(o->getPosition(), visualRange) &&
+                visible.insert(o).second)
+            {
+                informAboutEnter(p, o);
+                serializeMove(o, moveMsg);
+            }
         }
-
-        if (flags & MOVING_DESTINATION)
+    }
+    else
+    {
+        for (ZoneIterator z(map->getAroundActorIterator(p, visualRange));
+             z; ++z)
         {
-            moveMsg.writeInt16(opos.x);
-            moveMsg.writeInt16(opos.y);
-            // We multiply the sent speed (in tiles per second) by ten
-            // to get it within a byte with decimal precision.
-            // For instance, a value of 4.5 will be sent as 45.
-            moveMsg.writeInt8((unsigned short)
-                (o->getModifiedAttribute(ATTR_MOVE_SPEED_TPS) * 10));
+            const std::vector< Being * > &moved = (*z)->movedBeings;
+            for (std::vector< Being * >::const_iterator it = moved.begin(),
+                 it_end = moved.end(); it != it_end; ++it)
+            {
+                Being *o = *it;
+                if (ppos.inRangeOf(o->getPosition(), visualRange) &&
+                    visible.insert(o).second)
+                {
+                    informAboutEnter(p, o);
+                    serializeMove(o, moveMsg);
+                }
+            }
         }
     }
 
@@ -315,30 +383,6 @@ static void informPlayer(MapComposite *map, Character *p)
     // Inform client about status change.
     p->sendStatus();
 
-    // Inform client about health change of party members
-    for (CharacterIterator i(map->getWholeMapIterator()); i; ++i)
-    {
-        Character *c = *i;
-
-        // Make sure its not the same character
-        if (c == p)
-            continue;
-
-        // make sure they are in the same party
-        if (c->getParty() == p->getParty())
-        {
-            int cflags = c->getUpdateFlags();
-            if (cflags & UPDATEFLAG_HEALTHCHANGE)
-            {
-                MessageOut healthMsg(GPMSG_BEING_HEALTH_CHANGE);
-                healthMsg.writeInt16(c->getPublicID());
-                healthMsg.writeInt16(c->getModifiedAttribute(ATTR_HP));
-                healthMsg.writeInt16(c->getModifiedAttribute(ATTR_MAX_HP));
-                gameHandler->sendTo(p, healthMsg);
-            }
-        }
-    }
-
     // Inform client about items on the ground around its character
     MessageOut itemMsg(GPMSG_ITEMS);
     for (FixedActorIterator it(map->getAroundBeingIterator(p, visualRange));
@@ -412,10 +456,149 @@ static void informPlayer(MapComposite *map, Character *p)
         gameHandler->sendTo(p, itemMsg);
 }
 
+/**
+ * Informs the party members of the characters of a map about their health
+ * changes. Public IDs are only meaningful on the map they were allocated
+ * on, so the members on other maps are told by database ID instead.
+ */
+static void informPartyMembers(MapComposite *map)
+{
+    for (CharacterIterator i(map->getWholeMapIterator()); i; ++i)
+    {
+        Character *c = *i;
+        int party = c->getParty();
+        if (!party || !(c->getUpdateFlags() & UPDATEFLAG_HEALTHCHANGE))
+            continue;
+
+        PartyMembers::const_iterator members = partyMembers.find(party);
+        assert(members != partyMembers.end());
+
+        const int hp = c->getModifiedAttribute(ATTR_HP);
+        const int maxHp = c->getModifiedAttribute(ATTR_MAX_HP);
+
+        MessageOut healthMsg(GPMSG_BEING_HEALTH_CHANGE);
+        healthMsg.writeInt16(c->getPublicID());
+        healthMsg.writeInt16(hp);
+        healthMsg.writeInt16(maxHp);
+        Broadcast broadcast(healthMsg);
+
+        MessageOut memberMsg(GPMSG_PARTY_MEMBER_HEALTH);
+        memberMsg.writeInt32(c->getDatabaseID());
+        memberMsg.writeInt16(hp);
+        memberMsg.writeInt16(maxHp);
+        Broadcast memberBroadcast(memberMsg);
+
+        for (std::set< Character * >::const_iterator j =
+             members->second.begin(), j_end = members->second.end();
+             j != j_end; ++j)
+        {
+            if (*j == c)
+                continue;
+
+            if ((*j)->getMap() == map)
+                gameHandler->sendTo(*j, broadcast);
+            else
+                gameHandler->sendTo(*j, memberBroadcast);
+        }
+    }
+}
+
+/**
+ * Informs the players of a map about what happened this tick and resets the
+ * per-tick state of the actors on it.
+ *
+ * Only the map itself and the characters on it are touched, so that several
+ * maps can be handled at once when sending is deferred.
+ */
+static void informPlayers(MapComposite *map)
+{
+    for (CharacterIterator p(map->getWholeMapIterator()); p; ++p)
+    {
+        informPlayer(map, *p);
+    }
+
+    for (ActorIterator it(map->getWholeMapIterator()); it; ++it)
+    {
+        Actor *a = *it;
+        a->clearUpdateFlags();
+        if (a->canFight())
+        {
+            static_cast< Being * >(a)->clearHitsTaken();
+        }
+    }
+}
+
+/**
+ * Updates one map on a world worker thread. The calls to scripts are kept
+ * aside, to be made by the main thread once every map has been updated.
+ */
+class UpdateMapJob : public utils::WorkerPool::Job
+{
+    public:
+        UpdateMapJob(MapComposite *map)
+            : mMap(map)
+        {}
+
+        void run()
+        {
+            TickProfiler::Timer timer(mMap->getTimes().update);
+            Script::setDeferredCalls(&mScriptCalls);
+            mMap->update();
+            Script::setDeferredCalls(0);
+        }
+
+        /**
+         * Makes the calls to scripts recorded while updating the map.
+         */
+        void runScriptCalls()
+        { mScriptCalls.run(); }
+
+    private:
+        MapComposite *mMap;
+        Script::DeferredCalls mScriptCalls;
+};
+
+/**
+ * Informs the players of one map on a world worker thread.
+ */
+class InformPlayersJob : public utils::WorkerPool::Job
+{
+    public:
+        InformPlayersJob(MapComposite *map)
+            : mMap(map)
+        {}
+
+        void run()
+        {
+            TickProfiler::Timer timer(mMap->getTimes().inform);
+            informPlayers(mMap);
+        }
+
+    private:
+        MapComposite *mMap;
+};
+
 #ifndef NDEBUG
 static bool dbgLockObjects;
 #endif
 
+void GameState::initialize()
+{
+    int threads = Configuration::getValue("game_worldThreads", 1);
+    if (threads > 1)
+    {
+        worldWorkers = new utils::WorkerPool(threads);
+        LOG_INFO("Updating the world using "
+                 << worldWorkers->getThreadCount() << " threads.");
+    }
+}
+
+void GameState::deinitialize()
+{
+    delete worldWorkers;
+    worldWorkers = 0;
+}
+
 void GameState::update(int tick)
 {
     currentTick = tick;
@@ -424,40 +607,119 @@ void GameState::update(int tick)
     dbgLockObjects = true;
 #endif
 
-    ScriptManager::currentState()->update();
+    {
+        TickProfiler::Timer timer(TickProfiler::PHASE_SCRIPTS);
+        ScriptManager::currentState()->update();
+    }
+
+    // Hand out the paths asked for during the previous tick
+    {
+        TickProfiler::Timer timer(TickProfiler::PHASE_PATHS);
+        PathService::update();
+    }
 
     // Update game state (update AI, etc.)
     const MapManager::Maps &maps = MapManager::getMaps();
-    for (MapManager::Maps::const_iterator m = maps.begin(),
-         m_end = maps.end(); m != m_end; ++m)
+    uint64_t updateTime = 0;
+    uint64_t informTime = 0;
+    if (!worldWorkers)
     {
-        MapComposite *map = m->second;
-        if (!map->isActive())
-            continue;
+        for (MapManager::Maps::const_iterator m = maps.begin(),
+             m_end = maps.end(); m != m_end; ++m)
+        {
+            MapComposite *map = m->second;
+            if (!map->isActive())
+                continue;
+
+            const uint64_t start = utils::getMicroseconds();
+            map->update();
+            const uint64_t updated = utils::getMicroseconds();
+            informPartyMembers(map);
+            const uint64_t partyInformed = utils::getMicroseconds();
+            informPlayers(map);
+            const uint64_t informed = utils::getMicroseconds();
+
+            map->getTimes().update.record(updated - start);
+            map->getTimes().inform.record(informed - partyInformed);
+            updateTime += updated - start;
+            informTime += informed - updated;
+        }
+    }
+    else
+    {
+        /* The maps are updated in parallel. Meanwhile, the calls to scripts
+           are recorded, the delayed events and the changes for the account
+           server are queued, and the packets are only created. The main
+           thread then makes the calls to scripts, map by map, and sends what
+           was kept aside, before the players are informed in parallel. */
+        std::vector< UpdateMapJob > updateJobs;
+        std::vector< InformPlayersJob > informJobs;
+        for (MapManager::Maps::const_iterator m = maps.begin(),
+             m_end = maps.end(); m != m_end; ++m)
+        {
+            MapComposite *map = m->second;
+            if (!map->isActive())
+                continue;
 
-        map->update();
+            updateJobs.push_back(UpdateMapJob(map));
+            informJobs.push_back(InformPlayersJob(map));
+        }
 
-        for (CharacterIterator p(map->getWholeMapIterator()); p; ++p)
+        std::vector< utils::WorkerPool::Job * > batch;
+        batch.reserve(updateJobs.size());
+        for (std::vector< UpdateMapJob >::iterator i = updateJobs.begin(),
+             i_end = updateJobs.end(); i != i_end; ++i)
         {
-            informPlayer(map, *p);
+            batch.push_back(&*i);
         }
 
-        for (ActorIterator it(map->getWholeMapIterator()); it; ++it)
+        uint64_t start = utils::getMicroseconds();
+        NetComputer::setDeferSending(true);
+        accountHandler->setDeferSync(true);
+        worldWorkers->run(batch);
+        accountHandler->setDeferSync(false);
+        NetComputer::setDeferSending(false);
+        gameHandler->sendDeferred();
+
+        for (std::vector< UpdateMapJob >::iterator i = updateJobs.begin(),
+             i_end = updateJobs.end(); i != i_end; ++i)
         {
-            Actor *a = *it;
-            a->clearUpdateFlags();
-            if (a->canFight())
-            {
-                static_cast< Being * >(a)->clearHitsTaken();
-            }
+            i->runScriptCalls();
+        }
+        accountHandler->syncChanges();
+        updateTime = utils::getMicroseconds() - start;
+
+        start = utils::getMicroseconds();
+        for (MapManager::Maps::const_iterator m = maps.begin(),
+             m_end = maps.end(); m != m_end; ++m)
+        {
+            if (m->second->isActive())
+                informPartyMembers(m->second);
+        }
+
+        batch.clear();
+        for (std::vector< InformPlayersJob >::iterator i = informJobs.begin(),
+             i_end = informJobs.end(); i != i_end; ++i)
+        {
+            batch.push_back(&*i);
         }
+
+        NetComputer::setDeferSending(true);
+        worldWorkers->run(batch);
+        NetComputer::setDeferSending(false);
+        gameHandler->sendDeferred();
+        informTime = utils::getMicroseconds() - start;
     }
 
+    TickProfiler::record(TickProfiler::PHASE_MAPS, updateTime);
+    TickProfiler::record(TickProfiler::PHASE_INFORM, informTime);
+
 #   ifndef NDEBUG
     dbgLockObjects = false;
 #   endif
 
     // Take care of events that were delayed because of their side effects.
+    TickProfiler::Timer timer(TickProfiler::PHASE_EVENTS);
     for (DelayedEvents::iterator it = delayedEvents.begin(),
          it_end = delayedEvents.end(); it != it_end; ++it)
     {
@@ -567,15 +829,17 @@ bool GameState::insert(Entity *ptr)
     /* Since the player does not know yet where in the world its character is,
        we send a map-change message, even if it is the first time it
        connects to this server. */
+    Character *ch = static_cast< Character * >(obj);
+    partyMembers[ch->getParty()].insert(ch);
+
     MessageOut mapChangeMessage(GPMSG_PLAYER_MAP_CHANGE);
     mapChangeMessage.writeString(map->getName());
     mapChangeMessage.writeInt16(pos.x);
     mapChangeMessage.writeInt16(pos.y);
-    gameHandler->sendTo(static_cast< Character * >(obj), mapChangeMessage);
+    gameHandler->sendTo(ch, mapChangeMessage);
 
     // update the online state of the character
-    accountHandler->updateOnlineStatus(
-        static_cast< Character * >(obj)->getDatabaseID(), true);
+    accountHandler->updateOnlineStatus(ch->getDatabaseID(), true);
 
     return true;
 }
@@ -596,7 +860,7 @@ void GameState::remove(Entity *ptr)
 {
     assert(!dbgLockObjects);
     MapComposite *map = ptr->getMap();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
+    int visualRange = GameState::visualRangeOption;
 
     ptr->removed();
 
@@ -637,27 +901,39 @@ void GameState::remove(Entity *ptr)
     {
         if (ptr->getType() == OBJECT_CHARACTER)
         {
-            static_cast< Character * >(ptr)->cancelTransaction();
+            Character *ch = static_cast< Character * >(ptr);
+            ch->cancelTransaction();
 
             // remove characters online status
-            accountHandler->updateOnlineStatus(
-                static_cast< Character * >(ptr)->getDatabaseID(), false);
+            accountHandler->updateOnlineStatus(ch->getDatabaseID(), false);
+
+            PartyMembers::iterator members =
+                    partyMembers.find(ch->getParty());
+            if (members != partyMembers.end())
+            {
+                members->second.erase(ch);
+                if (members->second.empty())
+                    partyMembers.erase(members);
+            }
         }
 
-        Actor *obj = static_cast< Actor * >(ptr);
+        Being *obj = static_cast< Being * >(ptr);
         MessageOut msg(GPMSG_BEING_LEAVE);
         msg.writeInt16(obj->getPublicID());
-        Point objectPos = obj->getPosition();
+        Broadcast broadcast(msg);
 
-        for (CharacterIterator p(map->getAroundActorIterator(obj, visualRange));
-             p; ++p)
+        /* Tell the characters that know about the being, so that no
+           reference to it is left in their visible sets. */
+        for (CharacterIterator p(map->getWholeMapIterator()); p; ++p)
         {
-            if (*p != obj && objectPos.inRangeOf((*p)->getPosition(),
-                visualRange))
+            if (*p != obj && (*p)->getVisibleBeings().erase(obj))
             {
-                gameHandler->sendTo(*p, msg);
+                gameHandler->sendTo(*p, broadcast);
             }
         }
+
+        if (obj->getType() == OBJECT_CHARACTER)
+            static_cast< Character * >(obj)->getVisibleBeings().clear();
     }
     else if (ptr->getType() == OBJECT_ITEM)
     {
@@ -719,6 +995,7 @@ void GameState::warp(Character *ptr, MapComposite *map, int x, int y)
  */
 static void enqueueEvent(Actor *ptr, const DelayedEvent &e)
 {
+    utils::MutexLocker lock(&delayedEventsMutex);
     std::pair< DelayedEvents::iterator, bool > p =
         delayedEvents.insert(std::make_pair(ptr, e));
     // Delete events take precedence over other events.
@@ -754,26 +1031,30 @@ void GameState::enqueueWarp(Character *ptr, MapComposite *m, int x, int y)
     enqueueEvent(ptr, e);
 }
 
-void GameState::sayAround(Actor *obj, const std::string &text)
+void GameState::setParty(Character *ch, int party)
 {
-    Point speakerPosition = obj->getPosition();
-    int visualRange = Configuration::getValue("game_visualRange", 448);
+    int oldParty = ch->getParty();
+    if (oldParty == party)
+        return;
 
-    for (CharacterIterator i(obj->getMap()->getAroundActorIterator(obj, visualRange)); i; ++i)
-    {
-        if (speakerPosition.inRangeOf((*i)->getPosition(), visualRange))
-        {
-            sayTo(*i, obj, text);
-        }
-    }
+    ch->setParty(party);
+
+    // Characters outside of the game world are not tracked.
+    PartyMembers::iterator members = partyMembers.find(oldParty);
+    if (members == partyMembers.end() || !members->second.erase(ch))
+        return;
+
+    if (members->second.empty())
+        partyMembers.erase(members);
+    partyMembers[party].insert(ch);
 }
 
-void GameState::sayTo(Actor *destination, Actor *source, const std::string &text)
+/**
+ * Creates the message for something said by an actor.
+ */
+static void serializeSay(Actor *source, const std::string &text,
+                         MessageOut &msg)
 {
-    if (destination->getType() != OBJECT_CHARACTER)
-        return; //only characters will read it anyway
-
-    MessageOut msg(GPMSG_SAY);
     if (source == NULL)
     {
         msg.writeInt16(0);
@@ -787,6 +1068,33 @@ void GameState::sayTo(Actor *destination, Actor *source, const std::string &text
         msg.writeInt16(static_cast< Actor * >(source)->getPublicID());
     }
     msg.writeString(text);
+}
+
+void GameState::sayAround(Actor *obj, const std::string &text)
+{
+    Point speakerPosition = obj->getPosition();
+    int visualRange = GameState::visualRangeOption;
+
+    MessageOut msg(GPMSG_SAY);
+    serializeSay(obj, text, msg);
+    Broadcast broadcast(msg);
+
+    for (CharacterIterator i(obj->getMap()->getAroundActorIterator(obj, visualRange)); i; ++i)
+    {
+        if (speakerPosition.inRangeOf((*i)->getPosition(), visualRange))
+        {
+            gameHandler->sendTo(*i, broadcast);
+        }
+    }
+}
+
+void GameState::sayTo(Actor *destination, Actor *source, const std::string &text)
+{
+    if (destination->getType() != OBJECT_CHARACTER)
+        return; //only characters will read it anyway
+
+    MessageOut msg(GPMSG_SAY);
+    serializeSay(source, text, msg);
 
     gameHandler->sendTo(static_cast< Character * >(destination), msg);
 }
@@ -23,6 +23,8 @@
 
 #include <string>
 
+#include "common/configuration.h"
+
 class MapComposite;
 class Entity;
 class Actor;
@@ -31,6 +33,20 @@ class Character;
 
 namespace GameState
 {
+    /** Distance up to which characters see around them, in pixels. */
+    extern Configuration::Option< int > visualRangeOption;
+
+    /** Seconds items stay on the floor, or 0 for them to stay forever. */
+    extern Configuration::Option< int > floorItemDecayTime;
+
+    /**
+     * Sets up the threads used for updating the world, as configured by the
+     * game_worldThreads option.
+     */
+    void initialize();
+
+    void deinitialize();
+
     /**
      * Updates game state (contains core server logic).
      */
@@ -90,6 +106,12 @@ namespace GameState
      */
     void enqueueWarp(Character *, MapComposite *, int x, int y);
 
+    /**
+     * Changes the party of a character, keeping track of the members of
+     * each party in the game world.
+     */
+    void setParty(Character *, int party);
+
     /**
      * Says something to an actor.
      * @note passing NULL as source generates a message from "Server:"
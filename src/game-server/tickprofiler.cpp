@@ -0,0 +1,95 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/tickprofiler.h"
+
+#include "game-server/mapcomposite.h"
+#include "game-server/mapmanager.h"
+#include "utils/logger.h"
+
+static utils::Histogram phases[TickProfiler::NB_PHASES];
+
+static const char *phaseNames[TickProfiler::NB_PHASES] =
+{
+    "account",
+    "network",
+    "scripts",
+    "paths",
+    "maps",
+    "inform",
+    "events",
+    "flush",
+    "tick"
+};
+
+const char *TickProfiler::getPhaseName(Phase phase)
+{
+    return phaseNames[phase];
+}
+
+utils::Histogram &TickProfiler::getHistogram(Phase phase)
+{
+    return phases[phase];
+}
+
+void TickProfiler::logStatistics()
+{
+    for (int i = 0; i < NB_PHASES; ++i)
+    {
+        const utils::Histogram &times = phases[i];
+        LOG_INFO("Tick phase " << phaseNames[i] << ": p50 "
+                 << times.getPercentile(50) << " us, p99 "
+                 << times.getPercentile(99) << " us, max "
+                 << times.getMax() << " us");
+    }
+
+    const MapManager::Maps &maps = MapManager::getMaps();
+    for (MapManager::Maps::const_iterator m = maps.begin(),
+         m_end = maps.end(); m != m_end; ++m)
+    {
+        MapComposite *map = m->second;
+        if (!map->isActive())
+            continue;
+
+        const MapTimes &times = map->getTimes();
+        LOG_DEBUG("Times of map " << map->getName() << ": update p50 "
+                  << times.update.getPercentile(50) << " us, p99 "
+                  << times.update.getPercentile(99) << " us, max "
+                  << times.update.getMax() << " us; inform p50 "
+                  << times.inform.getPercentile(50) << " us, p99 "
+                  << times.inform.getPercentile(99) << " us, max "
+                  << times.inform.getMax() << " us");
+    }
+}
+
+void TickProfiler::reset()
+{
+    for (int i = 0; i < NB_PHASES; ++i)
+        phases[i].reset();
+
+    const MapManager::Maps &maps = MapManager::getMaps();
+    for (MapManager::Maps::const_iterator m = maps.begin(),
+         m_end = maps.end(); m != m_end; ++m)
+    {
+        MapTimes &times = m->second->getTimes();
+        times.update.reset();
+        times.inform.reset();
+    }
+}
@@ -0,0 +1,98 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TICKPROFILER_H
+#define TICKPROFILER_H
+
+#include "utils/histogram.h"
+#include "utils/timer.h"
+
+/**
+ * Times the phases of the world ticks, in microseconds. The times are kept
+ * in histograms, reported and forgotten every few ticks.
+ */
+namespace TickProfiler
+{
+    enum Phase
+    {
+        PHASE_ACCOUNT = 0,  /**< Messages from the account server. */
+        PHASE_NETWORK,      /**< Messages from the clients. */
+        PHASE_SCRIPTS,      /**< Update of the script state. */
+        PHASE_PATHS,        /**< Paths handed out by the PathService. */
+        PHASE_MAPS,         /**< Update of all the maps. */
+        PHASE_INFORM,       /**< Telling all players about their maps. */
+        PHASE_EVENTS,       /**< Delayed inserts, removals and warps. */
+        PHASE_FLUSH,        /**< Sending the messages to the clients. */
+        PHASE_TICK,         /**< The whole tick. */
+        NB_PHASES
+    };
+
+    /**
+     * The times spent on a single map.
+     */
+    struct MapTimes
+    {
+        utils::Histogram update;
+        utils::Histogram inform;
+    };
+
+    const char *getPhaseName(Phase);
+
+    utils::Histogram &getHistogram(Phase);
+
+    inline void record(Phase phase, uint64_t microseconds)
+    { getHistogram(phase).record(microseconds); }
+
+    /**
+     * Logs the times of the phases, and of the maps at debug level.
+     */
+    void logStatistics();
+
+    /**
+     * Forgets the times of the phases and of the maps.
+     */
+    void reset();
+
+    /**
+     * Records the time until it goes out of scope.
+     */
+    class Timer
+    {
+        public:
+            Timer(Phase phase)
+                : mHistogram(getHistogram(phase)),
+                  mStart(utils::getMicroseconds())
+            {}
+
+            Timer(utils::Histogram &histogram)
+                : mHistogram(histogram),
+                  mStart(utils::getMicroseconds())
+            {}
+
+            ~Timer()
+            { mHistogram.record(utils::getMicroseconds() - mStart); }
+
+        private:
+            utils::Histogram &mHistogram;
+            uint64_t mStart;
+    };
+}
+
+#endif // TICKPROFILER_H
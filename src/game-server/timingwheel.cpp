@@ -0,0 +1,194 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "game-server/timingwheel.h"
+
+TimingWheel::Timer::Timer():
+    mWheel(0),
+    mSlot(0),
+    mPrevious(0),
+    mNext(0),
+    mTick(0)
+{
+}
+
+TimingWheel::Timer::~Timer()
+{
+    cancel();
+}
+
+void TimingWheel::Timer::cancel()
+{
+    if (!mWheel)
+        return;
+
+    TimingWheel::unlink(this);
+    --mWheel->mSize;
+    mWheel = 0;
+}
+
+TimingWheel::TimingWheel(int tick):
+    mCurrent(tick),
+    mSize(0)
+{
+    for (int i = 0; i < ROOT_SLOTS; ++i)
+        mRoot[i] = 0;
+    for (int level = 0; level < LEVELS; ++level)
+        for (int i = 0; i < LEVEL_SLOTS; ++i)
+            mLevels[level][i] = 0;
+}
+
+TimingWheel::~TimingWheel()
+{
+    for (int i = 0; i < ROOT_SLOTS; ++i)
+        clear(&mRoot[i]);
+    for (int level = 0; level < LEVELS; ++level)
+        for (int i = 0; i < LEVEL_SLOTS; ++i)
+            clear(&mLevels[level][i]);
+}
+
+void TimingWheel::schedule(Timer *timer, int tick)
+{
+    timer->cancel();
+    timer->mWheel = this;
+    timer->mTick = tick;
+    place(timer);
+    ++mSize;
+}
+
+void TimingWheel::advance(int tick)
+{
+    while (mCurrent <= tick)
+    {
+        // Nothing to count down to, skip ahead
+        if (!mSize)
+        {
+            mCurrent = tick + 1;
+            return;
+        }
+
+        const int index = mCurrent & (ROOT_SLOTS - 1);
+
+        // Bring the timers of the next levels closer when turning around
+        if (!index)
+            cascade(0);
+
+        ++mCurrent;
+
+        // Detach the due timers, so that those scheduled by the callbacks
+        // go to the next tick
+        Timer *due = mRoot[index];
+        mRoot[index] = 0;
+        for (Timer *timer = due; timer; timer = timer->mNext)
+            timer->mSlot = &due;
+
+        while (due)
+        {
+            Timer *timer = due;
+            unlink(timer);
+            timer->mWheel = 0;
+            --mSize;
+            timer->expired();
+        }
+    }
+}
+
+void TimingWheel::place(Timer *timer)
+{
+    int tick = timer->mTick;
+    if (tick < mCurrent)
+        tick = mCurrent;
+
+    unsigned delay = tick - mCurrent;
+    if (delay > MAX_DELAY)
+    {
+        delay = MAX_DELAY;
+        tick = mCurrent + MAX_DELAY;
+    }
+
+    if (delay < ROOT_SLOTS)
+    {
+        link(timer, &mRoot[tick & (ROOT_SLOTS - 1)]);
+        return;
+    }
+
+    int shift = ROOT_BITS;
+    int level = 0;
+    while (delay >= 1u << (shift + LEVEL_BITS))
+    {
+        shift += LEVEL_BITS;
+        ++level;
+    }
+    link(timer, &mLevels[level][(tick >> shift) & (LEVEL_SLOTS - 1)]);
+}
+
+void TimingWheel::cascade(int level)
+{
+    const int index = (mCurrent >> (ROOT_BITS + level * LEVEL_BITS))
+                      & (LEVEL_SLOTS - 1);
+
+    Timer *timer = mLevels[level][index];
+    mLevels[level][index] = 0;
+    while (timer)
+    {
+        Timer *next = timer->mNext;
+        place(timer);
+        timer = next;
+    }
+
+    // The next level turns when this one has turned around
+    if (!index && level + 1 < LEVELS)
+        cascade(level + 1);
+}
+
+void TimingWheel::clear(Timer **slot)
+{
+    for (Timer *timer = *slot; timer; timer = timer->mNext)
+    {
+        timer->mWheel = 0;
+        timer->mSlot = 0;
+    }
+    *slot = 0;
+}
+
+void TimingWheel::link(Timer *timer, Timer **slot)
+{
+    timer->mSlot = slot;
+    timer->mPrevious = 0;
+    timer->mNext = *slot;
+    if (*slot)
+        (*slot)->mPrevious = timer;
+    *slot = timer;
+}
+
+void TimingWheel::unlink(Timer *timer)
+{
+    if (timer->mPrevious)
+        timer->mPrevious->mNext = timer->mNext;
+    else
+        *timer->mSlot = timer->mNext;
+
+    if (timer->mNext)
+        timer->mNext->mPrevious = timer->mPrevious;
+
+    timer->mSlot = 0;
+    timer->mPrevious = 0;
+    timer->mNext = 0;
+}
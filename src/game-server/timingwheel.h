@@ -0,0 +1,158 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TIMINGWHEEL_H
+#define TIMINGWHEEL_H
+
+/**
+ * Calls back timers at the tick they are due, touching only the timers that
+ * are due. The timers of the next 256 ticks are kept in a slot per tick.
+ * Those further away are kept in coarser slots of higher levels, and moved
+ * down when their time comes close, so that scheduling and cancelling a
+ * timer never depends on how many there are.
+ *
+ * The timers are not owned by the wheel. They are usually members of the
+ * object they call back, and are cancelled when destroyed.
+ */
+class TimingWheel
+{
+    public:
+        class Timer
+        {
+            public:
+                Timer();
+
+                /**
+                 * Cancels the timer.
+                 */
+                virtual ~Timer();
+
+                /**
+                 * Takes the timer off its wheel, if any.
+                 */
+                void cancel();
+
+                /**
+                 * Returns whether the timer is waiting on a wheel.
+                 */
+                bool isScheduled() const
+                { return mWheel != 0; }
+
+                /**
+                 * Gets the tick for which the timer was last scheduled.
+                 */
+                int getTick() const
+                { return mTick; }
+
+            protected:
+                /**
+                 * Called when the timer is due. The timer is no longer
+                 * scheduled at that point, and may be scheduled again.
+                 */
+                virtual void expired() = 0;
+
+            private:
+                Timer(const Timer &);
+                Timer &operator=(const Timer &);
+
+                TimingWheel *mWheel;
+                Timer **mSlot;          /**< Head of the list it is in. */
+                Timer *mPrevious;
+                Timer *mNext;
+                int mTick;
+
+                friend class TimingWheel;
+        };
+
+        /**
+         * Creates a wheel of which the next tick to run is the given one.
+         */
+        TimingWheel(int tick);
+
+        /**
+         * Cancels the timers left.
+         */
+        ~TimingWheel();
+
+        /**
+         * Schedules a timer for a tick, moving it if it was already
+         * scheduled. Ticks that have already run are taken as the next one.
+         */
+        void schedule(Timer *timer, int tick);
+
+        /**
+         * Calls back the timers due up to the given tick, included.
+         */
+        void advance(int tick);
+
+        /**
+         * Gets the number of timers scheduled.
+         */
+        unsigned getSize() const
+        { return mSize; }
+
+    private:
+        enum
+        {
+            ROOT_BITS = 8,
+            ROOT_SLOTS = 1 << ROOT_BITS,
+            LEVEL_BITS = 6,
+            LEVEL_SLOTS = 1 << LEVEL_BITS,
+            LEVELS = 3,
+            /** Timers further away are delayed to the last slot. */
+            MAX_DELAY = (1 << (ROOT_BITS + LEVELS * LEVEL_BITS)) - 1
+        };
+
+        TimingWheel(const TimingWheel &);
+        TimingWheel &operator=(const TimingWheel &);
+
+        void place(Timer *timer);
+        void cascade(int level);
+        void clear(Timer **slot);
+
+        static void link(Timer *timer, Timer **slot);
+        static void unlink(Timer *timer);
+
+        Timer *mRoot[ROOT_SLOTS];
+        Timer *mLevels[LEVELS][LEVEL_SLOTS];
+        int mCurrent;           /**< Next tick to run. */
+        unsigned mSize;
+};
+
+/**
+ * A timer calling back a member function of an object.
+ */
+template< class T, void (T::*Function)() >
+class MemberTimer : public TimingWheel::Timer
+{
+    public:
+        MemberTimer(T *object)
+            : mObject(object)
+        {}
+
+    protected:
+        void expired()
+        { (mObject->*Function)(); }
+
+    private:
+        T *mObject;
+};
+
+#endif // TIMINGWHEEL_H
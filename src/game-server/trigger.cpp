@@ -60,8 +60,11 @@ void ScriptAction::process(Actor *obj)
 void TriggerArea::update()
 {
     std::set<Actor*> insideNow;
+    bool beingsAround = false;
     for (BeingIterator i(getMap()->getInsideRectangleIterator(mZone)); i; ++i)
     {
+        beingsAround = true;
+
         // Don't deal with unitialized actors.
         if (!(*i) || !(*i)->isPublicIdValid())
             continue;
@@ -81,4 +84,20 @@ void TriggerArea::update()
         }
     }
     mInside.swap(insideNow); //swapping is faster than assigning
+
+    // Beings coming in the zones will wake the area up
+    if (!beingsAround)
+        sleep();
+}
+
+void TriggerArea::inserted()
+{
+    Entity::inserted();
+    getMap()->addZoneWatcher(this, mZone);
+}
+
+void TriggerArea::removed()
+{
+    getMap()->removeZoneWatcher(this, mZone);
+    Entity::removed();
 }
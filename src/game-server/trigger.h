@@ -69,8 +69,18 @@ class TriggerArea : public Entity
         TriggerArea(MapComposite *m, const Rectangle &r, TriggerAction *ptr, bool once)
           : Entity(OBJECT_OTHER, m), mZone(r), mAction(ptr), mOnce(once) {}
 
+        /**
+         * Processes the beings inside the area. Sleeps while there are none
+         * in the zones it covers.
+         */
         virtual void update();
 
+        /**
+         * Overridden in order to be woken up by the beings coming close.
+         */
+        virtual void inserted();
+        virtual void removed();
+
     private:
         Rectangle mZone;
         TriggerAction *mAction;
@@ -26,7 +26,8 @@ BandwidthMonitor::BandwidthMonitor():
     mAmountServerOutput(0),
     mAmountServerInput(0),
     mAmountClientOutput(0),
-    mAmountClientInput(0)
+    mAmountClientInput(0),
+    mAmountBroadcastSaving(0)
 {
 }
 
@@ -40,6 +41,11 @@ void BandwidthMonitor::increaseInterServerInput(int size)
     mAmountServerInput += size;
 }
 
+void BandwidthMonitor::increaseBroadcastSaving(int size)
+{
+    mAmountBroadcastSaving += size;
+}
+
 void BandwidthMonitor::increaseClientOutput(NetComputer *nc, int size)
 {
     mAmountClientOutput += size;
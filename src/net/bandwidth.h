@@ -33,16 +33,20 @@ public:
     void increaseInterServerInput(int size);
     void increaseClientOutput(NetComputer *nc, int size);
     void increaseClientInput(NetComputer *nc, int size);
+    void increaseBroadcastSaving(int size);
     int totalInterServerOut() const { return mAmountServerOutput; }
     int totalInterServerIn() const { return mAmountServerInput; }
     int totalClientOut() const { return mAmountClientOutput; }
     int totalClientIn() const { return mAmountClientInput; }
+    /** Bytes not duplicated thanks to packets shared by broadcasts. */
+    int totalBroadcastSaving() const { return mAmountBroadcastSaving; }
 
 private:
     int mAmountServerOutput;
     int mAmountServerInput;
     int mAmountClientOutput;
     int mAmountClientInput;
+    int mAmountBroadcastSaving;
     // map of client to output and input
     typedef std::map<NetComputer*, std::pair<int, int> > ClientBandwidth;
     ClientBandwidth mClientBandwidth;
@@ -0,0 +1,71 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "net/broadcast.h"
+
+#include "net/bandwidth.h"
+#include "net/messageout.h"
+#include "net/netcomputer.h"
+
+#include "utils/logger.h"
+
+Broadcast::Broadcast(const MessageOut &msg, bool reliable,
+                     unsigned int channel):
+    mMessage(msg),
+    mPacket(0),
+    mFlags(reliable ? ENET_PACKET_FLAG_RELIABLE : 0),
+    mChannel(channel),
+    mRecipients(0)
+{
+}
+
+Broadcast::~Broadcast()
+{
+    if (!mPacket)
+        return;
+
+    // Nobody holds the packet when it could not be queued.
+    if (mPacket->referenceCount == 0)
+        enet_packet_destroy(mPacket);
+
+    if (mRecipients > 1)
+    {
+        gBandwidth->increaseBroadcastSaving(
+                (mRecipients - 1) * mMessage.getLength());
+    }
+}
+
+void Broadcast::send(NetComputer *computer)
+{
+    LOG_DEBUG("Sending message " << mMessage << " to " << *computer);
+
+    if (!mPacket)
+    {
+        mPacket = mMessage.createPacket(mFlags);
+        if (!mPacket)
+        {
+            LOG_ERROR("Failure to create packet!");
+            return;
+        }
+    }
+
+    computer->send(mPacket, mChannel);
+    ++mRecipients;
+}
@@ -0,0 +1,75 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef BROADCAST_H
+#define BROADCAST_H
+
+#include <enet/enet.h>
+
+class MessageOut;
+class NetComputer;
+
+/**
+ * Sends the same message to several computers. A single packet is created
+ * on the first send and queued to every recipient, instead of one packet
+ * being created for each of them.
+ *
+ * The packet is shared between the recipients without synchronization, so
+ * a broadcast may not be used from the world update threads.
+ */
+class Broadcast
+{
+    public:
+        /**
+         * @param msg      The message to be sent. It may be changed or
+         *                 destroyed afterwards without affecting the packet.
+         * @param reliable Defines if a reliable or an unreliable packet
+         *                 should be sent.
+         * @param channel  The channel number of which the packet should
+         *                 be sent.
+         */
+        Broadcast(const MessageOut &msg, bool reliable = true,
+                  unsigned int channel = 0);
+
+        ~Broadcast();
+
+        /**
+         * Queues the message for sending to a computer.
+         */
+        void send(NetComputer *computer);
+
+        /**
+         * Returns the number of computers the message was sent to.
+         */
+        unsigned int getRecipientCount() const
+        { return mRecipients; }
+
+    private:
+        Broadcast(const Broadcast &);
+        Broadcast &operator=(const Broadcast &);
+
+        const MessageOut &mMessage;
+        ENetPacket *mPacket;
+        enet_uint32 mFlags;
+        unsigned int mChannel;
+        unsigned int mRecipients;
+};
+
+#endif // BROADCAST_H
@@ -105,9 +105,7 @@ void Connection::send(const MessageOut &msg, bool reliable, unsigned channel)
     gBandwidth->increaseInterServerOutput(msg.getLength());
 
     ENetPacket *packet;
-    packet = enet_packet_create(msg.getData(),
-                                msg.getLength(),
-                                reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
+    packet = msg.createPacket(reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
 
     if (packet)
         enet_peer_send(mRemote, channel, packet);
@@ -24,6 +24,7 @@
 
 #include "common/configuration.h"
 #include "net/bandwidth.h"
+#include "net/broadcast.h"
 #include "net/messagein.h"
 #include "net/messageout.h"
 #include "net/netcomputer.h"
@@ -88,9 +89,24 @@ void ConnectionHandler::stopListen()
 
 void ConnectionHandler::flush()
 {
+    for (NetComputers::iterator i = clients.begin(), i_end = clients.end();
+         i != i_end; ++i)
+    {
+        (*i)->flushBundle();
+    }
+
     enet_host_flush(host);
 }
 
+void ConnectionHandler::sendDeferred()
+{
+    for (NetComputers::iterator i = clients.begin(), i_end = clients.end();
+         i != i_end; ++i)
+    {
+        (*i)->sendDeferred();
+    }
+}
+
 void ConnectionHandler::process(enet_uint32 timeout)
 {
     ENetEvent event;
@@ -155,10 +171,11 @@ void ConnectionHandler::process(enet_uint32 timeout)
 
 void ConnectionHandler::sendToEveryone(const MessageOut &msg)
 {
+    Broadcast broadcast(msg);
     for (NetComputers::iterator i = clients.begin(), i_end = clients.end();
          i != i_end; ++i)
     {
-        (*i)->send(msg);
+        broadcast.send(*i);
     }
 }
 
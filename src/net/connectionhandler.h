@@ -62,10 +62,17 @@ class ConnectionHandler
         virtual void process(enet_uint32 timeout = 0);
 
         /**
-         * Process outgoing messages.
+         * Process outgoing messages, including the messages bundled for
+         * each client.
          */
         void flush();
 
+        /**
+         * Hands the packets that were queued while sending was deferred to
+         * ENet, see NetComputer::setDeferSending().
+         */
+        void sendDeferred();
+
         /**
          * Called when a computer sends a packet to the network session.
          */
@@ -132,6 +132,16 @@ double MessageIn::readDouble()
         memcpy(&value, mData + mPos, sizeof(double));
     mPos += sizeof(double);
 #else
+    ASSERT_IF (mPos < mLength)
+    {
+        const unsigned char marker = mData[mPos];
+        if (marker == ManaServ::DOUBLE_FIXED_POINT ||
+            marker == ManaServ::DOUBLE_IEEE754)
+        {
+            return readBinaryDouble();
+        }
+    }
+
     int length = readInt8();
     std::istringstream i (readString(length));
     i >> value;
@@ -139,6 +149,41 @@ double MessageIn::readDouble()
     return value;
 }
 
+#ifndef USE_NATIVE_DOUBLE
+double MessageIn::readBinaryDouble()
+{
+    double value = -1;
+    const bool fixedPoint =
+            (unsigned char) mData[mPos] == ManaServ::DOUBLE_FIXED_POINT;
+    const unsigned short length = fixedPoint ? 5 : 9;
+
+    ASSERT_IF (mPos + length <= mLength)
+    {
+        uint32_t t;
+        memcpy(&t, mData + mPos + 1, 4);
+        if (fixedPoint)
+        {
+            value = (int32_t) ENET_NET_TO_HOST_32(t) /
+                    (double) ManaServ::DOUBLE_FIXED_POINT_SCALE;
+        }
+        else
+        {
+            uint64_t bits = (uint64_t) ENET_NET_TO_HOST_32(t) << 32;
+            memcpy(&t, mData + mPos + 5, 4);
+            bits |= ENET_NET_TO_HOST_32(t);
+            memcpy(&value, &bits, sizeof(double));
+        }
+    }
+    else
+    {
+        LOG_DEBUG("Unable to read " << length << " bytes in " << mId << "!");
+    }
+
+    mPos += length;
+    return value;
+}
+#endif
+
 std::string MessageIn::readString(int length)
 {
     if (!readValueType(ManaServ::String))
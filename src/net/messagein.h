@@ -49,6 +49,11 @@ class MessageIn
          */
         int getLength() const { return mLength; }
 
+        /**
+         * Returns the data of this message, including its ID.
+         */
+        const char *getData() const { return mData; }
+
         int readInt8();             /**< Reads a byte. */
         int readInt16();            /**< Reads a short. */
         int readInt32();            /**< Reads a long. */
@@ -74,6 +79,8 @@ class MessageIn
     private:
         bool readValueType(ManaServ::ValueType type);
 
+        double readBinaryDouble();
+
         const char *mData;            /**< Packet data */
         unsigned short mLength;       /**< Length of data in bytes */
         unsigned short mId;           /**< The message ID. */
@@ -21,6 +21,7 @@
 #include "net/messageout.h"
 #include "net/messagein.h"
 
+#include <cstdlib>
 #include <cstring>
 #include <iomanip>
 #include <iostream>
@@ -31,20 +32,199 @@
 #include <string>
 #include <enet/enet.h>
 
+#include "utils/thread.h"
+
 /** Initial amount of bytes allocated for the messageout data buffer. */
-const unsigned int INITIAL_DATA_CAPACITY = 16;
+const unsigned int INITIAL_DATA_CAPACITY = 32;
 
 /** Factor by which the messageout data buffer is increased when too small. */
 const unsigned int CAPACITY_GROW_FACTOR = 2;
 
+/**
+ * Number of buffer sizes that are kept for reuse, starting at the initial
+ * capacity and growing by the grow factor (32 to 4096 bytes).
+ */
+const unsigned int CACHED_BUFFER_SIZES = 8;
+
+/** Maximum amount of free buffers of each size kept by a thread. */
+const unsigned int MAX_CACHED_BUFFERS = 64;
+
+/** Maximum amount of free buffers of each size shared by the threads. */
+const unsigned int MAX_SHARED_BUFFERS = 1024;
+
 static bool debugModeEnabled = false;
 
+/**
+ * Reference counted storage of message data. The data directly follows this
+ * header, so that the buffer can be found back from the data of a packet.
+ */
+struct BufferCache;
+
+struct MessageBuffer
+{
+    MessageBuffer *next;        /**< Next free buffer in the cache. */
+    BufferCache *owner;         /**< Cache of the thread that took it. */
+    unsigned int capacity;      /**< Size of the data. */
+    int refCount;               /**< Messages and packets using the data. */
+
+    char *data()
+    { return reinterpret_cast< char * >(this + 1); }
+
+    static MessageBuffer *fromData(void *data)
+    { return static_cast< MessageBuffer * >(data) - 1; }
+};
+
+/**
+ * Free buffers of each cached size.
+ */
+struct BufferCache
+{
+    BufferCache(unsigned int limit = MAX_CACHED_BUFFERS):
+        limit(limit)
+    {
+        memset(buffers, 0, sizeof(buffers));
+        memset(count, 0, sizeof(count));
+    }
+
+    ~BufferCache()
+    {
+        for (unsigned int i = 0; i < CACHED_BUFFER_SIZES; ++i)
+            while (MessageBuffer *buffer = take(i))
+                free(buffer);
+    }
+
+    MessageBuffer *take(unsigned int index)
+    {
+        MessageBuffer *buffer = buffers[index];
+        if (buffer)
+        {
+            buffers[index] = buffer->next;
+            --count[index];
+        }
+        return buffer;
+    }
+
+    bool give(unsigned int index, MessageBuffer *buffer)
+    {
+        if (count[index] >= limit)
+            return false;
+        buffer->next = buffers[index];
+        buffers[index] = buffer;
+        ++count[index];
+        return true;
+    }
+
+    MessageBuffer *buffers[CACHED_BUFFER_SIZES];
+    unsigned int count[CACHED_BUFFER_SIZES];
+    unsigned int limit;         /**< Buffers kept of each size. */
+};
+
+/**
+ * Every thread has its own cache, so that no locking is needed to take a
+ * buffer or to return one taken by the same thread.
+ */
+static utils::ThreadLocal< BufferCache > threadCaches;
+
+/**
+ * Buffers released by another thread than the one that took them, which
+ * go back to the threads running out of buffers.
+ */
+static BufferCache sharedCache(MAX_SHARED_BUFFERS);
+static utils::Mutex sharedCacheMutex;
+
+static MessageOut::BufferStatistics bufferStatistics;
+
+/**
+ * Returns the index of the cached size fitting the given capacity, or
+ * CACHED_BUFFER_SIZES if the capacity is too large to be cached.
+ */
+static unsigned int getSizeIndex(unsigned int &capacity)
+{
+    unsigned int size = INITIAL_DATA_CAPACITY;
+    unsigned int index = 0;
+    while (size < capacity && index < CACHED_BUFFER_SIZES)
+    {
+        size *= CAPACITY_GROW_FACTOR;
+        ++index;
+    }
+
+    if (index < CACHED_BUFFER_SIZES)
+        capacity = size;
+    return index;
+}
+
+static MessageBuffer *acquireBuffer(unsigned int capacity)
+{
+    unsigned int index = getSizeIndex(capacity);
+    BufferCache *cache = threadCaches.get();
+    MessageBuffer *buffer = 0;
+
+    if (index < CACHED_BUFFER_SIZES)
+    {
+        buffer = cache->take(index);
+        if (!buffer)
+        {
+            utils::MutexLocker lock(&sharedCacheMutex);
+            buffer = sharedCache.take(index);
+        }
+    }
+
+    if (buffer)
+    {
+        __sync_fetch_and_add(&bufferStatistics.reused, 1);
+    }
+    else
+    {
+        buffer = (MessageBuffer*) malloc(sizeof(MessageBuffer) + capacity);
+        buffer->capacity = capacity;
+        __sync_fetch_and_add(&bufferStatistics.allocated, 1);
+    }
+
+    buffer->owner = cache;
+    buffer->refCount = 1;
+    return buffer;
+}
+
+static void releaseBuffer(MessageBuffer *buffer)
+{
+    if (__sync_sub_and_fetch(&buffer->refCount, 1) > 0)
+        return;
+
+    unsigned int capacity = buffer->capacity;
+    unsigned int index = getSizeIndex(capacity);
+    if (index < CACHED_BUFFER_SIZES)
+    {
+        // Packets are often freed by the network thread, so the buffers of
+        // other threads are shared rather than piling up here
+        BufferCache *cache = threadCaches.get();
+        if (buffer->owner == cache)
+        {
+            if (cache->give(index, buffer))
+                return;
+        }
+        else
+        {
+            utils::MutexLocker lock(&sharedCacheMutex);
+            if (sharedCache.give(index, buffer))
+                return;
+        }
+    }
+
+    free(buffer);
+}
+
+static void releasePacketBuffer(ENetPacket *packet)
+{
+    releaseBuffer(MessageBuffer::fromData(packet->data));
+}
+
 MessageOut::MessageOut(int id):
     mPos(0),
-    mDebugMode(false)
+    mDebugMode(false),
+    mBinaryDoubles(false)
 {
-    mData = (char*) malloc(INITIAL_DATA_CAPACITY);
-    mDataSize = INITIAL_DATA_CAPACITY;
+    mBuffer = acquireBuffer(INITIAL_DATA_CAPACITY);
+    mData = mBuffer->data();
 
     if (debugModeEnabled)
         id |= ManaServ::XXMSG_DEBUG_FLAG;
@@ -55,21 +235,46 @@ MessageOut::MessageOut(int id):
 
 MessageOut::~MessageOut()
 {
-    free(mData);
+    releaseBuffer(mBuffer);
 }
 
 void MessageOut::expand(size_t bytes)
 {
-    if (bytes > mDataSize)
-    {
-        do
-        {
-            mDataSize *= CAPACITY_GROW_FACTOR;
-        }
-        while (bytes > mDataSize);
+    // A buffer shared with a packet may not be changed anymore.
+    if (bytes <= mBuffer->capacity && mBuffer->refCount == 1)
+        return;
 
-        mData = (char*) realloc(mData, mDataSize);
-    }
+    unsigned int capacity = mBuffer->capacity;
+    while (bytes > capacity)
+        capacity *= CAPACITY_GROW_FACTOR;
+
+    MessageBuffer *buffer = acquireBuffer(capacity);
+    memcpy(buffer->data(), mData, mPos);
+    __sync_fetch_and_add(&bufferStatistics.copiedBytes, mPos);
+
+    releaseBuffer(mBuffer);
+    mBuffer = buffer;
+    mData = buffer->data();
+}
+
+ENetPacket *MessageOut::createPacket(enet_uint32 flags) const
+{
+    ENetPacket *packet = enet_packet_create(mData, mPos,
+                                     flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+    if (!packet)
+        return 0;
+
+    __sync_fetch_and_add(&mBuffer->refCount, 1);
+    packet->freeCallback = releasePacketBuffer;
+
+    __sync_fetch_and_add(&bufferStatistics.packets, 1);
+    __sync_fetch_and_add(&bufferStatistics.packetBytes, mPos);
+    return packet;
+}
+
+MessageOut::BufferStatistics MessageOut::getBufferStatistics()
+{
+    return bufferStatistics;
 }
 
 void MessageOut::writeInt8(int value)
@@ -114,6 +319,12 @@ void MessageOut::writeDouble(double value)
     memcpy(mData + mPos, &value, sizeof(double));
     mPos += sizeof(double);
 #else
+    if (mBinaryDoubles)
+    {
+        writeBinaryDouble(value);
+        return;
+    }
+
 // Rather inefficient, but I don't have a lot of time.
 // If anyone wants to implement a custom double you are more than welcome to.
     std::ostringstream o;
@@ -126,6 +337,39 @@ void MessageOut::writeDouble(double value)
 #endif
 }
 
+#ifndef USE_NATIVE_DOUBLE
+void MessageOut::writeBinaryDouble(double value)
+{
+    const double scaled = value * ManaServ::DOUBLE_FIXED_POINT_SCALE;
+    if (scaled >= std::numeric_limits< int32_t >::min() &&
+        scaled <= std::numeric_limits< int32_t >::max())
+    {
+        // Most values have few decimals, and are exactly read back
+        const int32_t fixed = (int32_t) scaled;
+        if (fixed / (double) ManaServ::DOUBLE_FIXED_POINT_SCALE == value)
+        {
+            expand(mPos + 5);
+            mData[mPos] = (char) ManaServ::DOUBLE_FIXED_POINT;
+            uint32_t t = ENET_HOST_TO_NET_32(fixed);
+            memcpy(mData + mPos + 1, &t, 4);
+            mPos += 5;
+            return;
+        }
+    }
+
+    uint64_t bits;
+    memcpy(&bits, &value, sizeof(double));
+    uint32_t high = ENET_HOST_TO_NET_32((uint32_t) (bits >> 32));
+    uint32_t low = ENET_HOST_TO_NET_32((uint32_t) bits);
+
+    expand(mPos + 9);
+    mData[mPos] = (char) ManaServ::DOUBLE_IEEE754;
+    memcpy(mData + mPos + 1, &high, 4);
+    memcpy(mData + mPos + 5, &low, 4);
+    mPos += 9;
+}
+#endif
+
 void MessageOut::writeString(const std::string &string, int length)
 {
     if (mDebugMode)
@@ -159,6 +403,15 @@ void MessageOut::writeString(const std::string &string, int length)
     mPos += length;
 }
 
+void MessageOut::writeMessage(const MessageOut &msg)
+{
+    expand(mPos + 2 + msg.mPos);
+    uint16_t t = ENET_HOST_TO_NET_16(msg.mPos);
+    memcpy(mData + mPos, &t, 2);
+    memcpy(mData + mPos + 2, msg.mData, msg.mPos);
+    mPos += 2 + msg.mPos;
+}
+
 void MessageOut::writeValueType(ManaServ::ValueType type)
 {
     expand(mPos + 1);
@@ -186,3 +439,8 @@ void MessageOut::setDebugModeEnabled(bool enabled)
 {
     debugModeEnabled = enabled;
 }
+
+bool MessageOut::isDebugModeEnabled()
+{
+    return debugModeEnabled;
+}
@@ -24,6 +24,9 @@
 #include "common/manaserv_protocol.h"
 
 #include <iosfwd>
+#include <enet/enet.h>
+
+struct MessageBuffer;
 
 /**
  * Used for building an outgoing message.
@@ -61,12 +64,26 @@ class MessageOut
          */
         void writeDouble(double value);
 
+        /**
+         * Sets whether doubles are written in binary, which only servers
+         * that agreed on it can read. Values that fit are written as
+         * fixed-point numbers, others as IEEE 754.
+         */
+        void setBinaryDoubles(bool binary)
+        { mBinaryDoubles = binary; }
+
         /**
          * Writes a string. If a fixed length is not given (-1), it is stored
          * as a short at the start of the string.
          */
         void writeString(const std::string &string, int length = -1);
 
+        /**
+         * Writes another message, preceded by its length, as part of a
+         * bundle. No type information is added in debug mode.
+         */
+        void writeMessage(const MessageOut &msg);
+
         /**
          * Returns the content of the message.
          */
@@ -77,6 +94,33 @@ class MessageOut
          */
         unsigned int getLength() const { return mPos; }
 
+        /**
+         * Creates an ENet packet referring to the data of this message
+         * instead of copying it. The data stays alive until both the message
+         * and the packet are gone, and writing to the message afterwards
+         * does not affect the packet.
+         *
+         * @return the packet, or NULL when it could not be created.
+         */
+        ENetPacket *createPacket(enet_uint32 flags) const;
+
+        /**
+         * Counters about the data buffers used by the messages.
+         */
+        struct BufferStatistics
+        {
+            unsigned long allocated;    /**< Buffers taken from the heap. */
+            unsigned long reused;       /**< Buffers taken from a cache. */
+            unsigned long copiedBytes;  /**< Bytes copied when growing. */
+            unsigned long packets;      /**< Packets sharing message data. */
+            unsigned long packetBytes;  /**< Size of those packets. */
+        };
+
+        /**
+         * Returns the buffer counters since the server start.
+         */
+        static BufferStatistics getBufferStatistics();
+
         /**
          * Sets whether the debug mode is enabled. In debug mode, the internal
          * data of the message is annotated so that the message contents can
@@ -86,19 +130,28 @@ class MessageOut
          */
         static void setDebugModeEnabled(bool enabled);
 
+        static bool isDebugModeEnabled();
+
     private:
+        MessageOut(const MessageOut &);
+        MessageOut &operator=(const MessageOut &);
+
         /**
          * Ensures the capacity of the data buffer is large enough to hold the
-         * given amount of bytes.
+         * given amount of bytes, and that the buffer is not shared with a
+         * packet.
          */
         void expand(size_t size);
 
         void writeValueType(ManaServ::ValueType type);
 
+        void writeBinaryDouble(double value);
+
+        MessageBuffer *mBuffer;     /**< Storage of the data. */
         char *mData;                /**< Data building up. */
         unsigned int mPos;          /**< Position in the data. */
-        unsigned int mDataSize;     /**< Allocated datasize. */
         bool mDebugMode;            /**< Include debugging information. */
+        bool mBinaryDoubles;
 
         /**
          * Streams message ID and length to the given output stream.
@@ -29,9 +29,31 @@
 #include "../utils/logger.h"
 #include "../utils/processorutils.h"
 
+/**
+ * Maximum size of a bundle, chosen so that it fits into a single datagram
+ * together with the ENet and UDP headers.
+ */
+const unsigned int MAX_BUNDLE_SIZE = 1200;
+
+bool NetComputer::mDeferSending = false;
+
 NetComputer::NetComputer(ENetPeer *peer):
-    mPeer(peer)
+    mPeer(peer),
+    mBundle(0),
+    mBundling(false)
+{
+}
+
+NetComputer::~NetComputer()
 {
+    delete mBundle;
+
+    for (std::vector< DeferredPacket >::iterator i = mDeferredPackets.begin(),
+         i_end = mDeferredPackets.end(); i != i_end; ++i)
+    {
+        if (--i->packet->referenceCount == 0)
+            enet_packet_destroy(i->packet);
+    }
 }
 
 bool NetComputer::isConnected()
@@ -61,16 +83,87 @@ void NetComputer::send(const MessageOut &msg, bool reliable,
 {
     LOG_DEBUG("Sending message " << msg << " to " << *this);
 
-    gBandwidth->increaseClientOutput(this, msg.getLength());
+    // Bundle entries are preceded by their length, the bundle by its id.
+    if (mBundling && reliable && channel == 0 &&
+        msg.getLength() + 4 <= MAX_BUNDLE_SIZE)
+    {
+        if (mBundle &&
+            mBundle->getLength() + msg.getLength() + 2 > MAX_BUNDLE_SIZE)
+        {
+            flushBundle();
+        }
+
+        if (!mBundle)
+            mBundle = new MessageOut(ManaServ::XXMSG_BUNDLE);
+
+        mBundle->writeMessage(msg);
+        return;
+    }
 
     ENetPacket *packet;
-    packet = enet_packet_create(msg.getData(),
-                                msg.getLength(),
-                                reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
+    packet = msg.createPacket(reliable ? ENET_PACKET_FLAG_RELIABLE : 0);
+
+    if (packet)
+    {
+        send(packet, channel);
+
+        // Nobody holds the packet when it could not be queued.
+        if (packet->referenceCount == 0)
+            enet_packet_destroy(packet);
+    }
+    else
+    {
+        LOG_ERROR("Failure to create packet!");
+    }
+}
+
+void NetComputer::send(ENetPacket *packet, unsigned int channel)
+{
+    // Keep the order of the messages sent before.
+    flushBundle();
+
+    if (mDeferSending)
+    {
+        // Keep the packet alive until it is handed to ENet.
+        ++packet->referenceCount;
+
+        DeferredPacket deferred;
+        deferred.packet = packet;
+        deferred.channel = channel;
+        mDeferredPackets.push_back(deferred);
+        return;
+    }
+
+    gBandwidth->increaseClientOutput(this, packet->dataLength);
+    enet_peer_send(mPeer, channel, packet);
+}
+
+void NetComputer::setBundling(bool enabled)
+{
+    if (!enabled)
+        flushBundle();
+
+    mBundling = enabled;
+}
+
+void NetComputer::flushBundle()
+{
+    if (!mBundle)
+        return;
+
+    MessageOut *bundle = mBundle;
+    mBundle = 0;
+
+    ENetPacket *packet = bundle->createPacket(ENET_PACKET_FLAG_RELIABLE);
+    delete bundle;
 
     if (packet)
     {
-        enet_peer_send(mPeer, channel, packet);
+        send(packet, 0);
+
+        // Nobody holds the packet when it could not be queued.
+        if (packet->referenceCount == 0)
+            enet_packet_destroy(packet);
     }
     else
     {
@@ -78,6 +171,20 @@ void NetComputer::send(const MessageOut &msg, bool reliable,
     }
 }
 
+void NetComputer::sendDeferred()
+{
+    for (std::vector< DeferredPacket >::iterator i = mDeferredPackets.begin(),
+         i_end = mDeferredPackets.end(); i != i_end; ++i)
+    {
+        gBandwidth->increaseClientOutput(this, i->packet->dataLength);
+        enet_peer_send(mPeer, i->channel, i->packet);
+
+        if (--i->packet->referenceCount == 0)
+            enet_packet_destroy(i->packet);
+    }
+    mDeferredPackets.clear();
+}
+
 std::ostream &operator <<(std::ostream &os, const NetComputer &comp)
 {
     // address.host contains the ip-address in network-byte-order
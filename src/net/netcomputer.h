@@ -22,6 +22,7 @@
 #define NETCOMPUTER_H
 
 #include <iostream>
+#include <vector>
 #include <enet/enet.h>
 
 class MessageOut;
@@ -35,7 +36,7 @@ class NetComputer
     public:
         NetComputer(ENetPeer *peer);
 
-        virtual ~NetComputer() {}
+        virtual ~NetComputer();
 
         /**
          * Returns <code>true</code> if this computer is connected.
@@ -70,14 +71,68 @@ class NetComputer
         void send(const MessageOut &msg, bool reliable = true,
                   unsigned int channel = 0);
 
+        /**
+         * Queues an existing packet for sending to a client. The same packet
+         * may be queued to several clients, see Broadcast.
+         *
+         * @param packet   The packet to be sent. It is destroyed by ENet
+         *                 once it is no longer queued to any client.
+         * @param channel  The channel number of which the packet should
+         *                 be sent.
+         */
+        void send(ENetPacket *packet, unsigned int channel = 0);
+
         /**
          * Returns IP address of computer in 32bit int form
          */
         int getIP() const;
 
+        /**
+         * Sets whether the reliable messages sent on channel 0 are combined
+         * into XXMSG_BUNDLE messages. A bundle is sent when it is full, when
+         * a message is sent on its own or when flushBundle() is called.
+         *
+         * Only enable this when the remote side knows about bundles.
+         */
+        void setBundling(bool enabled);
+
+        /**
+         * Sends the messages bundled so far.
+         */
+        void flushBundle();
+
+        /**
+         * When enabled, send() only creates the packets and keeps them until
+         * sendDeferred() is called. This allows messages to be composed for
+         * different computers from several threads at once, since nothing
+         * shared with other computers is touched before the packets are
+         * actually handed to ENet.
+         */
+        static void setDeferSending(bool defer)
+        { mDeferSending = defer; }
+
+        /**
+         * Hands the packets kept while sending was deferred to ENet.
+         */
+        void sendDeferred();
+
     private:
+        struct DeferredPacket
+        {
+            ENetPacket *packet;
+            unsigned int channel;
+        };
+
         ENetPeer *mPeer;              /**< Client peer */
 
+        MessageOut *mBundle;          /**< Messages waiting to be sent. */
+        bool mBundling;               /**< Whether messages are bundled. */
+
+        /** Packets waiting for sendDeferred(). */
+        std::vector< DeferredPacket > mDeferredPackets;
+
+        static bool mDeferSending;
+
         /**
          * Converts the ip-address of the peer to a stringstream.
          * Example:
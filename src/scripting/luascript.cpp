@@ -42,6 +42,12 @@ LuaScript::~LuaScript()
 
 void LuaScript::prepare(Ref function)
 {
+    if (DeferredCalls *calls = getDeferredCalls())
+    {
+        calls->prepare(this, function);
+        return;
+    }
+
     assert(nbArgs == -1);
 
     assert(function.isValid());
@@ -52,6 +58,7 @@ void LuaScript::prepare(Ref function)
 
 Script::Thread *LuaScript::newThread()
 {
+    assert(!getDeferredCalls());
     assert(nbArgs == -1);
     assert(!mCurrentThread);
 
@@ -64,6 +71,7 @@ Script::Thread *LuaScript::newThread()
 
 void LuaScript::prepareResume(Thread *thread)
 {
+    assert(!getDeferredCalls());
     assert(nbArgs == -1);
     assert(!mCurrentThread);
 
@@ -74,6 +82,12 @@ void LuaScript::prepareResume(Thread *thread)
 
 void LuaScript::push(int v)
 {
+    if (DeferredCalls *calls = getDeferredCalls())
+    {
+        calls->push(v);
+        return;
+    }
+
     assert(nbArgs >= 0);
     lua_pushinteger(mCurrentState, v);
     ++nbArgs;
@@ -81,6 +95,12 @@ void LuaScript::push(int v)
 
 void LuaScript::push(const std::string &v)
 {
+    if (DeferredCalls *calls = getDeferredCalls())
+    {
+        calls->push(v);
+        return;
+    }
+
     assert(nbArgs >= 0);
     lua_pushstring(mCurrentState, v.c_str());
     ++nbArgs;
@@ -88,6 +108,12 @@ void LuaScript::push(const std::string &v)
 
 void LuaScript::push(Entity *v)
 {
+    if (DeferredCalls *calls = getDeferredCalls())
+    {
+        calls->push(v);
+        return;
+    }
+
     assert(nbArgs >= 0);
     if (v)
         lua_pushlightuserdata(mCurrentState, v);
@@ -98,6 +124,12 @@ void LuaScript::push(Entity *v)
 
 void LuaScript::push(const std::list<InventoryItem> &itemList)
 {
+    if (DeferredCalls *calls = getDeferredCalls())
+    {
+        calls->push(itemList);
+        return;
+    }
+
     assert(nbArgs >= 0);
     int position = 0;
 
@@ -120,6 +152,12 @@ void LuaScript::push(const std::list<InventoryItem> &itemList)
 
 int LuaScript::execute()
 {
+    if (DeferredCalls *calls = getDeferredCalls())
+    {
+        calls->execute();
+        return 0;
+    }
+
     assert(nbArgs >= 0);
 
 
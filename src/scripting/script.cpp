@@ -24,6 +24,7 @@
 #include "common/resourcemanager.h"
 #include "game-server/being.h"
 #include "utils/logger.h"
+#include "utils/thread.h"
 
 #include <cassert>
 #include <cstdlib>
@@ -38,6 +39,18 @@ static Engines *engines = NULL;
 Script::Ref Script::mCreateNpcDelayedCallback;
 Script::Ref Script::mUpdateCallback;
 
+/**
+ * The list the calls of a thread are recorded into, if any.
+ */
+struct DeferredCallsOfThread
+{
+    DeferredCallsOfThread() : calls(0) {}
+
+    Script::DeferredCalls *calls;
+};
+
+static utils::ThreadLocal<DeferredCallsOfThread> deferredCalls;
+
 Script::Script():
     mCurrentThread(0),
     mMap(0),
@@ -96,8 +109,32 @@ static char *skipPotentialBom(char *text)
     return (strncmp(text, utf8Bom, bomLength) == 0) ? text + bomLength : text;
 }
 
+void Script::setDeferredCalls(DeferredCalls *calls)
+{
+    deferredCalls->calls = calls;
+}
+
+Script::DeferredCalls *Script::getDeferredCalls()
+{
+    return deferredCalls->calls;
+}
+
+void Script::setMap(MapComposite *m)
+{
+    if (DeferredCalls *calls = getDeferredCalls())
+        calls->setMap(m);
+    else
+        mMap = m;
+}
+
 bool Script::loadFile(const std::string &name)
 {
+    if (DeferredCalls *calls = getDeferredCalls())
+    {
+        calls->loadFile(this, name);
+        return ResourceManager::exists(name);
+    }
+
     int size;
     char *buffer = ResourceManager::loadFile(name, size);
     if (buffer)
@@ -164,3 +201,105 @@ Script::Thread::~Thread()
 {
     fastRemoveOne(mScript->mThreads, this);
 }
+
+
+void Script::DeferredCalls::run()
+{
+    for (std::vector<Call>::const_iterator i = mCalls.begin(),
+         i_end = mCalls.end(); i != i_end; ++i)
+    {
+        Script *script = i->script;
+        if (!i->function.isValid())
+        {
+            script->loadFile(i->file);
+            continue;
+        }
+
+        script->setMap(i->map);
+        script->prepare(i->function);
+        for (std::vector<Argument>::const_iterator a = i->arguments.begin(),
+             a_end = i->arguments.end(); a != a_end; ++a)
+        {
+            switch (a->type)
+            {
+                case ArgumentInt:
+                    script->push(a->value);
+                    break;
+                case ArgumentString:
+                    script->push(a->text);
+                    break;
+                case ArgumentEntity:
+                    script->push(a->entity);
+                    break;
+                case ArgumentItems:
+                    script->push(a->items);
+                    break;
+            }
+        }
+        script->execute();
+    }
+    mCalls.clear();
+}
+
+void Script::DeferredCalls::loadFile(Script *script, const std::string &name)
+{
+    Call call;
+    call.script = script;
+    call.file = name;
+    mCalls.push_back(call);
+}
+
+void Script::DeferredCalls::prepare(Script *script, Ref function)
+{
+    assert(function.isValid());
+
+    Call call;
+    call.script = script;
+    call.map = mMap;
+    call.function = function;
+    mCalls.push_back(call);
+}
+
+void Script::DeferredCalls::push(const Argument &argument)
+{
+    assert(!mCalls.empty() && mCalls.back().function.isValid());
+    mCalls.back().arguments.push_back(argument);
+}
+
+void Script::DeferredCalls::push(int v)
+{
+    Argument argument;
+    argument.type = ArgumentInt;
+    argument.value = v;
+    push(argument);
+}
+
+void Script::DeferredCalls::push(const std::string &v)
+{
+    Argument argument;
+    argument.type = ArgumentString;
+    argument.text = v;
+    push(argument);
+}
+
+void Script::DeferredCalls::push(Entity *v)
+{
+    Argument argument;
+    argument.type = ArgumentEntity;
+    argument.entity = v;
+    push(argument);
+}
+
+void Script::DeferredCalls::push(const std::list<InventoryItem> &itemList)
+{
+    Argument argument;
+    argument.type = ArgumentItems;
+    argument.items = itemList;
+    push(argument);
+}
+
+void Script::DeferredCalls::execute()
+{
+    // Like the scripts, forget the map once the call is made
+    mMap = 0;
+}
@@ -67,6 +67,80 @@ class Script
                 int value;
         };
 
+        /**
+         * Calls to scripts made while the maps are updated in parallel. Only
+         * one thread may use a script at once, so the calls are recorded
+         * and made later by the main thread, in the order they were made.
+         */
+        class DeferredCalls
+        {
+            public:
+                DeferredCalls() : mMap(0) {}
+
+                /**
+                 * Makes the recorded calls and forgets them.
+                 */
+                void run();
+
+                void setMap(MapComposite *m)
+                { mMap = m; }
+
+                void loadFile(Script *script, const std::string &name);
+
+                void prepare(Script *script, Ref function);
+
+                void push(int);
+
+                void push(const std::string &);
+
+                void push(Entity *);
+
+                void push(const std::list<InventoryItem> &itemList);
+
+                void execute();
+
+            private:
+                enum ArgumentType {
+                    ArgumentInt,
+                    ArgumentString,
+                    ArgumentEntity,
+                    ArgumentItems
+                };
+
+                struct Argument
+                {
+                    Argument() : type(ArgumentInt), value(0), entity(0) {}
+
+                    ArgumentType type;
+                    int value;
+                    std::string text;
+                    Entity *entity;
+                    std::list<InventoryItem> items;
+                };
+
+                struct Call
+                {
+                    Call() : script(0), map(0) {}
+
+                    Script *script;
+                    MapComposite *map;
+                    Ref function;       /**< Invalid when loading a file. */
+                    std::string file;
+                    std::vector<Argument> arguments;
+                };
+
+                void push(const Argument &argument);
+
+                std::vector<Call> mCalls;
+                MapComposite *mMap;     /**< Map of the next call. */
+        };
+
+        /**
+         * Makes the calls to scripts from the calling thread be recorded
+         * into the given list, or be made right away again when null.
+         */
+        static void setDeferredCalls(DeferredCalls *calls);
+
         enum ThreadState {
             ThreadPending,
             ThreadPaused,
@@ -207,8 +281,7 @@ class Script
         /**
          * Sets associated map.
          */
-        void setMap(MapComposite *m)
-        { mMap = m; }
+        void setMap(MapComposite *m);
 
         /**
          * Gets associated map.
@@ -230,6 +303,12 @@ class Script
         { script->assignCallback(mUpdateCallback); }
 
     protected:
+        /**
+         * Returns the list the calls of the calling thread are recorded
+         * into, or null when they are to be made right away.
+         */
+        static DeferredCalls *getDeferredCalls();
+
         std::string mScriptFile;
         Thread *mCurrentThread;
 
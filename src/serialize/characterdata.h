@@ -22,6 +22,7 @@
 #define SERIALIZE_CHARACTERDATA_H
 
 #include <map>
+#include <vector>
 
 #include "common/defines.h"
 #include "common/inventorydata.h"
@@ -30,6 +31,29 @@
 #include "net/messageout.h"
 #include "utils/point.h"
 
+/**
+ * The data of a character as stored by the account server, against which
+ * only the changes get sent. Status effects and specials are few and change
+ * all the time, so they are always sent whole.
+ */
+struct StoredCharacterData
+{
+    StoredCharacterData():
+        registration(0)
+    {}
+
+    /**
+     * Registration with the account server the data was stored through, 0
+     * when the data is not known to be stored.
+     */
+    unsigned registration;
+    std::map< unsigned, std::pair< double, double > > attributes;
+    std::map< int, int > skills;
+    std::map< int, int > kills;
+    EquipData equipment;
+    InventoryData inventory;
+};
+
 template< class T >
 void serializeCharacterData(const T &data, MessageOut &msg)
 {
@@ -218,4 +242,385 @@ void deserializeCharacterData(T &data, MessageIn &msg)
     poss.setInventory(inventoryData);
 }
 
+/**
+ * Remembers the data of a character as stored by the account server.
+ */
+template< class T >
+void rememberCharacterData(const T &data, StoredCharacterData &stored)
+{
+    stored.attributes.clear();
+    AttributeMap::const_iterator attr_it, attr_it_end;
+    for (attr_it = data.mAttributes.begin(),
+         attr_it_end = data.mAttributes.end();
+         attr_it != attr_it_end;
+         ++attr_it)
+    {
+        stored.attributes[attr_it->first] =
+                std::make_pair(data.getAttrBase(attr_it),
+                               data.getAttrMod(attr_it));
+    }
+
+    stored.skills.clear();
+    stored.skills.insert(data.getSkillBegin(), data.getSkillEnd());
+    stored.kills.clear();
+    stored.kills.insert(data.getKillCountBegin(), data.getKillCountEnd());
+
+    const Possessions &poss = data.getPossessions();
+    stored.equipment = poss.getEquipment();
+    stored.inventory = poss.getInventory();
+}
+
+inline bool sameEquipment(const EquipData &a, const EquipData &b)
+{
+    if (a.size() != b.size())
+        return false;
+
+    for (EquipData::const_iterator i = a.begin(), j = b.begin(),
+         i_end = a.end(); i != i_end; ++i, ++j)
+    {
+        if (i->first != j->first ||
+            i->second.itemId != j->second.itemId ||
+            i->second.itemInstance != j->second.itemInstance)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Stores the value of a key, and tells whether it changed. A key that was
+ * not stored yet counts as changed, whatever its value.
+ */
+template< class Map >
+bool updateStoredValue(Map &stored, const typename Map::key_type &key,
+                       const typename Map::mapped_type &value)
+{
+    typename Map::iterator it = stored.lower_bound(key);
+    if (it == stored.end() || stored.key_comp()(key, it->first))
+    {
+        stored.insert(it, std::make_pair(key, value));
+        return true;
+    }
+    if (it->second == value)
+        return false;
+    it->second = value;
+    return true;
+}
+
+/**
+ * Writes the keys of a stored map that are no longer in the data, of which
+ * the iterators are sorted by key, and erases them from the stored map.
+ */
+template< class Stored, class Iterator >
+void serializeRemovedKeys(Stored &stored, Iterator it, Iterator it_end,
+                          MessageOut &msg)
+{
+    std::vector< int > removed;
+    typename Stored::iterator s = stored.begin();
+    while (s != stored.end())
+    {
+        while (it != it_end && it->first < s->first)
+            ++it;
+        if (it == it_end || s->first < it->first)
+        {
+            removed.push_back(s->first);
+            stored.erase(s++);
+        }
+        else
+        {
+            ++s;
+        }
+    }
+
+    msg.writeInt16(removed.size());
+    for (unsigned i = 0; i < removed.size(); ++i)
+        msg.writeInt16(removed[i]);
+}
+
+/**
+ * Writes what changed in a character since it was stored, and remembers the
+ * new data as stored.
+ */
+template< class T >
+void serializeCharacterChanges(const T &data, StoredCharacterData &stored,
+                               MessageOut &msg)
+{
+    // general character properties, always sent
+    msg.writeInt8(data.getAccountLevel());
+    msg.writeInt8(data.getGender());
+    msg.writeInt8(data.getHairStyle());
+    msg.writeInt8(data.getHairColor());
+    msg.writeInt16(data.getLevel());
+    msg.writeInt16(data.getCharacterPoints());
+    msg.writeInt16(data.getCorrectionPoints());
+
+    // changed attributes
+    std::vector< unsigned > changedAttributes;
+    AttributeMap::const_iterator attr_it, attr_it_end;
+    for (attr_it = data.mAttributes.begin(),
+         attr_it_end = data.mAttributes.end();
+         attr_it != attr_it_end;
+         ++attr_it)
+    {
+        const std::pair< double, double > value(data.getAttrBase(attr_it),
+                                                data.getAttrMod(attr_it));
+        if (updateStoredValue(stored.attributes, attr_it->first, value))
+            changedAttributes.push_back(attr_it->first);
+    }
+    msg.writeInt16(changedAttributes.size());
+    for (std::vector< unsigned >::const_iterator i = changedAttributes.begin(),
+         i_end = changedAttributes.end(); i != i_end; ++i)
+    {
+        msg.writeInt16(*i);
+        msg.writeDouble(stored.attributes[*i].first);
+        msg.writeDouble(stored.attributes[*i].second);
+    }
+
+    // removed attributes
+    serializeRemovedKeys(stored.attributes, data.mAttributes.begin(),
+                         data.mAttributes.end(), msg);
+
+    // changed skills
+    std::vector< std::pair< int, int > > changed;
+    std::map<int, int>::const_iterator skill_it;
+    for (skill_it = data.getSkillBegin(); skill_it != data.getSkillEnd(); ++skill_it)
+    {
+        if (updateStoredValue(stored.skills, skill_it->first,
+                              skill_it->second))
+            changed.push_back(*skill_it);
+    }
+    msg.writeInt16(changed.size());
+    for (unsigned i = 0; i < changed.size(); ++i)
+    {
+        msg.writeInt16(changed[i].first);
+        msg.writeInt32(changed[i].second);
+    }
+
+    // removed skills
+    serializeRemovedKeys(stored.skills, data.getSkillBegin(),
+                         data.getSkillEnd(), msg);
+
+    // status effects currently affecting the character
+    msg.writeInt16(data.getStatusEffectSize());
+    std::map<int, int>::const_iterator status_it;
+    for (status_it = data.getStatusEffectBegin(); status_it != data.getStatusEffectEnd(); status_it++)
+    {
+        msg.writeInt16(status_it->first);
+        msg.writeInt16(status_it->second);
+    }
+
+    // location
+    msg.writeInt16(data.getMapId());
+    const Point &pos = data.getPosition();
+    msg.writeInt16(pos.x);
+    msg.writeInt16(pos.y);
+
+    // changed kill counts
+    changed.clear();
+    std::map<int, int>::const_iterator kills_it;
+    for (kills_it = data.getKillCountBegin(); kills_it != data.getKillCountEnd(); ++kills_it)
+    {
+        if (updateStoredValue(stored.kills, kills_it->first,
+                              kills_it->second))
+            changed.push_back(*kills_it);
+    }
+    msg.writeInt16(changed.size());
+    for (unsigned i = 0; i < changed.size(); ++i)
+    {
+        msg.writeInt16(changed[i].first);
+        msg.writeInt32(changed[i].second);
+    }
+
+    // removed kill counts
+    serializeRemovedKeys(stored.kills, data.getKillCountBegin(),
+                         data.getKillCountEnd(), msg);
+
+    // character specials
+    SpecialMap::const_iterator special_it;
+    msg.writeInt16(data.getSpecialSize());
+    for (special_it = data.getSpecialBegin(); special_it != data.getSpecialEnd() ; special_it++)
+    {
+        msg.writeInt32(special_it->first);
+        msg.writeInt32(special_it->second.currentMana);
+    }
+
+    // equipment, whole when it changed
+    const Possessions &poss = data.getPossessions();
+    const EquipData &equipData = poss.getEquipment();
+    if (sameEquipment(equipData, stored.equipment))
+    {
+        msg.writeInt8(0);
+    }
+    else
+    {
+        stored.equipment = equipData;
+        msg.writeInt8(1);
+        msg.writeInt16(equipData.size());
+        for (EquipData::const_iterator k = equipData.begin(),
+                 k_end = equipData.end(); k != k_end; ++k)
+        {
+            msg.writeInt16(k->first);                 // Equip slot id
+            msg.writeInt16(k->second.itemId);         // ItemId
+            msg.writeInt16(k->second.itemInstance);   // Item Instance id
+        }
+    }
+
+    // changed inventory slots, the emptied ones with item id 0
+    const InventoryData &inventoryData = poss.getInventory();
+    InventoryData::const_iterator j = inventoryData.begin(),
+                                  j_end = inventoryData.end();
+    InventoryData::iterator s = stored.inventory.begin();
+    while (j != j_end || s != stored.inventory.end())
+    {
+        if (s == stored.inventory.end() || (j != j_end && j->first < s->first))
+        {
+            msg.writeInt16(j->first);           // slot id
+            msg.writeInt16(j->second.itemId);   // item id
+            msg.writeInt16(j->second.amount);   // amount
+            stored.inventory.insert(s, *j);
+            ++j;
+        }
+        else if (j == j_end || s->first < j->first)
+        {
+            msg.writeInt16(s->first);
+            msg.writeInt16(0);
+            msg.writeInt16(0);
+            stored.inventory.erase(s++);
+        }
+        else
+        {
+            if (s->second.itemId != j->second.itemId ||
+                s->second.amount != j->second.amount)
+            {
+                msg.writeInt16(j->first);
+                msg.writeInt16(j->second.itemId);
+                msg.writeInt16(j->second.amount);
+                s->second = j->second;
+            }
+            ++j;
+            ++s;
+        }
+    }
+}
+
+/**
+ * Applies the changes of a character written by serializeCharacterChanges.
+ */
+template< class T >
+void deserializeCharacterChanges(T &data, MessageIn &msg)
+{
+    // general character properties
+    data.setAccountLevel(msg.readInt8());
+    data.setGender(ManaServ::getGender(msg.readInt8()));
+    data.setHairStyle(msg.readInt8());
+    data.setHairColor(msg.readInt8());
+    data.setLevel(msg.readInt16());
+    data.setCharacterPoints(msg.readInt16());
+    data.setCorrectionPoints(msg.readInt16());
+
+    // changed attributes
+    unsigned int attrSize = msg.readInt16();
+    for (unsigned int i = 0; i < attrSize; ++i)
+    {
+        unsigned int id = msg.readInt16();
+        double base = msg.readDouble(),
+               mod  = msg.readDouble();
+        data.setAttribute(id, base);
+        data.setModAttribute(id, mod);
+    }
+
+    // removed attributes
+    int removedSize = msg.readInt16();
+    for (int i = 0; i < removedSize; ++i)
+        data.removeAttribute(msg.readInt16());
+
+    // changed skills
+    int skillSize = msg.readInt16();
+    for (int i = 0; i < skillSize; ++i)
+    {
+        int skill = msg.readInt16();
+        int level = msg.readInt32();
+        data.setExperience(skill, level);
+    }
+
+    // removed skills
+    removedSize = msg.readInt16();
+    for (int i = 0; i < removedSize; ++i)
+        data.removeExperience(msg.readInt16());
+
+    // status effects currently affecting the character
+    int statusSize = msg.readInt16();
+    data.clearStatusEffects();
+    for (int i = 0; i < statusSize; i++)
+    {
+        int status = msg.readInt16();
+        int time = msg.readInt16();
+        data.applyStatusEffect(status, time);
+    }
+
+    // location
+    data.setMapId(msg.readInt16());
+
+    Point temporaryPoint;
+    temporaryPoint.x = msg.readInt16();
+    temporaryPoint.y = msg.readInt16();
+    data.setPosition(temporaryPoint);
+
+    // changed kill counts
+    int killSize = msg.readInt16();
+    for (int i = 0; i < killSize; i++)
+    {
+        int monsterId = msg.readInt16();
+        int kills = msg.readInt32();
+        data.setKillCount(monsterId, kills);
+    }
+
+    // removed kill counts
+    removedSize = msg.readInt16();
+    for (int i = 0; i < removedSize; ++i)
+        data.removeKillCount(msg.readInt16());
+
+    // character specials
+    int specialSize = msg.readInt16();
+    data.clearSpecials();
+    for (int i = 0; i < specialSize; i++)
+    {
+        const int id = msg.readInt32();
+        const int mana = msg.readInt32();
+        data.giveSpecial(id, mana);
+    }
+
+    Possessions &poss = data.getPossessions();
+    if (msg.readInt8())
+    {
+        EquipData equipData;
+        int equipSlotsSize = msg.readInt16();
+        unsigned int eqSlot;
+        EquipmentItem equipItem;
+        for (int j = 0; j < equipSlotsSize; ++j)
+        {
+            eqSlot  = msg.readInt16();
+            equipItem.itemId = msg.readInt16();
+            equipItem.itemInstance = msg.readInt16();
+            equipData.insert(equipData.end(),
+                                   std::make_pair(eqSlot, equipItem));
+        }
+        poss.setEquipment(equipData);
+    }
+
+    // changed inventory slots - must be last because size isn't transmitted
+    InventoryData inventoryData = poss.getInventory();
+    while (msg.getUnreadLength())
+    {
+        InventoryItem i;
+        int slotId = msg.readInt16();
+        i.itemId   = msg.readInt16();
+        i.amount   = msg.readInt16();
+        if (i.itemId)
+            inventoryData[slotId] = i;
+        else
+            inventoryData.erase(slotId);
+    }
+    poss.setInventory(inventoryData);
+}
+
 #endif // SERIALIZE_CHARACTERDATA_H
@@ -0,0 +1,88 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/histogram.h"
+
+#include <algorithm>
+
+namespace utils
+{
+
+Histogram::Histogram()
+{
+    reset();
+}
+
+unsigned Histogram::getBucket(uint64_t value)
+{
+    // Values below SUB_BUCKETS have a bucket each
+    if (value < SUB_BUCKETS)
+        return value;
+
+    int highestBit = SUB_BUCKET_BITS;
+    while (highestBit < 63 && value >> (highestBit + 1))
+        ++highestBit;
+
+    // The following bits select one of the halves of the sub-buckets
+    const int shift = highestBit - (SUB_BUCKET_BITS - 1);
+    const unsigned subBucket = (value >> shift) - HALF_SUB_BUCKETS;
+    return SUB_BUCKETS + (highestBit - SUB_BUCKET_BITS) * HALF_SUB_BUCKETS
+           + subBucket;
+}
+
+uint64_t Histogram::getBucketEnd(unsigned bucket)
+{
+    if (bucket < SUB_BUCKETS)
+        return bucket;
+
+    const unsigned magnitude = (bucket - SUB_BUCKETS) / HALF_SUB_BUCKETS;
+    const uint64_t subBucket = (bucket - SUB_BUCKETS) % HALF_SUB_BUCKETS
+                               + HALF_SUB_BUCKETS;
+    const int shift = magnitude + 1;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+uint64_t Histogram::getPercentile(double percentile) const
+{
+    if (!mCount)
+        return 0;
+
+    uint64_t wanted = (uint64_t) (percentile / 100.0 * mCount + 0.5);
+    wanted = std::max< uint64_t >(1, std::min(wanted, mCount));
+
+    uint64_t seen = 0;
+    for (unsigned i = 0; i < NB_BUCKETS; ++i)
+    {
+        seen += mCounts[i];
+        if (seen >= wanted)
+            return std::min(getBucketEnd(i), mMax);
+    }
+    return mMax;
+}
+
+void Histogram::reset()
+{
+    std::fill(mCounts, mCounts + NB_BUCKETS, 0);
+    mCount = 0;
+    mTotal = 0;
+    mMax = 0;
+}
+
+} // namespace utils
@@ -0,0 +1,99 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include "utils/timer.h"
+
+namespace utils
+{
+
+/**
+ * Counts how often values were recorded, with a precision relative to the
+ * size of the values. Small values are counted exactly, larger ones in
+ * buckets of which the width is about 1/16th of their value. This keeps
+ * recording cheap and the memory use fixed, whatever the range of values.
+ */
+class Histogram
+{
+    public:
+        Histogram();
+
+        /**
+         * Counts a value.
+         */
+        void record(uint64_t value)
+        {
+            ++mCounts[getBucket(value)];
+            ++mCount;
+            mTotal += value;
+            if (value > mMax)
+                mMax = value;
+        }
+
+        /**
+         * Returns the value below which the given share of the recorded
+         * values lie, rounded up to the end of its bucket.
+         *
+         * @param percentile the share, between 0 and 100.
+         */
+        uint64_t getPercentile(double percentile) const;
+
+        uint64_t getCount() const
+        { return mCount; }
+
+        uint64_t getTotal() const
+        { return mTotal; }
+
+        uint64_t getMax() const
+        { return mMax; }
+
+        /**
+         * Forgets the recorded values.
+         */
+        void reset();
+
+    private:
+        enum
+        {
+            SUB_BUCKET_BITS = 5,
+            SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+            HALF_SUB_BUCKETS = SUB_BUCKETS / 2,
+            NB_BUCKETS = SUB_BUCKETS + (64 - SUB_BUCKET_BITS) *
+                                       HALF_SUB_BUCKETS
+        };
+
+        static unsigned getBucket(uint64_t value);
+
+        /**
+         * Returns the highest value counted in the given bucket.
+         */
+        static uint64_t getBucketEnd(unsigned bucket);
+
+        uint64_t mCounts[NB_BUCKETS];
+        uint64_t mCount;
+        uint64_t mTotal;
+        uint64_t mMax;
+};
+
+} // namespace utils
+
+#endif // HISTOGRAM_H
@@ -23,10 +23,14 @@
 #include "common/configuration.h"
 #include "common/resourcemanager.h"
 #include "utils/string.h"
+#include "utils/thread.h"
 #include "utils/time.h"
 
 #include <fstream>
 #include <iostream>
+#include <vector>
+
+#include <unistd.h>
 
 #ifdef WIN32
 #include <windows.h>
@@ -58,6 +62,226 @@ static std::string mLastCallDate;
  * from the last call date.
  */
 static std::string mOldDate;
+/** Serializes output from the world update threads. */
+static Mutex mOutputMutex;
+
+/** Reads a value shared between threads, with a full memory barrier. */
+static unsigned atomicLoad(volatile unsigned *value)
+{
+    return __sync_fetch_and_add(value, 0);
+}
+
+/**
+ * Writes the messages queued by the other threads. The queue is a bounded
+ * ring of cells, of which each has a sequence number telling whether it is
+ * free to be filled or ready to be written, so that any thread can queue a
+ * message with a single compare-and-swap.
+ */
+class AsyncLog : public Thread
+{
+    public:
+        AsyncLog(unsigned queueSize, unsigned maxMemory);
+        ~AsyncLog();
+
+        /**
+         * Queues a message.
+         *
+         * @return the position of the message, or 0 when it was dropped.
+         */
+        unsigned push(const std::string &msg, Logger::Level level);
+
+        /**
+         * Waits until the message at the given position was written.
+         */
+        void waitWritten(unsigned position);
+
+        /**
+         * Tells the thread to write the waiting messages and waits for it
+         * to finish.
+         */
+        void stop();
+
+        unsigned getDroppedCount()
+        { return atomicLoad(&mDropped); }
+
+    protected:
+        void run();
+
+    private:
+        struct Cell
+        {
+            volatile unsigned sequence;
+            Logger::Level level;
+            std::string msg;
+        };
+
+        /**
+         * Writes the messages that are ready.
+         * @return whether any was written.
+         */
+        bool writeQueued();
+
+        std::vector< Cell > mCells;
+        unsigned mMask;
+        unsigned mMaxMemory;
+
+        volatile unsigned mEnqueuePos;
+        unsigned mDequeuePos;
+        volatile unsigned mWritten;     /**< Messages written so far. */
+        volatile unsigned mMemory;      /**< Bytes used by waiting messages. */
+        volatile unsigned mDropped;
+        unsigned mReportedDropped;
+        volatile unsigned mStopping;
+};
+
+/** Background writer, if messages are written asynchronously. */
+static AsyncLog *mAsyncLog = 0;
+
+AsyncLog::AsyncLog(unsigned queueSize, unsigned maxMemory):
+    mMaxMemory(maxMemory),
+    mEnqueuePos(0),
+    mDequeuePos(0),
+    mWritten(0),
+    mMemory(0),
+    mDropped(0),
+    mReportedDropped(0),
+    mStopping(0)
+{
+    // The ring needs a power of two size
+    unsigned size = 2;
+    while (size < queueSize)
+        size *= 2;
+
+    mCells.resize(size);
+    mMask = size - 1;
+    for (unsigned i = 0; i < size; ++i)
+        mCells[i].sequence = i;
+}
+
+AsyncLog::~AsyncLog()
+{
+    stop();
+}
+
+unsigned AsyncLog::push(const std::string &msg, Logger::Level level)
+{
+    const unsigned size = msg.size();
+    if (__sync_add_and_fetch(&mMemory, size) > mMaxMemory)
+    {
+        __sync_fetch_and_sub(&mMemory, size);
+        __sync_fetch_and_add(&mDropped, 1);
+        return 0;
+    }
+
+    // Claim a cell
+    Cell *cell;
+    unsigned pos = atomicLoad(&mEnqueuePos);
+    for (;;)
+    {
+        cell = &mCells[pos & mMask];
+        const int diff = (int) (atomicLoad(&cell->sequence) - pos);
+        if (diff == 0)
+        {
+            if (__sync_bool_compare_and_swap(&mEnqueuePos, pos, pos + 1))
+                break;
+            pos = atomicLoad(&mEnqueuePos);
+        }
+        else if (diff < 0)
+        {
+            // The ring is full
+            __sync_fetch_and_sub(&mMemory, size);
+            __sync_fetch_and_add(&mDropped, 1);
+            return 0;
+        }
+        else
+        {
+            pos = atomicLoad(&mEnqueuePos);
+        }
+    }
+
+    cell->level = level;
+    cell->msg = msg;
+
+    // Publish the message to the writer
+    __sync_bool_compare_and_swap(&cell->sequence, pos, pos + 1);
+
+    return pos + 1;
+}
+
+void AsyncLog::waitWritten(unsigned position)
+{
+    while ((int) (atomicLoad(&mWritten) - position) < 0)
+        usleep(1000);
+}
+
+void AsyncLog::stop()
+{
+    __sync_fetch_and_add(&mStopping, 1);
+    join();
+}
+
+bool AsyncLog::writeQueued()
+{
+    bool wrote = false;
+
+    MutexLocker lock(&mOutputMutex);
+    for (;;)
+    {
+        Cell &cell = mCells[mDequeuePos & mMask];
+        if (atomicLoad(&cell.sequence) != mDequeuePos + 1)
+            break;
+
+        Logger::write(cell.msg, cell.level, false);
+        __sync_fetch_and_sub(&mMemory, cell.msg.size());
+
+        // Do not keep the memory of unusually long messages
+        if (cell.msg.capacity() > 1024)
+            std::string().swap(cell.msg);
+
+        __sync_bool_compare_and_swap(&cell.sequence, mDequeuePos + 1,
+                                     mDequeuePos + mMask + 1);
+        ++mDequeuePos;
+        wrote = true;
+    }
+
+    const unsigned dropped = atomicLoad(&mDropped);
+    if (dropped != mReportedDropped)
+    {
+        std::ostringstream os;
+        os << "Dropped " << dropped - mReportedDropped
+           << " log messages, the queue was full.";
+        Logger::write(os.str(), Logger::Warn, false);
+        mReportedDropped = dropped;
+        wrote = true;
+    }
+
+    if (wrote)
+    {
+        if (mLogFile.is_open())
+        {
+            mLogFile.flush();
+            Logger::switchLogs();
+        }
+        std::cout.flush();
+        __sync_fetch_and_add(&mWritten, mDequeuePos - atomicLoad(&mWritten));
+    }
+
+    return wrote;
+}
+
+void AsyncLog::run()
+{
+    for (;;)
+    {
+        const bool stopping = atomicLoad(&mStopping);
+        if (!writeQueued())
+        {
+            if (stopping)
+                break;
+            usleep(10000);
+        }
+    }
+}
 
 /**
   * Check whether the day has changed since the last call.
@@ -91,6 +315,52 @@ void Logger::initialize(const std::string &logFile)
     setLogRotation(Configuration::getBoolValue("log_enableRotation", false));
     setMaxLogfileSize(Configuration::getValue("log_maxFileSize", 1024));
     setSwitchLogEachDay(Configuration::getBoolValue("log_perDay", false));
+
+    if (Configuration::getBoolValue("log_async", false))
+    {
+        startAsync(Configuration::getValue("log_asyncQueueSize", 4096),
+                   Configuration::getValue("log_asyncMaxMemory", 1024) * 1024);
+    }
+}
+
+void Logger::deinitialize()
+{
+    stopAsync();
+}
+
+void Logger::startAsync(unsigned queueSize, unsigned maxMemory)
+{
+    if (mAsyncLog)
+        return;
+
+    AsyncLog *asyncLog = new AsyncLog(queueSize, maxMemory);
+    if (!asyncLog->start())
+    {
+        delete asyncLog;
+        LOG_WARN("Could not start the log thread, writing messages "
+                 "right away.");
+        return;
+    }
+
+    mAsyncLog = asyncLog;
+}
+
+void Logger::stopAsync()
+{
+    if (!mAsyncLog)
+        return;
+
+    // Messages logged from now on are written right away. No other thread
+    // is expected to be logging at this point.
+    AsyncLog *asyncLog = mAsyncLog;
+    mAsyncLog = 0;
+    __sync_synchronize();
+    delete asyncLog;
+}
+
+unsigned Logger::getDroppedCount()
+{
+    return mAsyncLog ? mAsyncLog->getDroppedCount() : 0;
 }
 
 void Logger::output(std::ostream &os, const std::string &msg, const char *prefix)
@@ -105,7 +375,7 @@ void Logger::output(std::ostream &os, const std::string &msg, const char *prefix
         os << prefix << ' ';
     }
 
-    os << msg << std::endl;
+    os << msg << '\n';
 }
 
 void Logger::setLogFile(const std::string &logFile, bool append)
@@ -136,7 +406,7 @@ void Logger::setLogFile(const std::string &logFile, bool append)
     }
 }
 
-void Logger::output(const std::string &msg, Level atVerbosity)
+void Logger::write(const std::string &msg, Level atVerbosity, bool flush)
 {
     static const char *prefixes[] =
     {
@@ -153,22 +423,49 @@ void Logger::output(const std::string &msg, Level atVerbosity)
         "[DBG]"
     };
 
-    if (mVerbosity >= atVerbosity)
-    {
-        bool open = mLogFile.is_open();
+    bool open = mLogFile.is_open();
 
-        if (open)
+    if (open)
+    {
+        output(mLogFile, msg, prefixes[atVerbosity]);
+        if (flush)
         {
-            output(mLogFile, msg, prefixes[atVerbosity]);
+            mLogFile.flush();
             switchLogs();
         }
+    }
+
+    if (!open || mTeeMode)
+    {
+        std::ostream &os = atVerbosity <= Warn ? std::cerr : std::cout;
+        output(os, msg, prefixes[atVerbosity]);
+        if (flush)
+            os.flush();
+    }
+}
 
-        if (!open || mTeeMode)
+void Logger::output(const std::string &msg, Level atVerbosity)
+{
+    if (mVerbosity < atVerbosity)
+        return;
+
+    if (AsyncLog *asyncLog = mAsyncLog)
+    {
+        const unsigned position = asyncLog->push(msg, atVerbosity);
+        if (atVerbosity != Fatal)
+            return;
+
+        // The process usually ends right after a fatal error, so make sure
+        // it is written
+        if (position)
         {
-            output(atVerbosity <= Warn ? std::cerr : std::cout,
-                   msg, prefixes[atVerbosity]);
+            asyncLog->waitWritten(position);
+            return;
         }
     }
+
+    MutexLocker lock(&mOutputMutex);
+    write(msg, atVerbosity, true);
 }
 
 void Logger::switchLogs()
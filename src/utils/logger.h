@@ -35,8 +35,8 @@ namespace utils
  * By default, the messages will be timestamped but the logger can be
  * configured to not prefix the messages with a timestamp.
  *
- * Limitations:
- *     - not thread-safe.
+ * Messages may be written by a background thread, see startAsync(). The
+ * thread logging them then only has to queue them.
  *
  * Example of use:
  *
@@ -84,6 +84,12 @@ class Logger
 
         static void initialize(const std::string &logFile);
 
+        /**
+         * Writes the messages still waiting and stops the background thread,
+         * if any.
+         */
+        static void deinitialize();
+
         /**
          * Sets the log file.
          *
@@ -160,6 +166,30 @@ class Logger
          */
         static void output(const std::string &msg, Level atVerbosity);
 
+        /**
+         * Makes the messages be written by a background thread, which also
+         * takes care of timestamps and log rotation. Logging a message then
+         * only copies it to a queue, without taking any lock. Messages are
+         * dropped when the queue is full, except fatal ones, for which the
+         * logging thread waits until they are written.
+         *
+         * @param queueSize the number of messages that can be waiting.
+         * @param maxMemory the number of bytes the waiting messages may use.
+         */
+        static void startAsync(unsigned queueSize, unsigned maxMemory);
+
+        /**
+         * Writes the messages still waiting and goes back to writing the
+         * messages as they are logged.
+         */
+        static void stopAsync();
+
+        /**
+         * Returns the number of messages dropped because the queue of the
+         * background thread was full.
+         */
+        static unsigned getDroppedCount();
+
         static Level mVerbosity;   /**< Verbosity level. */
     private:
         static bool mHasTimestamp; /**< Timestamp flag. */
@@ -185,6 +215,17 @@ class Logger
         static void output(std::ostream &os, const std::string &msg,
                            const char *prefix);
 
+        /**
+         * Writes a message to the log file and/or the standard outputs.
+         * Expects the output mutex to be locked.
+         *
+         * @param flush whether to flush the log file right away.
+         */
+        static void write(const std::string &msg, Level atVerbosity,
+                          bool flush);
+
+        friend class AsyncLog;
+
         /**
          * Switch the log file based on a maximum size
          * and/or and a date change.
@@ -0,0 +1,103 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/objectpool.h"
+
+#include <new>
+
+using namespace utils;
+
+/** Alignment kept for the objects within a slab. */
+static const size_t OBJECT_ALIGNMENT = 2 * sizeof(void *);
+
+ObjectPool::ObjectPool(size_t objectSize, unsigned objectsPerSlab):
+    mObjectSize((objectSize + OBJECT_ALIGNMENT - 1) & ~(OBJECT_ALIGNMENT - 1)),
+    mObjectsPerSlab(objectsPerSlab),
+    mFreeObjects(0)
+{
+    if (mObjectSize < sizeof(FreeObject))
+        mObjectSize = sizeof(FreeObject);
+}
+
+ObjectPool::~ObjectPool()
+{
+    // Objects left would be released into freed memory
+    if (mStatistics.live)
+        return;
+
+    for (std::vector< char * >::iterator i = mSlabs.begin(),
+         i_end = mSlabs.end(); i != i_end; ++i)
+    {
+        ::operator delete(*i);
+    }
+}
+
+void ObjectPool::addSlab()
+{
+    char *slab = static_cast< char * >(
+            ::operator new(mObjectSize * mObjectsPerSlab));
+    mSlabs.push_back(slab);
+    ++mStatistics.slabs;
+
+    // Chain the objects in order, so that they are handed out in order
+    for (unsigned i = mObjectsPerSlab; i-- > 0;)
+    {
+        FreeObject *object = reinterpret_cast< FreeObject * >(
+                slab + i * mObjectSize);
+        object->next = mFreeObjects;
+        mFreeObjects = object;
+    }
+}
+
+void *ObjectPool::allocate(size_t size)
+{
+    if (size > mObjectSize)
+        return ::operator new(size);
+
+    MutexLocker lock(&mMutex);
+    if (!mFreeObjects)
+        addSlab();
+
+    FreeObject *object = mFreeObjects;
+    mFreeObjects = object->next;
+
+    ++mStatistics.allocations;
+    if (++mStatistics.live > mStatistics.peak)
+        mStatistics.peak = mStatistics.live;
+    return object;
+}
+
+void ObjectPool::release(void *object, size_t size)
+{
+    if (!object)
+        return;
+
+    if (size > mObjectSize)
+    {
+        ::operator delete(object);
+        return;
+    }
+
+    MutexLocker lock(&mMutex);
+    FreeObject *freeObject = static_cast< FreeObject * >(object);
+    freeObject->next = mFreeObjects;
+    mFreeObjects = freeObject;
+    --mStatistics.live;
+}
@@ -0,0 +1,100 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef OBJECTPOOL_H
+#define OBJECTPOOL_H
+
+#include <cstddef>
+#include <vector>
+
+#include "utils/thread.h"
+
+namespace utils
+{
+
+/**
+ * Hands out memory for objects of one size, taken from slabs holding many
+ * objects at once. Released objects are kept on a free list for the next
+ * ones, and the slabs are never given back, so that the memory used settles
+ * at the most objects alive at once instead of fragmenting the heap.
+ *
+ * Meant to back the operator new and delete of a class. Larger objects, of
+ * a derived class, are passed on to the heap. Objects may be allocated and
+ * released from several threads at once.
+ */
+class ObjectPool
+{
+    public:
+        struct Statistics
+        {
+            Statistics():
+                live(0), peak(0), slabs(0), allocations(0)
+            {}
+
+            unsigned live;              /**< Objects currently allocated. */
+            unsigned peak;              /**< Most objects alive at once. */
+            unsigned slabs;             /**< Slabs taken from the heap. */
+            unsigned long allocations;  /**< Objects allocated in total. */
+        };
+
+        /**
+         * @param objectSize the size of the objects, usually a sizeof.
+         * @param objectsPerSlab the number of objects to make room for
+         *        each time the pool runs out.
+         */
+        ObjectPool(size_t objectSize, unsigned objectsPerSlab = 64);
+
+        /**
+         * Frees the slabs, unless objects are still alive.
+         */
+        ~ObjectPool();
+
+        void *allocate(size_t size);
+
+        /**
+         * Takes back an object, given the size it was allocated with.
+         */
+        void release(void *object, size_t size);
+
+        const Statistics &getStatistics() const
+        { return mStatistics; }
+
+    private:
+        ObjectPool(const ObjectPool &);
+        ObjectPool &operator=(const ObjectPool &);
+
+        struct FreeObject
+        {
+            FreeObject *next;
+        };
+
+        void addSlab();
+
+        size_t mObjectSize;
+        unsigned mObjectsPerSlab;
+        std::vector< char * > mSlabs;
+        FreeObject *mFreeObjects;
+        Statistics mStatistics;
+        Mutex mMutex;
+};
+
+} // namespace utils
+
+#endif // OBJECTPOOL_H
@@ -0,0 +1,165 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SMALLVECTOR_H
+#define SMALLVECTOR_H
+
+#include <cassert>
+#include <cstddef>
+#include <new>
+
+namespace utils
+{
+
+/**
+ * A sequence of which the first elements are stored inside the object
+ * itself. Only when it grows beyond that capacity are the elements moved to
+ * the heap, so that the few elements most instances hold cost no allocation.
+ *
+ * Offers the part of the std::vector interface needed so far. Iterators are
+ * plain pointers, which are invalidated by any insertion or removal.
+ */
+template< class T, unsigned N >
+class SmallVector
+{
+    public:
+        typedef T value_type;
+        typedef T *iterator;
+        typedef const T *const_iterator;
+
+        SmallVector():
+            mData(inlineData()), mSize(0), mCapacity(N)
+        {}
+
+        SmallVector(const SmallVector &other):
+            mData(inlineData()), mSize(0), mCapacity(N)
+        { append(other); }
+
+        ~SmallVector()
+        {
+            clear();
+            if (mData != inlineData())
+                ::operator delete(mData);
+        }
+
+        SmallVector &operator=(const SmallVector &other)
+        {
+            if (this != &other)
+            {
+                clear();
+                append(other);
+            }
+            return *this;
+        }
+
+        iterator begin() { return mData; }
+        iterator end() { return mData + mSize; }
+        const_iterator begin() const { return mData; }
+        const_iterator end() const { return mData + mSize; }
+
+        size_t size() const { return mSize; }
+        bool empty() const { return !mSize; }
+
+        T &operator[](size_t i) { return mData[i]; }
+        const T &operator[](size_t i) const { return mData[i]; }
+
+        T &back() { return mData[mSize - 1]; }
+        const T &back() const { return mData[mSize - 1]; }
+
+        void push_back(const T &value)
+        {
+            if (mSize == mCapacity)
+            {
+                // The value may be one of the elements about to move
+                const T copy(value);
+                grow(mCapacity * 2);
+                new (mData + mSize) T(copy);
+            }
+            else
+            {
+                new (mData + mSize) T(value);
+            }
+            ++mSize;
+        }
+
+        /**
+         * Removes an element, keeping the order of the others.
+         * @return the position of the element that followed it.
+         */
+        iterator erase(iterator it)
+        {
+            assert(it >= begin() && it < end());
+            for (iterator next = it + 1; next != end(); ++next)
+                *(next - 1) = *next;
+            --mSize;
+            mData[mSize].~T();
+            return it;
+        }
+
+        void clear()
+        {
+            while (mSize)
+                mData[--mSize].~T();
+        }
+
+    private:
+        T *inlineData()
+        { return reinterpret_cast< T * >(mStorage.bytes); }
+
+        void append(const SmallVector &other)
+        {
+            if (other.mSize > mCapacity)
+                grow(other.mSize);
+            for (; mSize < other.mSize; ++mSize)
+                new (mData + mSize) T(other.mData[mSize]);
+        }
+
+        void grow(size_t capacity)
+        {
+            T *data = static_cast< T * >(::operator new(capacity * sizeof(T)));
+            for (size_t i = 0; i < mSize; ++i)
+            {
+                new (data + i) T(mData[i]);
+                mData[i].~T();
+            }
+            if (mData != inlineData())
+                ::operator delete(mData);
+            mData = data;
+            mCapacity = capacity;
+        }
+
+        /** Room for the inline elements, aligned for any of them. */
+        union Storage
+        {
+            char bytes[N * sizeof(T)];
+            double alignDouble;
+            long long alignLong;
+            void *alignPointer;
+        };
+
+        T *mData;               /**< The inline storage or a heap block. */
+        size_t mSize;
+        size_t mCapacity;
+        Storage mStorage;
+};
+
+} // namespace utils
+
+#endif // SMALLVECTOR_H
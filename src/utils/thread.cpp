@@ -0,0 +1,107 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/thread.h"
+
+namespace utils
+{
+
+Mutex::Mutex()
+{
+    pthread_mutex_init(&mMutex, 0);
+}
+
+Mutex::~Mutex()
+{
+    pthread_mutex_destroy(&mMutex);
+}
+
+void Mutex::lock()
+{
+    pthread_mutex_lock(&mMutex);
+}
+
+void Mutex::unlock()
+{
+    pthread_mutex_unlock(&mMutex);
+}
+
+
+Condition::Condition()
+{
+    pthread_cond_init(&mCondition, 0);
+}
+
+Condition::~Condition()
+{
+    pthread_cond_destroy(&mCondition);
+}
+
+void Condition::wait(Mutex *mutex)
+{
+    pthread_cond_wait(&mCondition, &mutex->mMutex);
+}
+
+void Condition::signal()
+{
+    pthread_cond_signal(&mCondition);
+}
+
+void Condition::broadcast()
+{
+    pthread_cond_broadcast(&mCondition);
+}
+
+
+Thread::Thread()
+    : mStarted(false)
+{
+}
+
+Thread::~Thread()
+{
+    join();
+}
+
+bool Thread::start()
+{
+    if (mStarted)
+        return false;
+
+    mStarted = pthread_create(&mThread, 0, &Thread::entry, this) == 0;
+    return mStarted;
+}
+
+void Thread::join()
+{
+    if (!mStarted)
+        return;
+
+    pthread_join(mThread, 0);
+    mStarted = false;
+}
+
+void *Thread::entry(void *self)
+{
+    static_cast< Thread * >(self)->run();
+    return 0;
+}
+
+} // namespace utils
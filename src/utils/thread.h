@@ -0,0 +1,182 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UTILS_THREAD_H
+#define UTILS_THREAD_H
+
+#include <pthread.h>
+
+namespace utils
+{
+
+/**
+ * A plain (non-recursive) mutex.
+ */
+class Mutex
+{
+    public:
+        Mutex();
+        ~Mutex();
+
+        void lock();
+        void unlock();
+
+    private:
+        Mutex(const Mutex &);
+        Mutex &operator=(const Mutex &);
+
+        pthread_mutex_t mMutex;
+
+        friend class Condition;
+};
+
+/**
+ * Locks a mutex for the lifetime of this object.
+ */
+class MutexLocker
+{
+    public:
+        MutexLocker(Mutex *mutex)
+            : mMutex(mutex)
+        { mMutex->lock(); }
+
+        ~MutexLocker()
+        { mMutex->unlock(); }
+
+    private:
+        MutexLocker(const MutexLocker &);
+        MutexLocker &operator=(const MutexLocker &);
+
+        Mutex *mMutex;
+};
+
+/**
+ * A condition variable, always used together with a Mutex.
+ */
+class Condition
+{
+    public:
+        Condition();
+        ~Condition();
+
+        /**
+         * Waits until the condition is signaled. The given mutex needs to be
+         * locked by the caller, it is released while waiting.
+         */
+        void wait(Mutex *mutex);
+
+        /**
+         * Wakes up one waiting thread.
+         */
+        void signal();
+
+        /**
+         * Wakes up all waiting threads.
+         */
+        void broadcast();
+
+    private:
+        Condition(const Condition &);
+        Condition &operator=(const Condition &);
+
+        pthread_cond_t mCondition;
+};
+
+/**
+ * A thread of execution. Subclasses implement run(), which is executed in
+ * the new thread once start() is called.
+ */
+class Thread
+{
+    public:
+        Thread();
+        virtual ~Thread();
+
+        /**
+         * Starts executing run() in a new thread.
+         *
+         * @return whether the thread could be created.
+         */
+        bool start();
+
+        /**
+         * Waits for the thread to finish. Does nothing when the thread was
+         * never started.
+         */
+        void join();
+
+    protected:
+        virtual void run() = 0;
+
+    private:
+        Thread(const Thread &);
+        Thread &operator=(const Thread &);
+
+        static void *entry(void *self);
+
+        pthread_t mThread;
+        bool mStarted;
+};
+
+/**
+ * An object of which every thread has its own instance. The instance of a
+ * thread is created the first time it is used, and deleted when the thread
+ * exits.
+ */
+template< class T >
+class ThreadLocal
+{
+    public:
+        ThreadLocal()
+        { pthread_key_create(&mKey, &ThreadLocal::destroy); }
+
+        ~ThreadLocal()
+        { pthread_key_delete(mKey); }
+
+        /**
+         * Returns the instance of the calling thread.
+         */
+        T *get()
+        {
+            T *value = static_cast< T * >(pthread_getspecific(mKey));
+            if (!value)
+            {
+                value = new T;
+                pthread_setspecific(mKey, value);
+            }
+            return value;
+        }
+
+        T *operator->()
+        { return get(); }
+
+    private:
+        ThreadLocal(const ThreadLocal &);
+        ThreadLocal &operator=(const ThreadLocal &);
+
+        static void destroy(void *value)
+        { delete static_cast< T * >(value); }
+
+        pthread_key_t mKey;
+};
+
+} // namespace utils
+
+#endif // UTILS_THREAD_H
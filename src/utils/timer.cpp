@@ -43,6 +43,13 @@ static uint64_t getTimeInMillisec()
 namespace utils
 {
 
+uint64_t getMicroseconds()
+{
+    timeval time;
+    gettimeofday(&time, 0);
+    return (uint64_t)time.tv_sec * 1000000 + time.tv_usec;
+}
+
 Timer::Timer(unsigned int ms)
 {
     active = false;
@@ -86,6 +86,12 @@ class Timer
         bool active;
 };
 
+/**
+ * Returns the current time in microseconds, used to measure how long
+ * something takes.
+ */
+uint64_t getMicroseconds();
+
 } // ::utils
 
 #endif
@@ -0,0 +1,153 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "utils/workerpool.h"
+
+#include "utils/logger.h"
+
+namespace utils
+{
+
+class WorkerPool::Worker : public Thread
+{
+    public:
+        Worker(WorkerPool *pool)
+            : mPool(pool)
+        {}
+
+        ~Worker()
+        { join(); }
+
+    protected:
+        void run()
+        { mPool->workerLoop(); }
+
+    private:
+        WorkerPool *mPool;
+};
+
+WorkerPool::WorkerPool(unsigned threads):
+    mJobs(0),
+    mNextJob(0),
+    mFinishedJobs(0),
+    mBatch(0),
+    mQuit(false)
+{
+    for (unsigned i = 1; i < threads; ++i)
+    {
+        Worker *worker = new Worker(this);
+        if (!worker->start())
+        {
+            LOG_ERROR("Unable to start worker thread, continuing with "
+                      << i << " thread(s).");
+            delete worker;
+            break;
+        }
+        mWorkers.push_back(worker);
+    }
+}
+
+WorkerPool::~WorkerPool()
+{
+    mMutex.lock();
+    mQuit = true;
+    mWorkAvailable.broadcast();
+    mMutex.unlock();
+
+    for (std::vector< Worker * >::iterator i = mWorkers.begin(),
+         i_end = mWorkers.end(); i != i_end; ++i)
+    {
+        delete *i;
+    }
+}
+
+void WorkerPool::run(const std::vector< Job * > &jobs)
+{
+    if (jobs.empty())
+        return;
+
+    if (mWorkers.empty())
+    {
+        for (std::vector< Job * >::const_iterator i = jobs.begin(),
+             i_end = jobs.end(); i != i_end; ++i)
+        {
+            (*i)->run();
+        }
+        return;
+    }
+
+    mMutex.lock();
+    mJobs = &jobs;
+    mNextJob = 0;
+    mFinishedJobs = 0;
+    ++mBatch;
+    mWorkAvailable.broadcast();
+    mMutex.unlock();
+
+    work();
+
+    mMutex.lock();
+    while (mFinishedJobs != jobs.size())
+        mWorkDone.wait(&mMutex);
+    mJobs = 0;
+    mMutex.unlock();
+}
+
+void WorkerPool::work()
+{
+    mMutex.lock();
+    while (mJobs && mNextJob < mJobs->size())
+    {
+        Job *job = (*mJobs)[mNextJob++];
+        mMutex.unlock();
+
+        job->run();
+
+        mMutex.lock();
+        if (++mFinishedJobs == mJobs->size())
+            mWorkDone.signal();
+    }
+    mMutex.unlock();
+}
+
+void WorkerPool::workerLoop()
+{
+    unsigned lastBatch = 0;
+
+    for (;;)
+    {
+        mMutex.lock();
+        while (!mQuit && (mBatch == lastBatch || !mJobs))
+            mWorkAvailable.wait(&mMutex);
+
+        if (mQuit)
+        {
+            mMutex.unlock();
+            return;
+        }
+
+        lastBatch = mBatch;
+        mMutex.unlock();
+
+        work();
+    }
+}
+
+} // namespace utils
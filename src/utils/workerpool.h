@@ -0,0 +1,100 @@
+/*
+ *  The Mana Server
+ *  Copyright (C) 2012  The Mana Developers
+ *
+ *  This file is part of The Mana Server.
+ *
+ *  The Mana Server is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  any later version.
+ *
+ *  The Mana Server is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with The Mana Server.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef UTILS_WORKERPOOL_H
+#define UTILS_WORKERPOOL_H
+
+#include "utils/thread.h"
+
+#include <vector>
+
+namespace utils
+{
+
+/**
+ * A fixed set of threads executing batches of independent jobs. The thread
+ * calling run() takes part in the work and only returns once every job of
+ * the batch has finished, so that the batch acts as a barrier.
+ */
+class WorkerPool
+{
+    public:
+        /**
+         * A unit of work. Jobs of the same batch may run concurrently and
+         * must not touch shared state without synchronization.
+         */
+        class Job
+        {
+            public:
+                virtual ~Job() {}
+                virtual void run() = 0;
+        };
+
+        /**
+         * Creates a pool with the given amount of threads, counting the
+         * thread calling run().
+         */
+        WorkerPool(unsigned threads);
+
+        ~WorkerPool();
+
+        /**
+         * Returns the number of threads taking part in a batch.
+         */
+        unsigned getThreadCount() const
+        { return mWorkers.size() + 1; }
+
+        /**
+         * Executes all given jobs and waits for them to finish.
+         */
+        void run(const std::vector< Job * > &jobs);
+
+    private:
+        WorkerPool(const WorkerPool &);
+        WorkerPool &operator=(const WorkerPool &);
+
+        class Worker;
+
+        /**
+         * Takes jobs from the current batch until none is left.
+         */
+        void work();
+
+        /**
+         * Loop executed by the additional threads.
+         */
+        void workerLoop();
+
+        std::vector< Worker * > mWorkers;
+
+        Mutex mMutex;
+        Condition mWorkAvailable;   /**< Signaled when a batch starts. */
+        Condition mWorkDone;        /**< Signaled when a batch finishes. */
+
+        const std::vector< Job * > *mJobs; /**< Current batch. */
+        unsigned mNextJob;          /**< Next job to hand out. */
+        unsigned mFinishedJobs;     /**< Jobs of the batch that are done. */
+        unsigned mBatch;            /**< Number of the current batch. */
+        bool mQuit;
+};
+
+} // namespace utils
+
+#endif // UTILS_WORKERPOOL_H